@@ -7,7 +7,30 @@
 #include "chip8stack.h"
 #include "chip8keyboard.h"
 #include "chip8screen.h"
+#include "chip8spritecache.h"
+#include "chip8block.h"
+#include "chip8isa.h"
 #include <stddef.h>
+#include <stdint.h>
+
+/* Running totals of the work done by an instance */
+struct chip8_stats
+{
+    uint64_t instructions;
+    uint64_t sprites;
+    uint64_t collisions;
+    /* Instructions run by pre-decoded blocks, the others have been interpreted */
+    uint64_t block_instructions;
+    /* Performance counter ticks spent in each tier, only measured when the block cache asks for it */
+    uint64_t interpreter_ticks;
+    uint64_t block_ticks;
+    /* Returns run in blocks that found their block on the shadow stack, and the ones that had to look it up */
+    uint64_t return_hits;
+    uint64_t return_misses;
+    /* Computed jumps run in blocks that found their target in the inline cache of the jump, and the ones that did not */
+    uint64_t jump_hits;
+    uint64_t jump_misses;
+};
 
 struct chip8
 {
@@ -16,11 +39,45 @@ struct chip8
     struct chip8_registers registers;
     struct chip8_keyboard keyboard;
     struct chip8_screen screen;
+    struct chip8_stats stats;
+    /* State of the generator behind RND, never 0 */
+    uint32_t random;
+    /* CHIP8_QUIRK_* flags of the interpreter the program was written for, see chip8_set_quirks */
+    unsigned int quirks;
+    /* Optional cache of pre-shifted sprites used by DRW, NULL when disabled */
+    struct chip8_sprite_cache* sprite_cache;
+    /* Optional cache of pre-decoded blocks used by chip8_run, NULL to always interpret */
+    struct chip8_block_cache* block_cache;
+    /* With a shared block cache, bytes that may differ from its reference memory, one bit per byte of each code page */
+    uint64_t written[CHIP8_BLOCK_PAGES];
+    /* Frames of the calls run in blocks, by stack slot, only valid for the current block cache */
+    struct chip8_block_frame shadow_stack[CHIP8_TOTAL_STACK_DEPTH];
+    /* Inline caches of the computed jumps run in blocks, by block of the jump, only valid for the current block cache */
+    struct chip8_block_site jump_sites[CHIP8_BLOCK_JUMP_SITES];
 };
 
 void chip8_init(struct chip8* chip8);
+void chip8_free(struct chip8* chip8);
+void chip8_seed(struct chip8* chip8, uint32_t seed);
 void chip8_load(struct chip8* chip8, const char* buffer, size_t size);
+void chip8_set_quirks(struct chip8* chip8, unsigned int quirks);
 void chip8_exec(struct chip8* chip8, unsigned short opcode);
+/* Used by the semantics of the instructions, see chip8isa.h */
+unsigned char chip8_random(struct chip8* chip8);
+bool chip8_draw(struct chip8* chip8, unsigned char column, unsigned char row, unsigned char n);
+bool chip8_draw_clipped(struct chip8* chip8, unsigned char column, unsigned char row, unsigned char n);
+void chip8_store(struct chip8* chip8, int index, unsigned char value);
+void chip8_unknown_opcode(struct chip8* chip8, unsigned short opcode);
+void chip8_set_sprite_cache(struct chip8* chip8, struct chip8_sprite_cache* cache);
+void chip8_set_block_cache(struct chip8* chip8, struct chip8_block_cache* cache);
+void chip8_step(struct chip8* chip8);
+void chip8_run(struct chip8* chip8, int instructions);
+void chip8_tick_timers(struct chip8* chip8);
+void chip8_run_frame(struct chip8* chip8, int instructions);
+void chip8_fork(struct chip8* child, const struct chip8* parent);
+void chip8_snapshot(struct chip8* snapshot, const struct chip8* chip8);
+void chip8_restore(struct chip8* chip8, const struct chip8* snapshot);
+uint64_t chip8_state_hash(const struct chip8* chip8);
 
 
 #endif
\ No newline at end of file
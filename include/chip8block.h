@@ -0,0 +1,198 @@
+#ifndef CHIP8BLOCK_H
+#define CHIP8BLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <SDL2/SDL_atomic.h>
+#include "config.h"
+#include "chip8memory.h"
+#include "chip8isa.h"
+
+struct chip8;
+
+/*
+    Second execution tier. Every instance starts in the interpreter, which counts how many
+    times each block entry (the target of a jump, call, return or skip) is reached. Entries
+    reaching CHIP8_BLOCK_HOT_THRESHOLD are handed to the compiler thread, which decodes the
+    straight-line code up to the next control flow instruction once and installs the block
+    in the table indexed by PC. From then on the block runs without fetching or decoding.
+
+    Memory is split in 64 code pages with one bit each, set while a page holds the code of a
+    block or of a pending compilation. A write only takes the lock of the cache when the bit
+    of its page is set, and then only walks the blocks of that page.
+
+    A shared cache holds the blocks of every instance started from the same memory image.
+    Its blocks are compiled from a reference copy of that image and are never invalidated.
+    Instead every instance records the bytes it writes, and checks a block against its own
+    memory before running it when the block holds such a byte. An instance whose code no
+    longer matches leaves the shared cache for a private copy.
+*/
+
+#define CHIP8_BLOCK_PAGES (CHIP8_MEMORY_SIZE / CHIP8_BLOCK_PAGE_SIZE)
+
+#define CHIP8_BLOCK_FILE_MAGIC      0x4b423843 /* "C8BK" */
+#define CHIP8_BLOCK_FILE_VERSION    2
+
+struct chip8_block_op
+{
+    unsigned short opcode;
+    /* The enum chip8_op of the instruction */
+    unsigned char id;
+    unsigned char x;
+    unsigned char y;
+    unsigned char kk;
+    unsigned short nnn;
+};
+
+/*
+    Instructions from pc on. Only the last one may change PC or write memory,
+    so the ones before it always run in sequence.
+*/
+struct chip8_block
+{
+    unsigned short pc;
+    unsigned short length;
+    /* First and last page holding the block, with the bytes the block holds in each */
+    unsigned char pages[2];
+    uint64_t masks[2];
+    /* Next block in the lists of the first and the last page holding the block */
+    struct chip8_block* next[2];
+    /* Next block of the list of retired blocks */
+    struct chip8_block* retired;
+    struct chip8_block_op ops[];
+};
+
+/*
+    Entry of the shadow stack of an instance: a return address pushed by a call run in a block,
+    with the block installed at that address when the call was made. The stack itself is the
+    truth, a return only uses the frame of its slot when it pops the same address.
+*/
+struct chip8_block_frame
+{
+    struct chip8_block* block;
+    unsigned short pc;
+    /* Retirements of the cache when the frame was pushed, the block is still installed while they are the same */
+    uint32_t retirements;
+};
+
+/*
+    Inline cache of a computed jump (BNNN) of an instance, kept for the block the jump ends: the
+    last offsets the jump added to NNN, with the blocks installed at the targets, so a jump table
+    keeps going from block to block without a table lookup. The entries are dropped when another
+    jump takes the slot or a block is retired from the cache.
+*/
+struct chip8_block_site
+{
+    /* Block ended by the jump, NULL for an empty site */
+    const struct chip8_block* block;
+    /* Entry replaced by the next miss */
+    unsigned char victim;
+    /* Values of the register added to NNN */
+    unsigned char offsets[CHIP8_BLOCK_JUMP_WAYS];
+    struct chip8_block* targets[CHIP8_BLOCK_JUMP_WAYS];
+    /* Retirements of the cache when the entries were filled */
+    uint32_t retirements;
+};
+
+/*
+    Blocks of a shared cache saved in a cache directory, one file per memory image and emulator
+    version. The blocks follow the header with the layout of struct chip8_block, each padded to
+    8 bytes, and are used in place from a copy-on-write mapping of the file. Blocks only hold
+    decoded instructions, instances run them with the variant of their own quirk profile.
+*/
+struct chip8_block_file_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t emulator_version;
+    /* sizeof(struct chip8_block) of the emulator that wrote the file */
+    uint32_t block_size;
+    uint64_t memory_hash;
+    uint32_t count;
+    uint64_t size;
+};
+
+struct chip8_block_cache_stats
+{
+    /* Entries that became hot */
+    _Atomic uint64_t requested;
+    _Atomic uint64_t installed;
+    /* Blocks installed from a block file */
+    _Atomic uint64_t loaded;
+    /* Blocks whose code was written while they were being compiled */
+    _Atomic uint64_t discarded;
+    /* Writes to a page holding code, whether or not they hit a block */
+    _Atomic uint64_t code_writes;
+    /* Installed blocks dropped because their code was written */
+    _Atomic uint64_t invalidated;
+    /* Instances that left a shared cache because they wrote its code */
+    _Atomic uint64_t diverged;
+    /* Retired blocks freed at a point where no instance was running the cache */
+    _Atomic uint64_t reclaimed;
+};
+
+struct chip8_block_cache
+{
+    _Atomic(struct chip8_block*) blocks[CHIP8_MEMORY_SIZE];
+    /* Times each block entry has been reached by the interpreter */
+    _Atomic uint32_t hotness[CHIP8_MEMORY_SIZE];
+    /* Bit p is set when page p holds code */
+    _Atomic uint64_t code_pages;
+    /* Installed blocks holding each page */
+    struct chip8_block* pages[CHIP8_BLOCK_PAGES];
+    /* Compilations pending on each page */
+    unsigned int pending[CHIP8_BLOCK_PAGES];
+    /* Bumped by every write to a page holding code, a block compiled from older code is not installed */
+    _Atomic uint32_t generations[CHIP8_BLOCK_PAGES];
+    _Atomic int references;
+    /* Serializes installations and invalidations, guards the page lists */
+    SDL_SpinLock lock;
+    /* Blocks removed from the table, freed once no instance runs the cache since one may still hold them */
+    struct chip8_block* retired;
+    /* Instances inside chip8_block_run with this cache, the retired blocks are freed when it drops to zero */
+    _Atomic int running;
+    /* Bumped by every block removed from the table, tells the shadow stacks their frames are stale */
+    _Atomic uint32_t retirements;
+    /* Measure the time spent in each tier, it costs a clock read per tier switch */
+    bool timing;
+    /* Shared between instances, the blocks hold the code of the reference memory */
+    bool shared;
+    struct chip8_memory reference;
+    /* Copy-on-write mapping of the block file the cache has been loaded from, blocks inside it are not freed */
+    void* file;
+    size_t file_size;
+    void* file_mapping;
+    struct chip8_block_cache_stats stats;
+};
+
+_Static_assert(CHIP8_BLOCK_PAGES <= 64, "code pages must fit in the bitmap");
+_Static_assert(CHIP8_BLOCK_MAX_OPS * 2 <= CHIP8_BLOCK_PAGE_SIZE, "a block must not span more than two pages");
+
+/**
+ * @brief Check whether a memory byte is on a page holding code, the only writes that have to invalidate.
+ * 
+ * @param cache Pointer to a chip8_block_cache struct.
+ * @param index An index to access the memory byte.
+ * @return true Blocks may hold the byte, it has to be passed to chip8_block_cache_invalidate when written.
+ * @return false No block holds the byte.
+ */
+static inline bool chip8_block_cache_holds(const struct chip8_block_cache* cache, int index)
+{
+    return atomic_load_explicit(&cache->code_pages, memory_order_relaxed) >> (index / CHIP8_BLOCK_PAGE_SIZE) & 1;
+}
+
+struct chip8_block_cache* chip8_block_cache_create(void);
+struct chip8_block_cache* chip8_block_cache_shared(const struct chip8_memory* memory);
+void chip8_block_registry_clear(void);
+bool chip8_block_cache_load(struct chip8_block_cache* cache, const char* directory);
+bool chip8_block_cache_save(struct chip8_block_cache* cache, const char* directory);
+void chip8_block_cache_retain(struct chip8_block_cache* cache);
+void chip8_block_cache_release(struct chip8_block_cache* cache);
+void chip8_block_cache_clear(struct chip8_block_cache* cache);
+void chip8_block_cache_invalidate(struct chip8_block_cache* cache, int index);
+void chip8_block_compiler_start(void);
+void chip8_block_compiler_stop(void);
+void chip8_block_run(struct chip8* chip8, int instructions);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,109 @@
+#ifndef CHIP8ENV_H
+#define CHIP8ENV_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_mutex.h>
+#include "config.h"
+#include "chip8.h"
+
+/*
+    N instances of the same ROM stepped together, for training agents.
+    Every step holds one key per environment for a number of frames and writes
+    the observations, rewards and done flags into arrays owned by the caller,
+    with one slot per environment. An episode starts as a copy-on-write fork of the
+    initial state, so its first write to each memory page allocates a private copy
+    of the page; steps allocate nothing else.
+*/
+
+/* Action that holds no key */
+#define CHIP8_ENV_NO_KEY -1
+
+enum chip8_env_observation
+{
+    /* 32 uint64_t per environment, one packed row each (see chip8_screen) */
+    CHIP8_ENV_OBSERVATION_PACKED,
+    /* 64x32 uint8_t per environment, 1 for a lit pixel and 0 otherwise, row by row */
+    CHIP8_ENV_OBSERVATION_BYTES
+};
+
+enum chip8_env_probe_kind
+{
+    /* The reward grows by scale times the increase of the byte */
+    CHIP8_ENV_PROBE_REWARD,
+    /* The episode ends when the byte equals value */
+    CHIP8_ENV_PROBE_DONE_EQUAL,
+    /* The episode ends when the byte no longer equals value */
+    CHIP8_ENV_PROBE_DONE_NOT_EQUAL
+};
+
+/* Memory byte watched after every step */
+struct chip8_env_probe
+{
+    enum chip8_env_probe_kind kind;
+    unsigned short address;
+    unsigned char value;
+    float scale;
+};
+
+struct chip8_env_config
+{
+    const char* rom;
+    size_t rom_size;
+    int count;
+    /* Worker threads, the caller thread steps the environments itself when 0 */
+    int threads;
+    enum chip8_env_observation observation;
+    const struct chip8_env_probe* probes;
+    int total_probes;
+    /* Frames after which an episode is ended, 0 for no limit */
+    uint64_t max_episode_frames;
+    uint32_t seed;
+    /* CHIP8_QUIRK_* flags of the interpreter the ROM was written for */
+    unsigned int quirks;
+};
+
+struct chip8_env
+{
+    struct chip8 chip8;
+    /* Value of the probed bytes after the previous step */
+    unsigned char probed[CHIP8_ENV_MAX_PROBES];
+    uint64_t frames;
+    uint32_t episode;
+    /* The episode has ended, the environment is reset by the next step */
+    bool done;
+};
+
+struct chip8_envs
+{
+    struct chip8_env_config config;
+    struct chip8_env_probe probes[CHIP8_ENV_MAX_PROBES];
+    /* State every episode starts from, shared copy-on-write by the environments */
+    struct chip8 initial;
+    struct chip8_env* envs;
+
+    /* Arguments of the batch being run by the workers */
+    bool resetting;
+    const int* actions;
+    int frames_per_step;
+    void* observations;
+    float* rewards;
+    bool* dones;
+    _Atomic int next;
+
+    SDL_Thread* threads[CHIP8_ENV_MAX_THREADS];
+    SDL_sem* start;
+    SDL_sem* finished;
+    atomic_bool running;
+};
+
+bool chip8_env_create(struct chip8_envs* envs, const struct chip8_env_config* config);
+void chip8_env_destroy(struct chip8_envs* envs);
+void chip8_env_reset(struct chip8_envs* envs, void* observations);
+void chip8_env_step(struct chip8_envs* envs, const int* actions, int frames_per_step,
+                    void* observations, float* rewards, bool* dones);
+
+#endif
\ No newline at end of file
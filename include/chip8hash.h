@@ -0,0 +1,72 @@
+#ifndef CHIP8HASH_H
+#define CHIP8HASH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/*
+    The state hash is the XOR of one key per non-zero memory byte, screen row and
+    stack slot, so a write only has to XOR out the key of the old value and XOR in
+    the key of the new one. The keys are derived from the position and the value by
+    a mixing function instead of being stored in tables.
+*/
+enum chip8_hash_domain
+{
+    CHIP8_HASH_MEMORY = 1,
+    CHIP8_HASH_SCREEN,
+    CHIP8_HASH_STACK,
+    CHIP8_HASH_REGISTERS
+};
+
+/**
+ * @brief Scramble the bits of a word (the finalizer of splitmix64).
+ * 
+ * @param value The word to scramble.
+ * @return uint64_t The scrambled word.
+ */
+static inline uint64_t chip8_hash_mix(uint64_t value)
+{
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+/**
+ * @brief Get the key of a value stored at a position, zero values have no key.
+ * 
+ * @param domain The part of the state holding the value.
+ * @param position The position of the value in that part (address, row or slot).
+ * @param value The value.
+ * @return uint64_t The key to XOR into the state hash.
+ */
+static inline uint64_t chip8_hash_key(enum chip8_hash_domain domain, unsigned int position, uint64_t value)
+{
+    if (value == 0)
+    {
+        return 0;
+    }
+    return chip8_hash_mix(chip8_hash_mix(value) ^ ((uint64_t) domain << 56) ^ ((uint64_t) position << 32));
+}
+
+/* Lock-free set of state hashes shared by the workers of a search */
+struct chip8_state_set
+{
+    /* Open-addressed slots, 0 marks an empty slot */
+    _Atomic uint64_t* slots;
+    /* Number of slots, a power of two */
+    uint64_t capacity;
+    _Atomic uint64_t count;
+    /* Insertions refused because the set was full */
+    _Atomic uint64_t overflows;
+};
+
+bool chip8_state_set_init(struct chip8_state_set* set, uint64_t capacity);
+void chip8_state_set_free(struct chip8_state_set* set);
+bool chip8_state_set_insert(struct chip8_state_set* set, uint64_t hash);
+bool chip8_state_set_contains(const struct chip8_state_set* set, uint64_t hash);
+
+#endif
\ No newline at end of file
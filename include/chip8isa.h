@@ -0,0 +1,242 @@
+#ifndef CHIP8ISA_H
+#define CHIP8ISA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+    Description of the instruction set, the only place the opcodes are spelled out.
+    Every entry is X(name, mask, match, format, flags, semantics...):
+
+    - An opcode is the instruction when (opcode & mask) == match.
+    - The format is the assembly text, with the operands written {x}, {y}, {n}, {kk} and {nnn}.
+    - The semantics are the statements executing the instruction. They see the instance as
+      chip8, its data registers as V and the decoded operands as x, y, n, kk and nnn, with
+      PC already past the instruction. Behaviours that depend on the quirk profile are
+      tested with CHIP8_QUIRK(name), a constant in each variant of the interpreter.
+
+    The interpreter, the blocks, the disassembler and the assembler are all expanded from it.
+    All the entries sharing a first nibble must use the same mask, see CHIP8_ISA_GROUP_MASK.
+*/
+
+/* The instruction may leave PC anywhere else than the next instruction */
+#define CHIP8_ISA_BRANCH    0x01
+/* The instruction writes memory */
+#define CHIP8_ISA_STORE     0x02
+
+/*
+    Quirks: instructions that behaved differently between the interpreters ROMs were written for.
+    A quirk profile is any combination of them, 0 being the behaviour of the modern interpreters.
+*/
+/* 8xy6 and 8xyE shift Vy into Vx, instead of shifting Vx in place */
+#define CHIP8_QUIRK_SHIFT_VY        0x01
+/* Fx55 and Fx65 leave I past the last register they access */
+#define CHIP8_QUIRK_LOAD_STORE_I    0x02
+/* 8xy1, 8xy2 and 8xy3 clear VF */
+#define CHIP8_QUIRK_VF_RESET        0x04
+/* Sprites are clipped at the edges of the screen instead of wrapping around */
+#define CHIP8_QUIRK_CLIP            0x08
+/* Bxnn jumps to xnn + Vx instead of nnn + V0 */
+#define CHIP8_QUIRK_JUMP_VX         0x10
+
+#define CHIP8_QUIRK_PROFILES        0x20
+
+/* Calls X(profile) for every quirk profile, each one gets its own variant of the interpreter */
+#define CHIP8_QUIRK_EACH(X)                                                         \
+    X(0)  X(1)  X(2)  X(3)  X(4)  X(5)  X(6)  X(7)                                  \
+    X(8)  X(9)  X(10) X(11) X(12) X(13) X(14) X(15)                                 \
+    X(16) X(17) X(18) X(19) X(20) X(21) X(22) X(23)                                 \
+    X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31)
+
+/* Whether the profile of the variant being compiled has a quirk, the semantics see it as quirks */
+#define CHIP8_QUIRK(name) (((quirks) & CHIP8_QUIRK_##name) != 0)
+
+#define CHIP8_ISA(X)                                                                        \
+    X(CLS,          0xffff, 0x00E0, "CLS",                  0,                              \
+      chip8_screen_clear(&chip8->screen);)                                                  \
+    X(RET,          0xffff, 0x00EE, "RET",                  CHIP8_ISA_BRANCH,               \
+      chip8->registers.PC = chip8_stack_pop(chip8);)                                        \
+    X(JP,           0xf000, 0x1000, "JP {nnn}",             CHIP8_ISA_BRANCH,               \
+      chip8->registers.PC = nnn;)                                                           \
+    X(CALL,         0xf000, 0x2000, "CALL {nnn}",           CHIP8_ISA_BRANCH,               \
+      chip8_stack_push(chip8, chip8->registers.PC);                                         \
+      chip8->registers.PC = nnn;)                                                           \
+    X(SE_BYTE,      0xf000, 0x3000, "SE V{x}, {kk}",        CHIP8_ISA_BRANCH,               \
+      chip8->registers.PC += (V[x] == kk) * 2;)                                             \
+    X(SNE_BYTE,     0xf000, 0x4000, "SNE V{x}, {kk}",       CHIP8_ISA_BRANCH,               \
+      chip8->registers.PC += (V[x] != kk) * 2;)                                             \
+    X(SE_REG,       0xf00f, 0x5000, "SE V{x}, V{y}",        CHIP8_ISA_BRANCH,               \
+      chip8->registers.PC += (V[x] == V[y]) * 2;)                                           \
+    X(LD_BYTE,      0xf000, 0x6000, "LD V{x}, {kk}",        0,                              \
+      V[x] = kk;)                                                                           \
+    X(ADD_BYTE,     0xf000, 0x7000, "ADD V{x}, {kk}",       0,                              \
+      V[x] += kk;)                                                                          \
+    X(LD_REG,       0xf00f, 0x8000, "LD V{x}, V{y}",        0,                              \
+      V[x] = V[y];)                                                                         \
+    X(OR,           0xf00f, 0x8001, "OR V{x}, V{y}",        0,                              \
+      V[x] |= V[y];                                                                        \
+      if (CHIP8_QUIRK(VF_RESET))                                                            \
+      {                                                                                     \
+          V[0x0f] = 0x00;                                                                   \
+      })                                                                        \
+    X(AND,          0xf00f, 0x8002, "AND V{x}, V{y}",       0,                              \
+      V[x] &= V[y];                                                                        \
+      if (CHIP8_QUIRK(VF_RESET))                                                            \
+      {                                                                                     \
+          V[0x0f] = 0x00;                                                                   \
+      })                                                                        \
+    X(XOR,          0xf00f, 0x8003, "XOR V{x}, V{y}",       0,                              \
+      V[x] ^= V[y];                                                                        \
+      if (CHIP8_QUIRK(VF_RESET))                                                            \
+      {                                                                                     \
+          V[0x0f] = 0x00;                                                                   \
+      })                                                                        \
+    /* VF is written before Vx, which matters when x is F */                                \
+    X(ADD_REG,      0xf00f, 0x8004, "ADD V{x}, V{y}",       0,                              \
+      unsigned short sum = V[x] + V[y];                                                     \
+      V[0x0f] = sum > 0xff;                                                                 \
+      V[x] = sum;)                                                                          \
+    /* VF is cleared before the comparison, which matters when y is F */                    \
+    X(SUB,          0xf00f, 0x8005, "SUB V{x}, V{y}",       0,                              \
+      V[0x0f] = 0x00;                                                                       \
+      V[0x0f] = V[x] > V[y];                                                                \
+      V[x] -= V[y];)                                                                        \
+    X(SHR,          0xf00f, 0x8006, "SHR V{x}, V{y}",       0,                              \
+      if (CHIP8_QUIRK(SHIFT_VY))                                                            \
+      {                                                                                     \
+          V[x] = V[y];                                                                      \
+      }                                                                                     \
+      V[0x0f] = V[x] & 0x01;                                                                \
+      V[x] >>= 1;)                                                                          \
+    X(SUBN,         0xf00f, 0x8007, "SUBN V{x}, V{y}",      0,                              \
+      V[0x0f] = V[y] > V[x];                                                                \
+      V[x] = V[y] - V[x];)                                                                  \
+    X(SHL,          0xf00f, 0x800E, "SHL V{x}, V{y}",       0,                              \
+      if (CHIP8_QUIRK(SHIFT_VY))                                                            \
+      {                                                                                     \
+          V[x] = V[y];                                                                      \
+      }                                                                                     \
+      V[0x0f] = V[x] >> 7;                                                                  \
+      V[x] <<= 1;)                                                                          \
+    X(SNE_REG,      0xf00f, 0x9000, "SNE V{x}, V{y}",       CHIP8_ISA_BRANCH,               \
+      chip8->registers.PC += (V[x] != V[y]) * 2;)                                           \
+    X(LD_I,         0xf000, 0xA000, "LD I, {nnn}",          0,                              \
+      chip8->registers.I = nnn;)                                                            \
+    X(JP_V0,        0xf000, 0xB000, "JP V0, {nnn}",         CHIP8_ISA_BRANCH,               \
+      chip8->registers.PC = nnn + V[CHIP8_QUIRK(JUMP_VX) ? x : 0x00];)                      \
+    X(RND,          0xf000, 0xC000, "RND V{x}, {kk}",       0,                              \
+      V[x] = chip8_random(chip8) & kk;)                                                     \
+    X(DRW,          0xf000, 0xD000, "DRW V{x}, V{y}, {n}",  0,                              \
+      V[0x0f] = CHIP8_QUIRK(CLIP) ? chip8_draw_clipped(chip8, V[x], V[y], n)                \
+                                  : chip8_draw(chip8, V[x], V[y], n);)                      \
+    X(SKP,          0xf0ff, 0xE09E, "SKP V{x}",             CHIP8_ISA_BRANCH,               \
+      chip8->registers.PC += chip8_keyboard_is_down(&chip8->keyboard, V[x]) * 2;)           \
+    X(SKNP,         0xf0ff, 0xE0A1, "SKNP V{x}",            CHIP8_ISA_BRANCH,               \
+      chip8->registers.PC += !chip8_keyboard_is_down(&chip8->keyboard, V[x]) * 2;)          \
+    X(LD_VX_DT,     0xf0ff, 0xF007, "LD V{x}, DT",          0,                              \
+      V[x] = chip8->registers.delay_timer;)                                                 \
+    /* Runs again until a key is pressed, so input and timers keep running */               \
+    X(LD_VX_K,      0xf0ff, 0xF00A, "LD V{x}, K",           CHIP8_ISA_BRANCH,               \
+      int key = chip8_keyboard_take_press(&chip8->keyboard);                                \
+      if (key == -1)                                                                        \
+      {                                                                                     \
+          chip8->registers.PC -= 2;                                                         \
+      }                                                                                     \
+      else                                                                                  \
+      {                                                                                     \
+          V[x] = key;                                                                       \
+      })                                                                                    \
+    X(LD_DT_VX,     0xf0ff, 0xF015, "LD DT, V{x}",          0,                              \
+      chip8->registers.delay_timer = V[x];)                                                 \
+    X(LD_ST_VX,     0xf0ff, 0xF018, "LD ST, V{x}",          0,                              \
+      chip8->registers.sound_timer = V[x];)                                                 \
+    X(ADD_I,        0xf0ff, 0xF01E, "ADD I, V{x}",          0,                              \
+      chip8->registers.I += V[x];)                                                          \
+    X(LD_F,         0xf0ff, 0xF029, "LD F, V{x}",           0,                              \
+      chip8->registers.I = V[x] * CHIP8_DEFAULT_SPRITE_HEIGHT;)                             \
+    X(LD_B,         0xf0ff, 0xF033, "LD B, V{x}",           CHIP8_ISA_STORE,                \
+      unsigned char value = V[x];                                                           \
+      chip8_store(chip8, chip8->registers.I, value / 100);                                  \
+      chip8_store(chip8, chip8->registers.I + 1, value / 10 % 10);                          \
+      chip8_store(chip8, chip8->registers.I + 2, value % 10);)                              \
+    X(LD_MEM_VX,    0xf0ff, 0xF055, "LD [I], V{x}",         CHIP8_ISA_STORE,                \
+      for (int i = 0 ; i <= x ; i++)                                                        \
+      {                                                                                     \
+          chip8_store(chip8, chip8->registers.I + i, V[i]);                                 \
+      }                                                                                     \
+      if (CHIP8_QUIRK(LOAD_STORE_I))                                                        \
+      {                                                                                     \
+          chip8->registers.I += x + 1;                                                      \
+      })                                                                                    \
+    X(LD_VX_MEM,    0xf0ff, 0xF065, "LD V{x}, [I]",         0,                              \
+      for (int i = 0 ; i <= x ; i++)                                                        \
+      {                                                                                     \
+          V[i] = chip8_memory_get(&chip8->memory, chip8->registers.I + i);                  \
+      }                                                                                     \
+      if (CHIP8_QUIRK(LOAD_STORE_I))                                                        \
+      {                                                                                     \
+          chip8->registers.I += x + 1;                                                      \
+      })
+
+/* Bits of an opcode telling apart the instructions starting with the same nibble */
+#define CHIP8_ISA_GROUP_MASK(nibble)                                    \
+    ((nibble) == 0x0 ? 0xffff :                                         \
+     (nibble) == 0x5 || (nibble) == 0x8 || (nibble) == 0x9 ? 0xf00f :   \
+     (nibble) == 0xE || (nibble) == 0xF ? 0xf0ff : 0xf000)
+
+#define CHIP8_ISA_ENUM(name, mask, match, format, flags, ...) CHIP8_OP_##name,
+
+enum chip8_op
+{
+    CHIP8_ISA(CHIP8_ISA_ENUM)
+    /* Any opcode outside the table, SYS addr (0x0nnn) included */
+    CHIP8_OP_UNKNOWN,
+    CHIP8_OP_COUNT
+};
+
+struct chip8_isa_entry
+{
+    const char* name;
+    unsigned short mask;
+    unsigned short match;
+    const char* format;
+    unsigned char flags;
+};
+
+extern const struct chip8_isa_entry chip8_isa_table[CHIP8_OP_COUNT];
+
+#define CHIP8_ISA_DECODE_CASE(name, mask, match, format, flags, ...) case (match): return CHIP8_OP_##name;
+
+/**
+ * @brief Find the instruction of an opcode.
+ * 
+ * @param opcode The opcode.
+ * @return enum chip8_op The instruction, CHIP8_OP_UNKNOWN when the opcode is not in the table.
+ */
+static inline enum chip8_op chip8_isa_decode(unsigned short opcode)
+{
+    switch (opcode & CHIP8_ISA_GROUP_MASK(opcode >> 12))
+    {
+        CHIP8_ISA(CHIP8_ISA_DECODE_CASE)
+    }
+    return CHIP8_OP_UNKNOWN;
+}
+
+/**
+ * @brief Check whether an instruction may be followed by anything else than the next one,
+ *        because it changes PC or writes memory that may hold code.
+ * 
+ * @param op The instruction.
+ * @return true Control may not reach the next instruction.
+ * @return false The next instruction always runs after it.
+ */
+static inline bool chip8_isa_ends_block(enum chip8_op op)
+{
+    return chip8_isa_table[op].flags & (CHIP8_ISA_BRANCH | CHIP8_ISA_STORE);
+}
+
+int chip8_isa_disassemble(unsigned short opcode, char* text, size_t size);
+bool chip8_isa_assemble(const char* text, unsigned short* opcode);
+bool chip8_isa_parse_quirks(const char* text, unsigned int* quirks);
+
+#endif
\ No newline at end of file
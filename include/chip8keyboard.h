@@ -2,18 +2,56 @@
 #define CHIP8KEYBOARD_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include "config.h"
 
 struct chip8_keyboard
 {
-    bool keyboard[CHIP8_TOTAL_KEYS];
-    const char* keyboard_map;
+    /* Bit k is set while the virtual key k is held down */
+    _Atomic uint16_t state;
+    /* Set while LD Vx, K is waiting for a key press */
+    bool waiting;
+    /* Virtual key pressed while waiting, -1 when there is none yet */
+    signed char pressed;
+    /* Number of times the program has read the keyboard, used to time input latency */
+    unsigned int polls;
+    const int* keyboard_map;
+    /* Open-addressed table from the low byte of a host keycode to its virtual key, -1 for empty slots */
+    signed char lookup[CHIP8_KEYBOARD_LOOKUP_SIZE];
 };
 
-void chip8_keyboard_set_map(struct chip8_keyboard* keyboard, const char* map);
-int chip8_keyboard_map(struct chip8_keyboard* keyboard, char key);
+struct chip8_keyboard_event
+{
+    /* Time the event was captured, in SDL performance counter ticks */
+    uint64_t timestamp;
+    unsigned char key;
+    bool down;
+};
+
+/*
+    Single-producer single-consumer queue of key events.
+    The input thread pushes the events and the emulation thread pops them between instructions.
+*/
+struct chip8_keyboard_queue
+{
+    struct chip8_keyboard_event events[CHIP8_KEYBOARD_QUEUE_SIZE];
+    /* Total number of events pushed, only written by the producer */
+    _Atomic unsigned int head;
+    /* Total number of events popped, only written by the consumer */
+    _Atomic unsigned int tail;
+};
+
+void chip8_keyboard_set_map(struct chip8_keyboard* keyboard, const int* map);
+int chip8_keyboard_map(struct chip8_keyboard* keyboard, int key);
 void chip8_keyboard_down(struct chip8_keyboard* keyboard, int key);
 void chip8_keyboard_up(struct chip8_keyboard* keyboard, int key);
 bool chip8_keyboard_is_down(struct chip8_keyboard* keyboard, int key);
+int chip8_keyboard_take_press(struct chip8_keyboard* keyboard);
+void chip8_keyboard_apply(struct chip8_keyboard* keyboard, const struct chip8_keyboard_event* event);
+
+void chip8_keyboard_queue_init(struct chip8_keyboard_queue* queue);
+bool chip8_keyboard_queue_push(struct chip8_keyboard_queue* queue, const struct chip8_keyboard_event* event);
+bool chip8_keyboard_queue_pop(struct chip8_keyboard_queue* queue, struct chip8_keyboard_event* event);
 
 #endif
\ No newline at end of file
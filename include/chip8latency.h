@@ -0,0 +1,67 @@
+#ifndef CHIP8LATENCY_H
+#define CHIP8LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include "config.h"
+#include "chip8.h"
+
+enum chip8_latency_stage
+{
+    CHIP8_LATENCY_IDLE,
+    /* A key press has been applied, waiting for the program to read the keyboard */
+    CHIP8_LATENCY_PRESSED,
+    /* The program has read the keyboard, waiting for the screen to change */
+    CHIP8_LATENCY_OBSERVED,
+    /* The screen has changed, waiting for it to be presented */
+    CHIP8_LATENCY_CHANGED
+};
+
+struct chip8_latency_histogram
+{
+    unsigned int buckets[CHIP8_LATENCY_BUCKETS];
+    /* Samples longer than the last bucket */
+    unsigned int overflow;
+    unsigned int count;
+};
+
+/*
+    The emulation thread moves a sample from idle up to changed, and the presenter
+    thread moves it from changed back to idle, so each stage has a single writer.
+*/
+struct chip8_latency
+{
+    _Atomic int stage;
+    /* Performance counter ticks per second */
+    uint64_t frequency;
+    /* Timestamps of the sample in flight */
+    uint64_t event_time;
+    uint64_t observe_time;
+    uint64_t change_time;
+    /* Counters of the emulator when the sample entered its current stage */
+    unsigned int polls;
+    unsigned int screen_version;
+    /* Version of the screen that holds the change, presenting it completes the sample */
+    unsigned int change_version;
+    /* Presses that never reached the screen before the next press */
+    unsigned int abandoned;
+    /* Presses ignored because the previous change was not presented yet */
+    unsigned int overlapped;
+    /* Key press to first keyboard read */
+    struct chip8_latency_histogram observe;
+    /* Key press to first screen change after the read */
+    struct chip8_latency_histogram change;
+    /* Key press to the presentation of that change */
+    struct chip8_latency_histogram present;
+};
+
+void chip8_latency_init(struct chip8_latency* latency);
+void chip8_latency_key_event(struct chip8_latency* latency, struct chip8* chip8, const struct chip8_keyboard_event* event);
+void chip8_latency_exec(struct chip8_latency* latency, struct chip8* chip8);
+void chip8_latency_present(struct chip8_latency* latency, const struct chip8_screen* screen);
+unsigned int chip8_latency_percentile(const struct chip8_latency_histogram* histogram, int percentile);
+void chip8_latency_report(struct chip8_latency* latency, FILE* out);
+
+#endif
\ No newline at end of file
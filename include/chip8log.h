@@ -0,0 +1,135 @@
+#ifndef CHIP8LOG_H
+#define CHIP8LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "config.h"
+
+enum chip8_log_level
+{
+    CHIP8_LOG_LEVEL_DEBUG,
+    CHIP8_LOG_LEVEL_INFO,
+    CHIP8_LOG_LEVEL_WARNING,
+    CHIP8_LOG_LEVEL_ERROR,
+    CHIP8_LOG_LEVEL_NONE
+};
+
+/* Messages below this level are removed at compile time, it can be overridden with -D */
+#ifndef CHIP8_LOG_COMPILE_LEVEL
+#define CHIP8_LOG_COMPILE_LEVEL CHIP8_LOG_LEVEL_DEBUG
+#endif
+
+enum chip8_log_arg_type
+{
+    CHIP8_LOG_ARG_INT,
+    CHIP8_LOG_ARG_UINT,
+    CHIP8_LOG_ARG_DOUBLE,
+    CHIP8_LOG_ARG_STRING,
+    CHIP8_LOG_ARG_POINTER
+};
+
+/* Argument of a message, kept in binary form until the message is formatted */
+struct chip8_log_arg
+{
+    enum chip8_log_arg_type type;
+    union
+    {
+        long long i;
+        unsigned long long u;
+        double d;
+        const void* p;
+        /* Offset of a copied string in the text of the record */
+        unsigned int text;
+    } value;
+};
+
+static inline struct chip8_log_arg chip8_log_arg_int(long long value)
+{
+    struct chip8_log_arg arg = { CHIP8_LOG_ARG_INT, { .i = value } };
+    return arg;
+}
+
+static inline struct chip8_log_arg chip8_log_arg_uint(unsigned long long value)
+{
+    struct chip8_log_arg arg = { CHIP8_LOG_ARG_UINT, { .u = value } };
+    return arg;
+}
+
+static inline struct chip8_log_arg chip8_log_arg_double(double value)
+{
+    struct chip8_log_arg arg = { CHIP8_LOG_ARG_DOUBLE, { .d = value } };
+    return arg;
+}
+
+static inline struct chip8_log_arg chip8_log_arg_string(const char* value)
+{
+    struct chip8_log_arg arg = { CHIP8_LOG_ARG_STRING, { .p = value } };
+    return arg;
+}
+
+static inline struct chip8_log_arg chip8_log_arg_pointer(const void* value)
+{
+    struct chip8_log_arg arg = { CHIP8_LOG_ARG_POINTER, { .p = value } };
+    return arg;
+}
+
+/* Capture an argument with the type chosen from its C type */
+#define CHIP8_LOG_ARG(a) _Generic((a),                          \
+    char*: chip8_log_arg_string,                                \
+    const char*: chip8_log_arg_string,                          \
+    void*: chip8_log_arg_pointer,                               \
+    const void*: chip8_log_arg_pointer,                         \
+    float: chip8_log_arg_double,                                \
+    double: chip8_log_arg_double,                               \
+    unsigned char: chip8_log_arg_uint,                          \
+    unsigned short: chip8_log_arg_uint,                         \
+    unsigned int: chip8_log_arg_uint,                           \
+    unsigned long: chip8_log_arg_uint,                          \
+    unsigned long long: chip8_log_arg_uint,                     \
+    default: chip8_log_arg_int)(a)
+
+/* Expand to ", CHIP8_LOG_ARG(a)" for every argument, up to CHIP8_LOG_MAX_ARGS */
+#define CHIP8_LOG_NARGS(...) CHIP8_LOG_NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define CHIP8_LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+#define CHIP8_LOG_CAT(a, b) CHIP8_LOG_CAT_(a, b)
+#define CHIP8_LOG_CAT_(a, b) a##b
+#define CHIP8_LOG_ARGS(...) CHIP8_LOG_CAT(CHIP8_LOG_ARGS_, CHIP8_LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define CHIP8_LOG_ARGS_0(...)
+#define CHIP8_LOG_ARGS_1(a) , CHIP8_LOG_ARG(a)
+#define CHIP8_LOG_ARGS_2(a, ...) , CHIP8_LOG_ARG(a) CHIP8_LOG_ARGS_1(__VA_ARGS__)
+#define CHIP8_LOG_ARGS_3(a, ...) , CHIP8_LOG_ARG(a) CHIP8_LOG_ARGS_2(__VA_ARGS__)
+#define CHIP8_LOG_ARGS_4(a, ...) , CHIP8_LOG_ARG(a) CHIP8_LOG_ARGS_3(__VA_ARGS__)
+#define CHIP8_LOG_ARGS_5(a, ...) , CHIP8_LOG_ARG(a) CHIP8_LOG_ARGS_4(__VA_ARGS__)
+#define CHIP8_LOG_ARGS_6(a, ...) , CHIP8_LOG_ARG(a) CHIP8_LOG_ARGS_5(__VA_ARGS__)
+
+/*
+    Log a message with printf-like format. The format must be a string literal:
+    only the arguments are captured, the message is formatted by the logging thread.
+*/
+#define CHIP8_LOG(level, format, ...)                                                           \
+    do                                                                                          \
+    {                                                                                           \
+        if ((level) >= CHIP8_LOG_COMPILE_LEVEL && chip8_log_is_enabled(level))                  \
+        {                                                                                       \
+            struct chip8_log_arg chip8_log_args_[] =                                            \
+                { chip8_log_arg_int(0) CHIP8_LOG_ARGS(__VA_ARGS__) };                           \
+            chip8_log_write((level), __FILE__, __LINE__, (format),                              \
+                            chip8_log_args_ + 1,                                                \
+                            sizeof(chip8_log_args_) / sizeof(chip8_log_args_[0]) - 1);          \
+        }                                                                                       \
+    } while (0)
+
+#define CHIP8_LOG_DEBUG(format, ...)   CHIP8_LOG(CHIP8_LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#define CHIP8_LOG_INFO(format, ...)    CHIP8_LOG(CHIP8_LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define CHIP8_LOG_WARNING(format, ...) CHIP8_LOG(CHIP8_LOG_LEVEL_WARNING, format, ##__VA_ARGS__)
+#define CHIP8_LOG_ERROR(format, ...)   CHIP8_LOG(CHIP8_LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+
+void chip8_log_set_level(enum chip8_log_level level);
+bool chip8_log_is_enabled(enum chip8_log_level level);
+void chip8_log_write(enum chip8_log_level level, const char* file, int line, const char* format, const struct chip8_log_arg* args, int count);
+void chip8_log_start(FILE* out);
+void chip8_log_stop(void);
+unsigned int chip8_log_dropped(void);
+
+#endif
\ No newline at end of file
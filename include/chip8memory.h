@@ -2,16 +2,34 @@
 #define CHIP8MEMORY_H
 
 #include "config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* A page of memory, owned by every instance that references it */
+struct chip8_memory_page
+{
+    _Atomic unsigned int references;
+    unsigned char bytes[CHIP8_MEMORY_PAGE_SIZE];
+};
 
 struct chip8_memory
 {
-    /* Store 4096 bytes for the emulator memory */
-    unsigned char memory[CHIP8_MEMORY_SIZE];
+    /* The 4096 bytes of the emulator memory, a page is copied before its first write when shared */
+    struct chip8_memory_page* pages[CHIP8_MEMORY_PAGES];
+    /* Incremental hash of the bytes, see chip8hash.h */
+    uint64_t hash;
 };
 
+void chip8_memory_init(struct chip8_memory* memory);
+void chip8_memory_free(struct chip8_memory* memory);
+void chip8_memory_share(struct chip8_memory* memory, const struct chip8_memory* source);
+bool chip8_memory_equal(const struct chip8_memory* a, const struct chip8_memory* b);
 void chip8_memory_set(struct chip8_memory* memory, int index, unsigned char value);
-unsigned char chip8_memory_get(struct chip8_memory* memory, int index);
-unsigned short chip8_memory_get_short(struct chip8_memory* memory, int index);
+void chip8_memory_copy(struct chip8_memory* memory, int index, const void* data, size_t size);
+unsigned char chip8_memory_get(const struct chip8_memory* memory, int index);
+unsigned short chip8_memory_get_short(const struct chip8_memory* memory, int index);
 
 
 
@@ -0,0 +1,60 @@
+#ifndef CHIP8OBSERVATION_H
+#define CHIP8OBSERVATION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "chip8screen.h"
+
+/*
+    Conversion of packed screens into the planes fed to agents. The output of a batch
+    is laid out as [instance][stacked frame][row][column], the most recent frame first.
+*/
+
+enum chip8_observation_format
+{
+    /* One uint8_t per pixel, 0 or 1 */
+    CHIP8_OBSERVATION_U8,
+    /* One float per pixel, 0.0 or 1.0 */
+    CHIP8_OBSERVATION_F32
+};
+
+enum chip8_observation_kernel
+{
+    CHIP8_OBSERVATION_KERNEL_AUTO,
+    CHIP8_OBSERVATION_KERNEL_SCALAR,
+    CHIP8_OBSERVATION_KERNEL_SSE2,
+    CHIP8_OBSERVATION_KERNEL_AVX2
+};
+
+struct chip8_observation_config
+{
+    enum chip8_observation_format format;
+    /* Number of frames of each observation, up to CHIP8_OBSERVATION_MAX_STACK */
+    int stack;
+    /* Each frame is the pixel-wise max of itself and the frame before, which hides sprite flicker */
+    bool max_pool;
+    /* Halve both dimensions with a 2x2 max-pool */
+    bool downsample;
+};
+
+/* Last frames of one instance */
+struct chip8_observation_history
+{
+    uint64_t frames[CHIP8_OBSERVATION_HISTORY][CHIP8_HEIGHT];
+    /* Index of the most recent frame */
+    unsigned int head;
+};
+
+bool chip8_observation_set_kernel(enum chip8_observation_kernel kernel);
+enum chip8_observation_kernel chip8_observation_get_kernel(void);
+void chip8_observation_expand_u8(const uint64_t* words, int total_words, uint8_t* out);
+void chip8_observation_expand_f32(const uint64_t* words, int total_words, float* out);
+void chip8_observation_reset(struct chip8_observation_history* history, const struct chip8_screen* screen);
+void chip8_observation_push(struct chip8_observation_history* history, const struct chip8_screen* screen);
+size_t chip8_observation_size(const struct chip8_observation_config* config);
+void chip8_observation_write(const struct chip8_observation_config* config,
+                             const struct chip8_observation_history* histories, int count, void* out);
+
+#endif
\ No newline at end of file
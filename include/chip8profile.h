@@ -0,0 +1,50 @@
+#ifndef CHIP8PROFILE_H
+#define CHIP8PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+
+enum chip8_profile_event_type
+{
+    CHIP8_PROFILE_SPAN,
+    CHIP8_PROFILE_COUNTER
+};
+
+struct chip8_profile_event
+{
+    /* Must be a string literal, it is only read when the profile is written */
+    const char* name;
+    uint64_t start;
+    /* End of a span, or value of a counter */
+    uint64_t value;
+    enum chip8_profile_event_type type;
+};
+
+/* Events of one thread, only written by that thread */
+struct chip8_profile_track
+{
+    const char* name;
+    unsigned int count;
+    /* Events lost because the track was full */
+    unsigned int dropped;
+    struct chip8_profile_event events[CHIP8_PROFILE_EVENTS];
+};
+
+struct chip8_profile
+{
+    bool enabled;
+    /* Performance counter ticks per second, and time of the first event */
+    uint64_t frequency;
+    uint64_t origin;
+    struct chip8_profile_track tracks[CHIP8_PROFILE_TRACKS];
+};
+
+void chip8_profile_init(struct chip8_profile* profile, bool enabled);
+struct chip8_profile_track* chip8_profile_track(struct chip8_profile* profile, int index, const char* name);
+uint64_t chip8_profile_begin(struct chip8_profile* profile);
+void chip8_profile_end(struct chip8_profile* profile, struct chip8_profile_track* track, const char* name, uint64_t start);
+void chip8_profile_counter(struct chip8_profile* profile, struct chip8_profile_track* track, const char* name, uint64_t value);
+bool chip8_profile_write(struct chip8_profile* profile, const char* filename);
+
+#endif
\ No newline at end of file
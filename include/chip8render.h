@@ -0,0 +1,16 @@
+#ifndef CHIP8RENDER_H
+#define CHIP8RENDER_H
+
+#include <stdint.h>
+#include "config.h"
+#include "chip8screen.h"
+
+/*
+    Software rendering of a screen into 32-bit pixels at an integer scale, for hosts where
+    drawing rectangles through a renderer is slow. Each row is expanded once into a scaled
+    line, which is then copied into the scale lines of the row.
+*/
+
+void chip8_render_argb(const struct chip8_screen* screen, uint32_t* pixels, int pitch, int scale, uint32_t on, uint32_t off);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef CHIP8ROMPACK_H
+#define CHIP8ROMPACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+struct chip8;
+
+#define CHIP8_ROMPACK_MAGIC     0x4b503843 /* "C8PK" */
+#define CHIP8_ROMPACK_VERSION   2
+#define CHIP8_ROMPACK_NAME_SIZE 32
+/* Alignment of the ROM images in the pack */
+#define CHIP8_ROMPACK_ALIGNMENT 16
+
+/* Instructions found in a ROM whose behaviour differs between CHIP-8 variants */
+#define CHIP8_ROM_USES_SHIFT        0x0001 /* 8xy6, 8xyE */
+#define CHIP8_ROM_USES_LOGIC        0x0002 /* 8xy1, 8xy2, 8xy3 */
+#define CHIP8_ROM_USES_LOAD_STORE   0x0004 /* Fx55, Fx65 */
+#define CHIP8_ROM_USES_JUMP_OFFSET  0x0008 /* Bnnn */
+#define CHIP8_ROM_USES_WAIT_KEY     0x0010 /* Fx0A */
+#define CHIP8_ROM_USES_BCD          0x0020 /* Fx33 */
+
+struct chip8_rompack_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+/* Index entry of a ROM, the entries are sorted by name */
+struct chip8_rompack_entry
+{
+    char name[CHIP8_ROMPACK_NAME_SIZE];
+    /* FNV-1a hash of the ROM image */
+    uint64_t hash;
+    /* Position of the ROM image from the beginning of the pack */
+    uint32_t offset;
+    uint32_t size;
+    /* CHIP8_ROM_USES_* flags */
+    uint32_t uses;
+    /* CHIP8_QUIRK_* profile the ROM runs with, 0 unless the pack was built with one */
+    uint32_t quirks;
+    /* First instruction, and the address it jumps to (the load address when it is not a jump) */
+    uint16_t entry_opcode;
+    uint16_t entry_target;
+};
+
+struct chip8_rompack
+{
+    const unsigned char* data;
+    size_t size;
+    const struct chip8_rompack_header* header;
+    const struct chip8_rompack_entry* entries;
+    /* Platform handle of the mapping */
+    void* mapping;
+};
+
+uint64_t chip8_rom_hash(const unsigned char* data, size_t size);
+void chip8_rom_analyze(struct chip8_rompack_entry* entry, const unsigned char* data, size_t size);
+
+bool chip8_rompack_open(struct chip8_rompack* pack, const char* filename);
+void chip8_rompack_close(struct chip8_rompack* pack);
+const struct chip8_rompack_entry* chip8_rompack_find(const struct chip8_rompack* pack, const char* name);
+const unsigned char* chip8_rompack_data(const struct chip8_rompack* pack, const struct chip8_rompack_entry* entry);
+void chip8_rompack_load(const struct chip8_rompack* pack, const struct chip8_rompack_entry* entry, struct chip8* chip8);
+
+#endif
\ No newline at end of file
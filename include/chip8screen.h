@@ -2,16 +2,26 @@
 #define CHIP8SCREEN_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "config.h"
 
 struct chip8_screen
 {
-    bool pixels[CHIP8_HEIGHT][CHIP8_WIDTH];
+    /* Each row is packed in a 64-bit word, the most significant bit is the leftmost pixel */
+    uint64_t pixels[CHIP8_HEIGHT];
+    /* Incremented every time the pixels are modified */
+    unsigned int version;
+    /* Incremental hash of the rows, see chip8hash.h */
+    uint64_t hash;
 };
 
 void chip8_screen_clear(struct chip8_screen* screen);
 void chip8_screen_set(struct chip8_screen* screen, int x, int y);
-bool chip8_screen_is_set(struct chip8_screen* screen, int x, int y);
+bool chip8_screen_is_set(const struct chip8_screen* screen, int x, int y);
+uint64_t chip8_screen_sprite_row(unsigned char byte, int x);
 bool chip8_screen_draw_sprite(struct chip8_screen* screen, int x, int y, const char* sprite, int size);
+bool chip8_screen_draw_sprite_clipped(struct chip8_screen* screen, int x, int y, const char* sprite, int size);
+bool chip8_screen_draw_rows(struct chip8_screen* screen, int x, int y, const uint64_t* rows, int size);
+bool chip8_screen_draw_rows_clipped(struct chip8_screen* screen, int x, int y, const uint64_t* rows, int size);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,102 @@
+#ifndef CHIP8SHARED_H
+#define CHIP8SHARED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "config.h"
+#include "chip8registers.h"
+
+/*
+    Control plane shared with an orchestrator process. The emulator creates a named
+    shared memory segment holding one control block per instance; the orchestrator
+    maps it, queues commands, sets the keypad and reads the frames in place.
+    Every field is written by one side only.
+*/
+
+#define CHIP8_SHARED_MAGIC      0x48533843 /* "C8SH" */
+#define CHIP8_SHARED_VERSION    1
+
+/* Size of a cache line, the fields written by each side are kept apart */
+#define CHIP8_SHARED_LINE       64
+
+enum chip8_shared_command_type
+{
+    /* Start over from the loaded ROM, the generator behind RND carries on where it was */
+    CHIP8_SHARED_COMMAND_RESET = 1,
+    /* Run argument frames with the current keypad, then publish the frame */
+    CHIP8_SHARED_COMMAND_STEP,
+    /* Seed the generator behind RND with argument */
+    CHIP8_SHARED_COMMAND_SEED
+};
+
+struct chip8_shared_command
+{
+    uint32_t type;
+    uint32_t argument;
+};
+
+/* Frame published by the emulator, sequence is odd while it is being written */
+struct chip8_shared_frame
+{
+    _Atomic uint32_t sequence;
+    uint32_t reserved;
+    uint64_t frame;
+    uint64_t pixels[CHIP8_HEIGHT];
+    struct chip8_registers registers;
+};
+
+struct chip8_shared_instance
+{
+    /* Written by the orchestrator */
+    struct chip8_shared_command commands[CHIP8_SHARED_COMMANDS];
+    _Atomic uint32_t command_head;
+    /* Bit k is set while the virtual key k is held down */
+    _Atomic uint16_t keypad;
+
+    /* Written by the emulator */
+    _Alignas(CHIP8_SHARED_LINE) _Atomic uint32_t command_tail;
+    /* Frames run since the instance has been created */
+    _Atomic uint64_t frames;
+    /* Buffer holding the last complete frame */
+    _Atomic uint32_t published;
+    struct chip8_shared_frame buffers[2];
+};
+
+struct chip8_shared_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t instance_size;
+    /* Set by the orchestrator to stop the emulator */
+    _Atomic uint32_t stop;
+};
+
+struct chip8_shared
+{
+    struct chip8_shared_header* header;
+    struct chip8_shared_instance* instances;
+    /* Number of instances, read once when mapped since the other side can write the header */
+    int count;
+    size_t size;
+    /* Mapping handle on Windows, unused elsewhere */
+    void* mapping;
+    /* Set for the process that has created the segment */
+    bool owner;
+    char name[64];
+};
+
+struct chip8;
+
+bool chip8_shared_create(struct chip8_shared* shared, const char* name, int count);
+bool chip8_shared_open(struct chip8_shared* shared, const char* name);
+void chip8_shared_close(struct chip8_shared* shared);
+bool chip8_shared_push(struct chip8_shared_instance* instance, uint32_t type, uint32_t argument);
+bool chip8_shared_idle(struct chip8_shared_instance* instance);
+const struct chip8_shared_frame* chip8_shared_begin_read(struct chip8_shared_instance* instance, uint32_t* sequence);
+bool chip8_shared_end_read(const struct chip8_shared_frame* frame, uint32_t sequence);
+void chip8_shared_serve(struct chip8_shared* shared, const struct chip8* initial, int threads);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef CHIP8SPRITECACHE_H
+#define CHIP8SPRITECACHE_H
+
+#include <stdint.h>
+#include "config.h"
+#include "chip8memory.h"
+
+struct chip8_sprite_cache_entry
+{
+    unsigned short address;
+    /* Number of rows of the sprite, 0 marks an unused entry */
+    unsigned char height;
+    /* Bit x is set when the rows pre-shifted to the x offset have been built */
+    uint64_t built;
+    uint64_t rows[CHIP8_WIDTH][CHIP8_SPRITE_MAX_HEIGHT];
+};
+
+struct chip8_sprite_cache
+{
+    struct chip8_sprite_cache_entry entries[CHIP8_SPRITE_CACHE_ENTRIES];
+    /* Next entry to be replaced when the cache is full */
+    unsigned char victim;
+};
+
+void chip8_sprite_cache_clear(struct chip8_sprite_cache* cache);
+const uint64_t* chip8_sprite_cache_get(struct chip8_sprite_cache* cache, struct chip8_memory* memory, int address, int height, int x);
+void chip8_sprite_cache_invalidate(struct chip8_sprite_cache* cache, int index);
+
+#endif
\ No newline at end of file
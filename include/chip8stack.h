@@ -2,12 +2,15 @@
 #define CHIP8STACK_H
 
 #include "config.h"
+#include <stdint.h>
 
 struct chip8;
 
 struct chip8_stack
 {
     unsigned short stack[CHIP8_TOTAL_STACK_DEPTH];
+    /* Incremental hash of the slots, see chip8hash.h */
+    uint64_t hash;
 };
 
 void chip8_stack_push(struct chip8* chip8, unsigned short val);
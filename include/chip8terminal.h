@@ -0,0 +1,46 @@
+#ifndef CHIP8TERMINAL_H
+#define CHIP8TERMINAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+#include "chip8screen.h"
+
+/*
+    Presenter drawing the screen on a text terminal with ANSI escape codes, to watch
+    an instance over SSH. The terminal keeps the previous frame, so only the cells that
+    changed are written, each frame in a single write.
+*/
+
+enum chip8_terminal_cells
+{
+    /* One cell per 1x2 pixels, with the half block characters: 64x16 cells */
+    CHIP8_TERMINAL_HALF_BLOCKS,
+    /* One cell per 2x4 pixels, with the braille characters: 32x8 cells */
+    CHIP8_TERMINAL_BRAILLE
+};
+
+/* Longest cursor move, ESC [ row ; column H */
+#define CHIP8_TERMINAL_MOVE_SIZE    8
+/* Longest character of a cell in UTF-8 */
+#define CHIP8_TERMINAL_CELL_SIZE    3
+/* Bound on a frame: every cell of the smallest cells changing, each with its own move */
+#define CHIP8_TERMINAL_BUFFER_SIZE  (CHIP8_WIDTH * CHIP8_HEIGHT / 2 * (CHIP8_TERMINAL_MOVE_SIZE + CHIP8_TERMINAL_CELL_SIZE) + 1)
+
+struct chip8_terminal
+{
+    int fd;
+    enum chip8_terminal_cells cells;
+    /* Pixels shown by the terminal */
+    uint64_t shown[CHIP8_HEIGHT];
+    /* Frames that changed the terminal and bytes written for them */
+    uint64_t frames;
+    uint64_t bytes;
+    char buffer[CHIP8_TERMINAL_BUFFER_SIZE];
+};
+
+bool chip8_terminal_open(struct chip8_terminal* terminal, int fd, enum chip8_terminal_cells cells);
+bool chip8_terminal_present(struct chip8_terminal* terminal, const struct chip8_screen* screen);
+void chip8_terminal_close(struct chip8_terminal* terminal);
+
+#endif
\ No newline at end of file
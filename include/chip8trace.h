@@ -0,0 +1,66 @@
+#ifndef CHIP8TRACE_H
+#define CHIP8TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <SDL2/SDL_thread.h>
+#include "config.h"
+
+struct chip8;
+
+#define CHIP8_TRACE_MAGIC   0x52543843 /* "C8TR" */
+#define CHIP8_TRACE_VERSION 1
+
+/* Header at the beginning of a trace file, followed by the records */
+struct chip8_trace_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+};
+
+/* State of the machine after one instruction */
+struct chip8_trace_record
+{
+    /* Index of the instruction since the trace started (low 32 bits) */
+    uint32_t sequence;
+    /* Address and value of the instruction */
+    uint16_t PC;
+    uint16_t opcode;
+    uint16_t I;
+    /* Bit r is set when Vr has been changed by the instruction */
+    uint16_t changed;
+    uint8_t V[CHIP8_TOTAL_DATA_REGISTERS];
+    uint8_t SP;
+    uint8_t delay_timer;
+};
+
+struct chip8_trace
+{
+    struct chip8_trace_record records[CHIP8_TRACE_RECORDS];
+    /* Total number of records written, only written by the emulation thread */
+    _Atomic uint32_t head;
+    /* Tracing can be toggled from any thread */
+    atomic_bool enabled;
+    /* Spill file and the thread that writes the records to it */
+    FILE* file;
+    SDL_Thread* writer;
+    atomic_bool stop;
+    /* Records written to the file, only used by the writer thread */
+    uint32_t spilled;
+    /* Records overwritten before the writer could save them */
+    _Atomic uint32_t dropped;
+};
+
+void chip8_trace_init(struct chip8_trace* trace);
+void chip8_trace_set_enabled(struct chip8_trace* trace, bool enabled);
+bool chip8_trace_is_enabled(struct chip8_trace* trace);
+void chip8_trace_step(struct chip8_trace* trace, struct chip8* chip8);
+bool chip8_trace_open(struct chip8_trace* trace, const char* filename);
+void chip8_trace_close(struct chip8_trace* trace);
+bool chip8_trace_dump(struct chip8_trace* trace, const char* filename);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef CHIP8TRIPLEBUFFER_H
+#define CHIP8TRIPLEBUFFER_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "chip8screen.h"
+
+/*
+    Lock-free triple buffer of screens between one writer (the emulation thread)
+    and one reader (the presenter). The writer never waits and the reader always
+    gets the most recent complete frame.
+*/
+struct chip8_triple_buffer
+{
+    struct chip8_screen buffers[3];
+    /* Index of the buffer exchanged between both threads, CHIP8_TRIPLE_BUFFER_FRESH is set when it holds an unread frame */
+    _Atomic unsigned char middle;
+    /* Buffer written by the writer */
+    unsigned char back;
+    /* Buffer read by the reader */
+    unsigned char front;
+};
+
+#define CHIP8_TRIPLE_BUFFER_FRESH 0x04
+
+void chip8_triple_buffer_init(struct chip8_triple_buffer* buffer);
+struct chip8_screen* chip8_triple_buffer_back(struct chip8_triple_buffer* buffer);
+void chip8_triple_buffer_publish(struct chip8_triple_buffer* buffer);
+bool chip8_triple_buffer_acquire(struct chip8_triple_buffer* buffer);
+const struct chip8_screen* chip8_triple_buffer_front(struct chip8_triple_buffer* buffer);
+
+#endif
\ No newline at end of file
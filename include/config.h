@@ -2,22 +2,83 @@
 #define CONFIG_H
 
 #define EMULATOR_WINDOW_TITLE "Chip-8 Emulator"
+/* Bumped whenever saved blocks would run differently, so that older block files are ignored */
+#define EMULATOR_VERSION 2
 
 #define CHIP8_MEMORY_SIZE   4096
 #define CHIP8_WIDTH         64
 #define CHIP8_HEIGHT        32
 #define CHIP8_WINDOW_SCALE  10
+#define CHIP8_MAX_WINDOW_SCALE  40
+
+/* Colors of the pixels drawn by the software renderer, as ARGB */
+#define CHIP8_PIXEL_ON_COLOR    0xffffffff
+#define CHIP8_PIXEL_OFF_COLOR   0xff000000
 
 #define CHIP8_PROGRAM_LOAD_ADDRESS  0x200
 
+/* Memory is split in pages shared copy-on-write between forked instances */
+#define CHIP8_MEMORY_PAGE_SIZE      256
+#define CHIP8_MEMORY_PAGES          (CHIP8_MEMORY_SIZE / CHIP8_MEMORY_PAGE_SIZE)
+
+#define CHIP8_FRAMES_PER_SECOND         60
+#define CHIP8_INSTRUCTIONS_PER_FRAME    10
+#define CHIP8_MAX_RUN_AHEAD_FRAMES      8
+
 #define CHIP8_TOTAL_DATA_REGISTERS  16
 #define CHIP8_TOTAL_STACK_DEPTH     16
 
 #define CHIP8_TOTAL_KEYS 16
+#define CHIP8_KEYBOARD_LOOKUP_SIZE  256
+#define CHIP8_KEYBOARD_QUEUE_SIZE   64
 
 #define CHIP8_CHARACTER_SET_LOAD_ADDRESS    0x00
 
 #define CHIP8_DEFAULT_SPRITE_HEIGHT 5 
+#define CHIP8_SPRITE_MAX_HEIGHT     15
+
+#define CHIP8_SPRITE_CACHE_ENTRIES  16
+
+/* Number of records of the execution trace ring buffer, must be a power of two */
+#define CHIP8_TRACE_RECORDS         65536
+#define CHIP8_TRACE_DEFAULT_FILE    "chip8.trace"
+
+/* Capacity of every thread track of the frame profiler */
+#define CHIP8_PROFILE_EVENTS        131072
+#define CHIP8_PROFILE_TRACKS        4
+
+/* Number of records of the log queue, must be a power of two */
+#define CHIP8_LOG_RECORDS           1024
+#define CHIP8_LOG_MAX_ARGS          6
+#define CHIP8_LOG_TEXT_SIZE         96
+
+/* Limits of the vectorized environments */
+#define CHIP8_ENV_MAX_PROBES        8
+#define CHIP8_ENV_MAX_THREADS       64
+
+/* Frames kept by an observation history, must be a power of two larger than the deepest stack */
+#define CHIP8_OBSERVATION_HISTORY   8
+#define CHIP8_OBSERVATION_MAX_STACK 4
+
+/* Commands queued per instance of the shared control plane, must be a power of two */
+#define CHIP8_SHARED_COMMANDS       64
+#define CHIP8_SHARED_MAX_INSTANCES  4096
+
+/* Pre-decoded blocks: longest block, executions of an entry before it is compiled, pending compilations */
+#define CHIP8_BLOCK_MAX_OPS         32
+#define CHIP8_BLOCK_HOT_THRESHOLD   32
+#define CHIP8_BLOCK_QUEUE_SIZE      256
+/* Granularity at which writes are checked against the code held by blocks */
+#define CHIP8_BLOCK_PAGE_SIZE       64
+/* Distinct ROMs whose blocks are shared between instances */
+#define CHIP8_BLOCK_REGISTRY_SIZE   64
+/* Computed jumps remembered per instance, and offsets remembered per jump */
+#define CHIP8_BLOCK_JUMP_SITES      16
+#define CHIP8_BLOCK_JUMP_WAYS       4
+
+/* Latency histograms have one bucket per CHIP8_LATENCY_BUCKET_US microseconds */
+#define CHIP8_LATENCY_BUCKETS       2000
+#define CHIP8_LATENCY_BUCKET_US     100
 
 
 #endif
\ No newline at end of file
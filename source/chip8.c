@@ -1,9 +1,10 @@
 #include "chip8.h"
+#include "chip8log.h"
+#include "chip8hash.h"
 #include <memory.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <time.h>
-#include <SDL2/SDL.h>
 
 
 /*  
@@ -33,6 +34,7 @@ const char chip8_default_character_set[] =
 
 /**
  * @brief Initialize all members of the chip8 struct to 0 and load the default character set.
+ *        An instance that has already been used must be released with chip8_free first.
  * 
  * @param chip8 Pointer to a chip8 struct.
  * @return Void.
@@ -40,7 +42,75 @@ const char chip8_default_character_set[] =
 void chip8_init(struct chip8* chip8)
 {
     memset(chip8, 0, sizeof(struct chip8));
-    memcpy(&chip8->memory.memory, chip8_default_character_set, sizeof(chip8_default_character_set));
+    chip8_memory_init(&chip8->memory);
+    chip8_memory_copy(&chip8->memory, CHIP8_CHARACTER_SET_LOAD_ADDRESS, chip8_default_character_set, sizeof(chip8_default_character_set));
+    chip8_seed(chip8, (uint32_t) time(NULL) ^ (uint32_t) clock());
+}
+
+
+/**
+ * @brief Seed the generator behind RND, an instance always draws the same numbers from the same seed.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param seed Any value.
+ * @return Void.
+ */
+void chip8_seed(struct chip8* chip8, uint32_t seed)
+{
+    chip8->random = seed ? seed : 0x9e3779b9;
+}
+
+
+/**
+ * @brief Draw the next random byte of an instance (xorshift32).
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @return unsigned char The random byte.
+ */
+unsigned char chip8_random(struct chip8* chip8)
+{
+    uint32_t x = chip8->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    chip8->random = x;
+    return x >> 24;
+}
+
+
+/**
+ * @brief Release the memory pages of an instance and its reference on the block cache.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @return Void.
+ */
+void chip8_free(struct chip8* chip8)
+{
+    chip8_memory_free(&chip8->memory);
+    chip8_block_cache_release(chip8->block_cache);
+    chip8->block_cache = NULL;
+}
+
+
+/**
+ * @brief Stop trusting the blocks of the instance after its whole memory may have changed.
+ *        A private cache is cleared, while a shared one is kept and every block it holds is
+ *        checked against the memory of the instance before being run.
+ * 
+ * @param chip8 Pointer to a chip8 struct with a block cache.
+ * @return Void.
+ */
+static void chip8_forget_blocks(struct chip8* chip8)
+{
+    struct chip8_block_cache* cache = chip8->block_cache;
+    bool matches = !cache->shared || chip8_memory_equal(&chip8->memory, &cache->reference);
+    memset(chip8->written, matches ? 0 : 0xff, sizeof(chip8->written));
+    memset(chip8->shadow_stack, 0, sizeof(chip8->shadow_stack));
+    memset(chip8->jump_sites, 0, sizeof(chip8->jump_sites));
+    if (!cache->shared)
+    {
+        chip8_block_cache_clear(cache);
+    }
 }
 
 
@@ -54,313 +124,484 @@ void chip8_init(struct chip8* chip8)
 void chip8_load(struct chip8* chip8, const char* buffer, size_t size)
 {
     assert( (CHIP8_PROGRAM_LOAD_ADDRESS + size) < CHIP8_MEMORY_SIZE );
-    memcpy(&chip8->memory.memory[CHIP8_PROGRAM_LOAD_ADDRESS], buffer, size);
+    chip8_memory_copy(&chip8->memory, CHIP8_PROGRAM_LOAD_ADDRESS, buffer, size);
     chip8->registers.PC = CHIP8_PROGRAM_LOAD_ADDRESS;
+    if (chip8->sprite_cache)
+    {
+        chip8_sprite_cache_clear(chip8->sprite_cache);
+    }
+    if (chip8->block_cache)
+    {
+        chip8_forget_blocks(chip8);
+    }
 }
 
 
 /**
- * @brief Block the program until a key is pressed.
+ * @brief Attach a sprite cache to the instance, or detach it with NULL.
  * 
  * @param chip8 Pointer to a chip8 struct.
- * @return char The key that has been pressed.
+ * @param cache Pointer to a chip8_sprite_cache struct, or NULL to draw sprites uncached.
+ * @return Void.
  */
-static char chip8_wait_for_key_press(struct chip8* chip8)
+void chip8_set_sprite_cache(struct chip8* chip8, struct chip8_sprite_cache* cache)
 {
-    SDL_Event event;
-    while (SDL_WaitEvent(&event))
+    chip8->sprite_cache = cache;
+    if (cache)
     {
-        if (event.type != SDL_KEYDOWN)
-            continue;
+        chip8_sprite_cache_clear(cache);
+    }
+}
+
+
+/**
+ * @brief Attach a block cache to the instance, or detach it with NULL.
+ *        The instance takes a reference on the cache, dropped by chip8_free.
+ *        A private cache is cleared, a shared one (see chip8_block_cache_shared) keeps its blocks.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param cache Pointer to a chip8_block_cache struct, or NULL to interpret every instruction.
+ * @return Void.
+ */
+void chip8_set_block_cache(struct chip8* chip8, struct chip8_block_cache* cache)
+{
+    if (cache)
+    {
+        chip8_block_cache_retain(cache);
+    }
+    chip8_block_cache_release(chip8->block_cache);
+    chip8->block_cache = cache;
+    if (cache)
+    {
+        chip8_forget_blocks(chip8);
+    }
+}
+
+
+/**
+ * @brief Store a byte in memory, discarding any cached sprite or block that reads it.
+ *        Shared blocks are not discarded, the byte is checked when a block holding it is run.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param index An index to access the desired memory byte.
+ * @param value The value that will be stored.
+ * @return Void.
+ */
+void chip8_store(struct chip8* chip8, int index, unsigned char value)
+{
+    chip8_memory_set(&chip8->memory, index, value);
+    if (chip8->sprite_cache)
+    {
+        chip8_sprite_cache_invalidate(chip8->sprite_cache, index);
+    }
+
+    struct chip8_block_cache* blocks = chip8->block_cache;
+    if (!blocks)
+    {
+        return;
+    }
+    if (blocks->shared)
+    {
+        chip8->written[index / CHIP8_BLOCK_PAGE_SIZE] |= 1ULL << index % CHIP8_BLOCK_PAGE_SIZE;
+    }
+    else if (chip8_block_cache_holds(blocks, index))
+    {
+        chip8_block_cache_invalidate(blocks, index);
+    }
+}
+
+
+/**
+ * @brief Report an opcode that the emulator does not implement. The instruction is skipped.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param opcode Operation code that could not be executed.
+ * @return Void.
+ */
+void chip8_unknown_opcode(struct chip8* chip8, unsigned short opcode)
+{
+    CHIP8_LOG_WARNING("Unknown opcode %04x at %03x", opcode, chip8->registers.PC - 2);
+}
 
-        char c = event.key.keysym.sym;
-        char chip8_key = chip8_keyboard_map(&chip8->keyboard, c);
-        if (chip8_key != -1)
+
+/**
+ * @brief Draw a sprite of n rows read from I, through the sprite cache when the instance has one.
+ *        Always inlined into chip8_draw and chip8_draw_clipped, where clip is a constant.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param column Column of the top left pixel.
+ * @param row Row of the top left pixel.
+ * @param n Height of the sprite.
+ * @param clip Clip the sprite at the edges of the screen instead of wrapping it around.
+ * @return bool True if a pixel has been erased.
+ */
+static inline __attribute__((always_inline)) bool chip8_draw_profile(struct chip8* chip8, unsigned char column, unsigned char row, unsigned char n, const bool clip)
+{
+    bool collision;
+    if (chip8->sprite_cache && n > 0)
+    {
+        const uint64_t* rows = chip8_sprite_cache_get(chip8->sprite_cache,
+                                                      &chip8->memory,
+                                                      chip8->registers.I,
+                                                      n,
+                                                      column);
+        collision = clip ? chip8_screen_draw_rows_clipped(&chip8->screen, column, row, rows, n)
+                         : chip8_screen_draw_rows(&chip8->screen, column, row, rows, n);
+    }
+    else
+    {
+        char sprite[CHIP8_SPRITE_MAX_HEIGHT];
+        for (int i = 0 ; i < n ; i++)
         {
-            return chip8_key;
+            sprite[i] = chip8_memory_get(&chip8->memory, (chip8->registers.I + i) % CHIP8_MEMORY_SIZE);
         }
+        collision = clip ? chip8_screen_draw_sprite_clipped(&chip8->screen, column, row, sprite, n)
+                         : chip8_screen_draw_sprite(&chip8->screen, column, row, sprite, n);
     }
-    return -1;
+    chip8->stats.sprites += 1;
+    chip8->stats.collisions += collision;
+    return collision;
+}
+
+
+/**
+ * @brief Draw a sprite of n rows read from I, wrapping it around the edges of the screen.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param column Column of the top left pixel.
+ * @param row Row of the top left pixel.
+ * @param n Height of the sprite.
+ * @return bool True if a pixel has been erased.
+ */
+bool chip8_draw(struct chip8* chip8, unsigned char column, unsigned char row, unsigned char n)
+{
+    return chip8_draw_profile(chip8, column, row, n, false);
+}
+
+
+/**
+ * @brief Draw a sprite of n rows read from I, clipping it at the edges of the screen.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param column Column of the top left pixel.
+ * @param row Row of the top left pixel.
+ * @param n Height of the sprite.
+ * @return bool True if a pixel has been erased.
+ */
+bool chip8_draw_clipped(struct chip8* chip8, unsigned char column, unsigned char row, unsigned char n)
+{
+    return chip8_draw_profile(chip8, column, row, n, true);
 }
 
 
+#define CHIP8_EXEC_CASE(name, mask, match, format, flags, ...) \
+    case (match):                                             \
+    {                                                         \
+        __VA_ARGS__                                           \
+    }                                                         \
+    break;
+
 /**
- * @brief Extended version of @chip8_exec()
+ * @brief Execute the instruction specified by the opcode, as described in chip8isa.h.
+ *        Always inlined into the variants, where the quirks are a constant.
  * 
  * @param chip8 Pointer to a chip8 struct.
  * @param opcode Operation code to execute.
+ * @param quirks The quirk profile of the variant.
+ * @return Void.
  */
-static void chip8_exec_extended(struct chip8* chip8, unsigned short opcode)
+static inline __attribute__((always_inline)) void chip8_exec_profile(struct chip8* chip8, unsigned short opcode, const unsigned int quirks)
 {
+    unsigned char* V = chip8->registers.V;
     unsigned short nnn = opcode & 0x0fff;
     unsigned char x = (opcode & 0x0f00) >> 8;
     unsigned char y = (opcode & 0x00f0) >> 4;
     unsigned char kk = opcode & 0x00ff;
     unsigned char n = opcode & 0x000f;
-    unsigned short res = 0;
 
-    switch(opcode & 0xf000)
+    switch (opcode & CHIP8_ISA_GROUP_MASK(opcode >> 12))
     {
-        /* JP addr: Jump to location nnn (0x1nnn) */
-        case 0x1000:
-            chip8->registers.PC = nnn;
-        break;
+        CHIP8_ISA(CHIP8_EXEC_CASE)
 
-        /* CALL addr: Call subroutine at nnn (0x2nnn) */
-        case 0x2000:
-            chip8_stack_push(chip8, chip8->registers.PC);
-            chip8->registers.PC = nnn; 
+        default:
+            chip8_unknown_opcode(chip8, opcode);
         break;
+    }
+}
 
-        /* SE Vx, byte: Skip next instruction if Vx = kk (0x3xkk)*/
-        case 0x3000:
-            if (chip8->registers.V[x] == kk)
-            {
-                chip8->registers.PC += 2;
-            }
-        break;
 
-        /* SNE Vx, byte: Skip next instruction if Vx != kk (0x3xkk) */
-        case 0x4000:
-            if (chip8->registers.V[x] != kk)
-            {
-                chip8->registers.PC += 2;
-            }
-        break;
+/* One interpreter per quirk profile, the semantics never test the profile at run time */
+#define CHIP8_EXEC_VARIANT(profile)                                                 \
+    static void chip8_exec_##profile(struct chip8* chip8, unsigned short opcode)    \
+    {                                                                               \
+        chip8_exec_profile(chip8, opcode, profile);                                 \
+    }                                                                               \
+                                                                                    \
+    static void chip8_run_##profile(struct chip8* chip8, int instructions)          \
+    {                                                                               \
+        for (int i = 0 ; i < instructions ; i++)                                    \
+        {                                                                           \
+            unsigned short opcode = chip8_memory_get_short(&chip8->memory,          \
+                                                           chip8->registers.PC);    \
+            chip8->registers.PC += 2;                                               \
+            chip8->stats.instructions += 1;                                         \
+            chip8_exec_profile(chip8, opcode, profile);                             \
+        }                                                                           \
+    }
 
-        /* SE Vx, Vy: Skip next instruction if Vx = Vy (0x5xy0) */
-        case 0x5000:
-            if (chip8->registers.V[x] == chip8->registers.V[y])
-            {
-                chip8->registers.PC += 2;
-            }
-        break;
+CHIP8_QUIRK_EACH(CHIP8_EXEC_VARIANT)
 
-        /* LD Vx, byte: Set Vx = kk (0x6xkk) */
-        case 0x6000:
-            chip8->registers.V[x] = kk;
-        break;
+#define CHIP8_EXEC_ENTRY(profile) chip8_exec_##profile,
+#define CHIP8_RUN_ENTRY(profile) chip8_run_##profile,
 
-        /* ADD Vx, byte: Set Vx = Vx + kk (0x7xkk) */
-        case 0x7000:
-            chip8->registers.V[x] += kk;
-        break;
+static void (* const chip8_exec_variants[])(struct chip8*, unsigned short) = { CHIP8_QUIRK_EACH(CHIP8_EXEC_ENTRY) };
+static void (* const chip8_run_variants[])(struct chip8*, int) = { CHIP8_QUIRK_EACH(CHIP8_RUN_ENTRY) };
 
-        case 0x8000:
-            switch (opcode & 0x000f)
-            {
-                /* LD Vx, Vy: Set Vx = Vy (0x8xy0) */
-                case 0x00:
-                    chip8->registers.V[x] = chip8->registers.V[y];
-                break;
-
-                /* OR Vx, Vy: Set Vx = Vx OR Vy (0x8xy1) */
-                case 0x01:
-                    chip8->registers.V[x] |= chip8->registers.V[y];
-                break;
-
-                /* AND Vx, Vy: Set Vx = Vx AND Vy (0x8xy2) */
-                case 0x02:
-                    chip8->registers.V[x] &= chip8->registers.V[y];
-                break;
-
-                /* XOR Vx, Vy: Set Vx = Vx XOR Vy (0x8xy3) */
-                case 0x03:
-                    chip8->registers.V[x] ^= chip8->registers.V[y];
-                break;
-
-                /* ADD Vx, Vy: Set Vx = Vx + Vy, set VF = carry (0x8xy4) */
-                case 0x04:
-                    res = chip8->registers.V[x] + chip8->registers.V[y];
-                    chip8->registers.V[0x0f] = 0x00;
-                    if (res > 0xff)
-                    {
-                        chip8->registers.V[0x0f] = 0x01;
-                    }
-                    chip8->registers.V[x] = res;
-                break;
-
-                /* SUB Vx, Vy: Set Vx = Vx - Vy, set VF = NOT borrow (0x8xy5) */
-                case 0x05:
-                    chip8->registers.V[0x0f] = 0x00;
-                    if (chip8->registers.V[x] > chip8->registers.V[y])
-                    {
-                        chip8->registers.V[0x0f] = 0x01;
-                    }
-                    chip8->registers.V[x] -= chip8->registers.V[y];
-                break;
-
-                /* SHR Vx, {, Vy}: Set Vx = Vx SHR 1 (0x8xy6) */
-                case 0x06:
-                    chip8->registers.V[0x0f] = chip8->registers.V[x] & 0x01;
-                    chip8->registers.V[x] /= 2;
-                break;
-
-                /* SUBN Vx, Vy: Set Vx = Vy - Vx, set VF = NOT borrow (0x8xy7) */
-                case 0x07:
-                    chip8->registers.V[0x0f] = chip8->registers.V[y] > chip8->registers.V[x];
-                    chip8->registers.V[x] = chip8->registers.V[y] - chip8->registers.V[x];
-                break;
-
-                /* SHL Vx, {, Vy}: Set Vx = Vx SHL 1 (0x8xy8) */
-                case 0x08:
-                    chip8->registers.V[0x0f] = chip8->registers.V[x] & 0x80;
-                    chip8->registers.V[x] *= 2;
-                break;
-            }
-        break;
+_Static_assert(sizeof(chip8_exec_variants) / sizeof(chip8_exec_variants[0]) == CHIP8_QUIRK_PROFILES,
+               "every quirk profile must have an interpreter");
 
-        /* SNE Vx, Vy: Skip next instruction if Vx != Vy (0x9xy0) */
-        case 0x9000:
-            if (chip8->registers.V[x] != chip8->registers.V[y])
-            {
-                chip8->registers.PC += 2;
-            }
-        break;
 
-        /* LD I, addr: Set I = nnn (0xAnnn) */
-        case 0xA000:
-            chip8->registers.I = nnn;
-        break;
+/**
+ * @brief Select the quirk profile the instance runs with, the interpreter variant compiled for it.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param quirks CHIP8_QUIRK_* flags, 0 for the behaviour of the modern interpreters.
+ * @return Void.
+ */
+void chip8_set_quirks(struct chip8* chip8, unsigned int quirks)
+{
+    assert( quirks < CHIP8_QUIRK_PROFILES );
+    chip8->quirks = quirks;
+}
 
-        /* JP V0, addr: Jump to location nnn + V0 (0xBnnn) */
-        case 0xB000:
-            chip8->registers.PC = nnn + chip8->registers.V[0x00];
-        break;
 
-        /* RND Vx, byte: Set Vx = random byte AND kk (0xCxkk) */
-        case 0XC000:
-            srand(clock());
-            chip8->registers.V[x] = (rand() % 255) & kk;
-        break;
+/**
+ * @brief Execute the instruction specified by the opcode with the quirk profile of the instance.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param opcode Operation code to execute.
+ * @return Void.
+ */
+void chip8_exec(struct chip8* chip8, unsigned short opcode)
+{
+    chip8_exec_variants[chip8->quirks](chip8, opcode);
+}
 
-        /* DRW Vx, Vy, nibble: Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision (0xDxyn) */
-        case 0xD000:
-        {
-            const char* sprite = (const char*) &chip8->memory.memory[chip8->registers.I];
-            chip8->registers.V[0x0f] = chip8_screen_draw_sprite(&chip8->screen,
-                                                                chip8->registers.V[x],
-                                                                chip8->registers.V[y],
-                                                                sprite,
-                                                                n);
-        }
-        break;
 
-        case 0xE000:
+/**
+ * @brief Fetch the instruction at PC and execute it.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @return Void.
+ */
+void chip8_step(struct chip8* chip8)
+{
+    unsigned short opcode = chip8_memory_get_short(&chip8->memory, chip8->registers.PC);
+    chip8->registers.PC += 2;
+    chip8->stats.instructions += 1;
+    chip8_exec(chip8, opcode);
+}
+
+
+/**
+ * @brief Execute instructions, through the pre-decoded blocks when the instance has a block cache.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param instructions Number of instructions to execute.
+ * @return Void.
+ */
+void chip8_run(struct chip8* chip8, int instructions)
+{
+    if (chip8->block_cache)
+    {
+        chip8_block_run(chip8, instructions);
+        return;
+    }
+
+    chip8_run_variants[chip8->quirks](chip8, instructions);
+}
+
+
+/**
+ * @brief Decrement the delay and sound timers, called once per 60 Hz frame.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @return Void.
+ */
+void chip8_tick_timers(struct chip8* chip8)
+{
+    if (chip8->registers.delay_timer > 0)
+    {
+        chip8->registers.delay_timer -= 1;
+    }
+
+    if (chip8->registers.sound_timer > 0)
+    {
+        chip8->registers.sound_timer -= 1;
+    }
+}
+
+
+/**
+ * @brief Run one frame without any host interaction: the instructions followed by a timer tick.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param instructions Number of instructions executed in the frame.
+ * @return Void.
+ */
+void chip8_run_frame(struct chip8* chip8, int instructions)
+{
+    chip8_run(chip8, instructions);
+    chip8_tick_timers(chip8);
+}
+
+
+/**
+ * @brief Copy the machine state of an instance, sharing its memory pages, without any cache.
+ * 
+ * @param child Pointer to an unused chip8 struct receiving the copy.
+ * @param parent Pointer to the chip8 struct to copy.
+ * @return Void.
+ */
+static void chip8_copy(struct chip8* child, const struct chip8* parent)
+{
+    memcpy(child, parent, sizeof(struct chip8));
+    chip8_memory_init(&child->memory);
+    chip8_memory_share(&child->memory, &parent->memory);
+    child->sprite_cache = NULL;
+    child->block_cache = NULL;
+    memset(child->shadow_stack, 0, sizeof(child->shadow_stack));
+    memset(child->jump_sites, 0, sizeof(child->jump_sites));
+}
+
+
+/**
+ * @brief Clone an instance, the clone sharing the memory pages of the parent until either writes them.
+ *        The clone has no sprite cache, one can be attached with chip8_set_sprite_cache.
+ *        It uses the block cache of the parent when that one is shared, and no block cache otherwise.
+ *        It must be released with chip8_free.
+ * 
+ * @param child Pointer to an unused chip8 struct receiving the clone.
+ * @param parent Pointer to the chip8 struct to clone.
+ * @return Void.
+ */
+void chip8_fork(struct chip8* child, const struct chip8* parent)
+{
+    chip8_copy(child, parent);
+    if (parent->block_cache && parent->block_cache->shared)
+    {
+        chip8_block_cache_retain(parent->block_cache);
+        child->block_cache = parent->block_cache;
+    }
+}
+
+
+/**
+ * @brief Save the machine state of an instance.
+ *        The snapshot keeps its own sprite and block caches, the caches of the instance are not copied.
+ *        Memory pages are shared with the instance rather than copied.
+ * 
+ * @param snapshot Pointer to the chip8 struct receiving the state.
+ * @param chip8 Pointer to the chip8 struct to save.
+ * @return Void.
+ */
+void chip8_snapshot(struct chip8* snapshot, const struct chip8* chip8)
+{
+    struct chip8_sprite_cache* cache = snapshot->sprite_cache;
+    struct chip8_block_cache* block_cache = snapshot->block_cache;
+    struct chip8_memory memory = snapshot->memory;
+    chip8_copy(snapshot, chip8);
+    chip8_memory_free(&memory);
+    snapshot->sprite_cache = cache;
+    snapshot->block_cache = block_cache;
+}
+
+
+/**
+ * @brief Drop the blocks holding the bytes that differ between two memories.
+ *        Pages that are still shared are skipped without being compared.
+ * 
+ * @param cache Pointer to a chip8_block_cache struct.
+ * @param memory Pointer to the current memory.
+ * @param other Pointer to the memory replacing it.
+ * @return Void.
+ */
+static void chip8_invalidate_changes(struct chip8_block_cache* cache, const struct chip8_memory* memory, const struct chip8_memory* other)
+{
+    for (int i = 0 ; i < CHIP8_MEMORY_PAGES ; i++)
+    {
+        if (memory->pages[i] == other->pages[i])
         {
-            switch (opcode & 0x00ff)
-            {
-                /* SKP Vx: Skip next instruction if the key with the value of Vx is pressed (0xEx9E) */
-                case 0x9e:
-                    if ( chip8_keyboard_is_down(&chip8->keyboard, chip8->registers.V[x]) )
-                    {
-                        chip8->registers.PC += 2;
-                    }
-                break;
-
-                /* SKNP Vx: Skip next instruction if the key with the value Vx is not pressed (0xExA1) */
-                case 0xa1:
-                    if ( !chip8_keyboard_is_down(&chip8->keyboard, chip8->registers.V[x]) )
-                    {
-                        chip8->registers.PC += 2;
-                    }
-                break;
-            }
+            continue;
         }
-        break;
-
-        case 0xF000:
+        for (int j = 0 ; j < CHIP8_MEMORY_PAGE_SIZE ; j++)
         {
-            switch (opcode & 0x00ff)
+            int index = i * CHIP8_MEMORY_PAGE_SIZE + j;
+            if (memory->pages[i]->bytes[j] != other->pages[i]->bytes[j] && chip8_block_cache_holds(cache, index))
             {
-                /* LD Vx, DT: Set Vx = delay timer value (0xFx07) */
-                case 0x07:
-                    chip8->registers.V[x] = chip8->registers.delay_timer;
-                break;
-
-                /* LD Vx, K: Wait for a key press, store the value of the key in Vx (0xFx0A) */
-                case 0x0a:
-                {
-                    char pressed_key = chip8_wait_for_key_press(chip8);
-                    chip8->registers.V[x] = pressed_key;
-                }
-                break;
-
-                /* LD DT, Vx: Set delay timer = Vx (0xFx15) */
-                case 0x15:
-                    chip8->registers.delay_timer = chip8->registers.V[x];
-                break;
-
-                /* LD ST, Vx: Set sound timer = Vx (0xFx18) */
-                case 0x18:
-                    chip8->registers.sound_timer = chip8->registers.V[x];
-                break;
-
-                /* ADD I, Vx: Set I = I + Vx (0xFx1E) */
-                case 0x1e:
-                    chip8->registers.I += chip8->registers.V[x];
-                break;
-
-                /* LD F, Vx: Set I = location of sprite for digit Vx (0xFx29) */
-                case 0x29:
-                    chip8->registers.I = chip8->registers.V[x] * CHIP8_DEFAULT_SPRITE_HEIGHT;
-                break;
-
-                /* LD B, Vx: Store BCD representation of Vx in memory locations I, I+1, and I+2 (0xFx33) */
-                case 0x33:
-                {
-                    unsigned char hundreds = chip8->registers.V[x] / 100;
-                    unsigned char tens = chip8->registers.V[x] / 10 % 10;
-                    unsigned char units = chip8->registers.V[x] % 10;
-                    chip8_memory_set(&chip8->memory, chip8->registers.I, hundreds);
-                    chip8_memory_set(&chip8->memory, chip8->registers.I + 1, tens);
-                    chip8_memory_set(&chip8->memory, chip8->registers.I + 2, units);
-                }
-                break;
-
-                /* LD [I], Vx: Store the registers V0 through Vx in memory starting at location I (0xFx55) */
-                case 0x55:
-                    for (int i = 0 ; i <= x ; i++)
-                    {
-                        chip8_memory_set(&chip8->memory, chip8->registers.I + i, chip8->registers.V[i]);
-                    }
-                break;
-
-                /* LD Vx, [I]: Read registers V0 through Vx from memory starting at location I (0xFx65) */
-                case 0x65:
-                    for (int i = 0 ; i <= x ; i++)
-                    {
-                        chip8->registers.V[i] = chip8_memory_get(&chip8->memory, chip8->registers.I + i);
-                    }
-                break;
+                chip8_block_cache_invalidate(cache, index);
             }
         }
-        break;
-
     }
 }
 
+
 /**
- * @brief Execute the instruction specified by the opcode.
+ * @brief Bring an instance back to a saved machine state.
+ *        The sprite cache is only dropped when the memory differs from the snapshot,
+ *        and only the blocks holding bytes that differ are dropped.
  * 
- * @param chip8 Pointer to a chip8 struct.
- * @param opcode Operation code to execute.
+ * @param chip8 Pointer to the chip8 struct to restore.
+ * @param snapshot Pointer to the chip8 struct holding the saved state.
+ * @return Void.
  */
-void chip8_exec(struct chip8* chip8, unsigned short opcode)
+void chip8_restore(struct chip8* chip8, const struct chip8* snapshot)
 {
-    switch(opcode)
+    struct chip8_sprite_cache* cache = chip8->sprite_cache;
+    if (cache && !chip8_memory_equal(&chip8->memory, &snapshot->memory))
     {
-        /* CLS: Clear the display */
-        case 0x00E0:
-            chip8_screen_clear(&chip8->screen);
-        break;
+        chip8_sprite_cache_clear(cache);
+    }
+    struct chip8_block_cache* block_cache = chip8->block_cache;
+    if (block_cache && !block_cache->shared)
+    {
+        chip8_invalidate_changes(block_cache, &chip8->memory, &snapshot->memory);
+    }
+    struct chip8_memory memory = chip8->memory;
+    chip8_copy(chip8, snapshot);
+    chip8_memory_free(&memory);
+    chip8->sprite_cache = cache;
+    chip8->block_cache = block_cache;
+}
 
-        /* RET: Return from a subroutine */
-        case 0x00EE:
-            chip8->registers.PC = chip8_stack_pop(chip8);
-        break;
 
-        default:
-            chip8_exec_extended(chip8, opcode);
-    }
+/**
+ * @brief Get a hash of the machine state, to detect states that have already been reached.
+ *        Memory, screen and stack hashes are kept up to date by their writes and the registers
+ *        are mixed in here, so the cost does not depend on the state size.
+ *        Keys held down are input and are not part of the state, a pending LD Vx, K is,
+ *        and so is the generator of RND.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @return uint64_t The state hash.
+ */
+uint64_t chip8_state_hash(const struct chip8* chip8)
+{
+    const struct chip8_registers* registers = &chip8->registers;
+    uint64_t low;
+    uint64_t high;
+    memcpy(&low, &registers->V[0], sizeof(low));
+    memcpy(&high, &registers->V[8], sizeof(high));
+    uint64_t control = (uint64_t) registers->PC |
+                       (uint64_t) registers->I << 16 |
+                       (uint64_t) registers->SP << 32 |
+                       (uint64_t) registers->delay_timer << 40 |
+                       (uint64_t) registers->sound_timer << 48 |
+                       (uint64_t) (chip8->keyboard.waiting ? chip8->keyboard.pressed + 2 : 0) << 56;
+
+    return chip8->memory.hash ^ chip8->screen.hash ^ chip8->stack.hash ^
+           chip8_hash_key(CHIP8_HASH_REGISTERS, 0, low) ^
+           chip8_hash_key(CHIP8_HASH_REGISTERS, 1, high) ^
+           chip8_hash_key(CHIP8_HASH_REGISTERS, 2, control) ^
+           chip8_hash_key(CHIP8_HASH_REGISTERS, 3, chip8->random);
 }
\ No newline at end of file
@@ -0,0 +1,1412 @@
+#include "chip8block.h"
+#include "chip8.h"
+#include "chip8log.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <memory.h>
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_timer.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+_Static_assert((CHIP8_BLOCK_QUEUE_SIZE & (CHIP8_BLOCK_QUEUE_SIZE - 1)) == 0, "block queue size must be a power of two");
+
+/* Code of a hot entry, copied by the instance so the compiler never reads its memory */
+struct chip8_block_request
+{
+    struct chip8_block_cache* cache;
+    /* Generations of the first and the last page of the code */
+    uint32_t generations[2];
+    unsigned short pc;
+    unsigned short size;
+    unsigned char code[CHIP8_BLOCK_MAX_OPS * 2];
+};
+
+/* The compiler thread, shared by every cache of the process */
+struct chip8_block_compiler
+{
+    struct chip8_block_request requests[CHIP8_BLOCK_QUEUE_SIZE];
+    unsigned int head;
+    unsigned int tail;
+    SDL_SpinLock lock;
+    SDL_sem* wake;
+    SDL_Thread* thread;
+    atomic_bool running;
+    atomic_bool stop;
+};
+
+static struct chip8_block_compiler chip8_block_compiler;
+
+/* Shared caches of the process, each holding one reference */
+struct chip8_block_registry
+{
+    struct chip8_block_cache* caches[CHIP8_BLOCK_REGISTRY_SIZE];
+    SDL_SpinLock lock;
+};
+
+static struct chip8_block_registry chip8_block_registry;
+
+/**
+ * @brief Allocate an empty block cache, holding one reference.
+ * 
+ * @return struct chip8_block_cache* The cache, NULL if it could not be allocated.
+ */
+struct chip8_block_cache* chip8_block_cache_create(void)
+{
+    struct chip8_block_cache* cache = calloc(1, sizeof(struct chip8_block_cache));
+    if (!cache)
+    {
+        CHIP8_LOG_ERROR("Failed to allocate a block cache");
+        return NULL;
+    }
+    atomic_init(&cache->references, 1);
+    return cache;
+}
+
+
+/**
+ * @brief Take a reference on a cache.
+ * 
+ * @param cache Pointer to a chip8_block_cache struct.
+ * @return Void.
+ */
+void chip8_block_cache_retain(struct chip8_block_cache* cache)
+{
+    atomic_fetch_add_explicit(&cache->references, 1, memory_order_relaxed);
+}
+
+
+/**
+ * @brief Free a block, unless it lives in the block file the cache has been loaded from.
+ * 
+ * @param cache Pointer to the chip8_block_cache struct holding the block.
+ * @param block Pointer to the block, or NULL.
+ * @return Void.
+ */
+static void chip8_block_free(const struct chip8_block_cache* cache, struct chip8_block* block)
+{
+    const unsigned char* file = cache->file;
+    if (file && (const unsigned char*) block >= file && (const unsigned char*) block < file + cache->file_size)
+    {
+        return;
+    }
+    free(block);
+}
+
+
+/**
+ * @brief Free a list of retired blocks.
+ * 
+ * @param cache Pointer to the chip8_block_cache struct holding the blocks.
+ * @param block The first block of the list.
+ * @return Void.
+ */
+static void chip8_block_free_list(const struct chip8_block_cache* cache, struct chip8_block* block)
+{
+    while (block)
+    {
+        struct chip8_block* next = block->retired;
+        chip8_block_free(cache, block);
+        block = next;
+    }
+}
+
+
+/**
+ * @brief Remove the mapping of the block file of a cache.
+ * 
+ * @param data Start of the mapping.
+ * @param size Size of the mapping.
+ * @param mapping Handle of the mapping, only used on Windows.
+ * @return Void.
+ */
+static void chip8_block_file_unmap(void* data, size_t size, void* mapping)
+{
+#ifdef _WIN32
+    (void) size;
+    UnmapViewOfFile(data);
+    CloseHandle(mapping);
+#else
+    (void) mapping;
+    munmap(data, size);
+#endif
+}
+
+
+/**
+ * @brief Drop a reference on a cache, the last one frees it with all its blocks.
+ * 
+ * @param cache Pointer to a chip8_block_cache struct, or NULL.
+ * @return Void.
+ */
+void chip8_block_cache_release(struct chip8_block_cache* cache)
+{
+    if (!cache || atomic_fetch_sub_explicit(&cache->references, 1, memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+
+    for (int i = 0 ; i < CHIP8_MEMORY_SIZE ; i++)
+    {
+        chip8_block_free(cache, atomic_load_explicit(&cache->blocks[i], memory_order_relaxed));
+    }
+    chip8_block_free_list(cache, cache->retired);
+    if (cache->file)
+    {
+        chip8_block_file_unmap(cache->file, cache->file_size, cache->file_mapping);
+    }
+    if (cache->shared)
+    {
+        chip8_memory_free(&cache->reference);
+    }
+    free(cache);
+}
+
+
+/**
+ * @brief Get the shared cache of the instances started from a memory image, creating it on first use.
+ *        When the registry is full and every cache in it is in use, the cache is shared by nobody else.
+ * 
+ * @param memory Pointer to the memory image, usually right after the ROM has been loaded.
+ * @return struct chip8_block_cache* The cache with a reference for the caller, NULL if it could not be allocated.
+ */
+struct chip8_block_cache* chip8_block_cache_shared(const struct chip8_memory* memory)
+{
+    struct chip8_block_registry* registry = &chip8_block_registry;
+    SDL_AtomicLock(&registry->lock);
+    int free_slot = -1;
+    for (int i = 0 ; i < CHIP8_BLOCK_REGISTRY_SIZE ; i++)
+    {
+        struct chip8_block_cache* cache = registry->caches[i];
+        if (!cache)
+        {
+            free_slot = free_slot == -1 ? i : free_slot;
+            continue;
+        }
+        if (cache->reference.hash == memory->hash && chip8_memory_equal(&cache->reference, memory))
+        {
+            chip8_block_cache_retain(cache);
+            SDL_AtomicUnlock(&registry->lock);
+            return cache;
+        }
+    }
+
+    struct chip8_block_cache* cache = chip8_block_cache_create();
+    if (cache)
+    {
+        cache->shared = true;
+        chip8_memory_init(&cache->reference);
+        chip8_memory_share(&cache->reference, memory);
+
+        /* Make room by dropping a cache that no instance uses any more */
+        for (int i = 0 ; free_slot == -1 && i < CHIP8_BLOCK_REGISTRY_SIZE ; i++)
+        {
+            if (atomic_load_explicit(&registry->caches[i]->references, memory_order_acquire) == 1)
+            {
+                chip8_block_cache_release(registry->caches[i]);
+                free_slot = i;
+            }
+        }
+        if (free_slot != -1)
+        {
+            chip8_block_cache_retain(cache);
+            registry->caches[free_slot] = cache;
+        }
+    }
+    SDL_AtomicUnlock(&registry->lock);
+    return cache;
+}
+
+
+/**
+ * @brief Drop the references of the registry, the shared caches are freed with their last instance.
+ * 
+ * @return Void.
+ */
+void chip8_block_registry_clear(void)
+{
+    struct chip8_block_registry* registry = &chip8_block_registry;
+    SDL_AtomicLock(&registry->lock);
+    for (int i = 0 ; i < CHIP8_BLOCK_REGISTRY_SIZE ; i++)
+    {
+        chip8_block_cache_release(registry->caches[i]);
+        registry->caches[i] = NULL;
+    }
+    SDL_AtomicUnlock(&registry->lock);
+}
+
+
+/**
+ * @brief Get the first page holding a block.
+ * 
+ * @param block Pointer to the block.
+ * @return int The page.
+ */
+static inline int chip8_block_first_page(const struct chip8_block* block)
+{
+    return block->pages[0];
+}
+
+
+/**
+ * @brief Get the last page holding a block, the first one when the block does not cross pages.
+ * 
+ * @param block Pointer to the block.
+ * @return int The page.
+ */
+static inline int chip8_block_last_page(const struct chip8_block* block)
+{
+    return block->pages[1];
+}
+
+
+/**
+ * @brief Get the bits of the bytes from one offset to another inside a page.
+ * 
+ * @param from Offset of the first byte.
+ * @param to Offset past the last byte, up to CHIP8_BLOCK_PAGE_SIZE.
+ * @return uint64_t The bits.
+ */
+static uint64_t chip8_block_range_mask(int from, int to)
+{
+    uint64_t below_to = to == CHIP8_BLOCK_PAGE_SIZE ? ~0ULL : (1ULL << to) - 1;
+    return below_to & ~((1ULL << from) - 1);
+}
+
+
+/**
+ * @brief Set or clear the bit of a page, depending on whether it still holds code.
+ *        The lock of the cache must be held.
+ * 
+ * @param cache Pointer to a chip8_block_cache struct.
+ * @param page The page.
+ * @return Void.
+ */
+static void chip8_block_update_page(struct chip8_block_cache* cache, int page)
+{
+    uint64_t bit = 1ULL << page;
+    if (cache->pages[page] || cache->pending[page] > 0)
+    {
+        atomic_fetch_or_explicit(&cache->code_pages, bit, memory_order_relaxed);
+    }
+    else
+    {
+        atomic_fetch_and_explicit(&cache->code_pages, ~bit, memory_order_relaxed);
+    }
+}
+
+
+/**
+ * @brief Install a block in the table and in the lists of its pages.
+ *        The lock of the cache must be held.
+ * 
+ * @param cache Pointer to a chip8_block_cache struct.
+ * @param block Pointer to the block.
+ * @return Void.
+ */
+static void chip8_block_link(struct chip8_block_cache* cache, struct chip8_block* block)
+{
+    int first = chip8_block_first_page(block);
+    int last = chip8_block_last_page(block);
+    block->next[0] = cache->pages[first];
+    cache->pages[first] = block;
+    block->next[1] = NULL;
+    if (last != first)
+    {
+        block->next[1] = cache->pages[last];
+        cache->pages[last] = block;
+    }
+    chip8_block_update_page(cache, first);
+    chip8_block_update_page(cache, last);
+    atomic_store_explicit(&cache->blocks[block->pc], block, memory_order_release);
+}
+
+
+/**
+ * @brief Remove a block from the list of a page.
+ *        The lock of the cache must be held.
+ * 
+ * @param cache Pointer to a chip8_block_cache struct.
+ * @param page A page holding the block.
+ * @param block Pointer to the block.
+ * @return Void.
+ */
+static void chip8_block_unlink(struct chip8_block_cache* cache, int page, struct chip8_block* block)
+{
+    struct chip8_block** link = &cache->pages[page];
+    while (*link)
+    {
+        int slot = chip8_block_first_page(*link) == page ? 0 : 1;
+        if (*link == block)
+        {
+            *link = block->next[slot];
+            return;
+        }
+        link = &(*link)->next[slot];
+    }
+}
+
+
+/**
+ * @brief Remove a block from the table and from the lists of its pages, and keep it until
+ *        no instance runs the cache since one may still hold it. The lock of the cache must be held.
+ * 
+ * @param cache Pointer to a chip8_block_cache struct.
+ * @param block Pointer to an installed block.
+ * @return Void.
+ */
+static void chip8_block_retire(struct chip8_block_cache* cache, struct chip8_block* block)
+{
+    int first = chip8_block_first_page(block);
+    int last = chip8_block_last_page(block);
+    chip8_block_unlink(cache, first, block);
+    if (last != first)
+    {
+        chip8_block_unlink(cache, last, block);
+    }
+    chip8_block_update_page(cache, first);
+    chip8_block_update_page(cache, last);
+
+    atomic_store_explicit(&cache->blocks[block->pc], NULL, memory_order_relaxed);
+    atomic_store_explicit(&cache->hotness[block->pc], 0, memory_order_relaxed);
+    atomic_fetch_add_explicit(&cache->retirements, 1, memory_order_relaxed);
+    block->retired = cache->retired;
+    cache->retired = block;
+}
+
+
+/**
+ * @brief Mark an instance as running the blocks of a cache, it may hold any block installed from now on.
+ * 
+ * @param cache Pointer to a chip8_block_cache struct.
+ * @return Void.
+ */
+static void chip8_block_enter(struct chip8_block_cache* cache)
+{
+    atomic_fetch_add_explicit(&cache->running, 1, memory_order_relaxed);
+    /* Pairs with the fence of chip8_block_leave, either the table read next misses the retired blocks or they are not freed */
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+
+/**
+ * @brief Mark an instance as done with the blocks of a cache. The last instance to leave
+ *        frees the blocks retired so far: they are out of the table, and the shadow stacks and
+ *        jump sites holding them are stale since the retirements have been bumped.
+ * 
+ * @param cache Pointer to a chip8_block_cache struct, or NULL.
+ * @return Void.
+ */
+static void chip8_block_leave(struct chip8_block_cache* cache)
+{
+    if (!cache || atomic_fetch_sub_explicit(&cache->running, 1, memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+
+    SDL_AtomicLock(&cache->lock);
+    struct chip8_block* retired = cache->retired;
+    cache->retired = NULL;
+    SDL_AtomicUnlock(&cache->lock);
+    if (!retired)
+    {
+        return;
+    }
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&cache->running, memory_order_relaxed) == 0)
+    {
+        uint64_t count = 0;
+        for (const struct chip8_block* block = retired ; block ; block = block->retired)
+        {
+            count++;
+        }
+        chip8_block_free_list(cache, retired);
+        atomic_fetch_add_explicit(&cache->stats.reclaimed, count, memory_order_relaxed);
+        return;
+    }
+
+    /* Another instance entered meanwhile and may hold them, the blocks wait for the next quiescent point */
+    struct chip8_block* last = retired;
+    while (last->retired)
+    {
+        last = last->retired;
+    }
+    SDL_AtomicLock(&cache->lock);
+    last->retired = cache->retired;
+    cache->retired = retired;
+    SDL_AtomicUnlock(&cache->lock);
+}
+
+
+/**
+ * @brief Drop every block, the code is run by the interpreter until it becomes hot again.
+ *        Used when the whole memory may have changed, like loading a ROM.
+ * 
+ * @param cache Pointer to a chip8_block_cache struct.
+ * @return Void.
+ */
+void chip8_block_cache_clear(struct chip8_block_cache* cache)
+{
+    SDL_AtomicLock(&cache->lock);
+    for (int i = 0 ; i < CHIP8_BLOCK_PAGES ; i++)
+    {
+        atomic_fetch_add_explicit(&cache->generations[i], 1, memory_order_relaxed);
+        while (cache->pages[i])
+        {
+            chip8_block_retire(cache, cache->pages[i]);
+        }
+    }
+    for (int i = 0 ; i < CHIP8_MEMORY_SIZE ; i++)
+    {
+        atomic_store_explicit(&cache->hotness[i], 0, memory_order_relaxed);
+    }
+    SDL_AtomicUnlock(&cache->lock);
+}
+
+
+/**
+ * @brief Drop the blocks holding a memory byte that has been written.
+ *        Only needed when chip8_block_cache_holds is true for the byte.
+ * 
+ * @param cache Pointer to a chip8_block_cache struct.
+ * @param index An index to access the memory byte.
+ * @return Void.
+ */
+void chip8_block_cache_invalidate(struct chip8_block_cache* cache, int index)
+{
+    int page = index / CHIP8_BLOCK_PAGE_SIZE;
+    atomic_fetch_add_explicit(&cache->stats.code_writes, 1, memory_order_relaxed);
+
+    SDL_AtomicLock(&cache->lock);
+    atomic_fetch_add_explicit(&cache->generations[page], 1, memory_order_relaxed);
+    struct chip8_block* block = cache->pages[page];
+    while (block)
+    {
+        struct chip8_block* next = block->next[chip8_block_first_page(block) == page ? 0 : 1];
+        if (block->pc <= index && index < block->pc + block->length * 2)
+        {
+            chip8_block_retire(cache, block);
+            atomic_fetch_add_explicit(&cache->stats.invalidated, 1, memory_order_relaxed);
+        }
+        block = next;
+    }
+    SDL_AtomicUnlock(&cache->lock);
+}
+
+
+/**
+ * @brief Check whether an instruction has to be the last one of a block,
+ *        because it may change PC or write memory.
+ * 
+ * @param opcode The instruction.
+ * @return true The instruction ends a block.
+ * @return false The next instruction always runs after it.
+ */
+static bool chip8_block_ends(unsigned short opcode)
+{
+    return chip8_isa_ends_block(chip8_isa_decode(opcode));
+}
+
+
+/**
+ * @brief Decode an instruction.
+ * 
+ * @param op Pointer to the chip8_block_op struct receiving the instruction.
+ * @param opcode The instruction.
+ * @return Void.
+ */
+static void chip8_block_decode(struct chip8_block_op* op, unsigned short opcode)
+{
+    op->opcode = opcode;
+    op->id = chip8_isa_decode(opcode);
+    op->x = (opcode & 0x0f00) >> 8;
+    op->y = (opcode & 0x00f0) >> 4;
+    op->kk = opcode & 0x00ff;
+    op->nnn = opcode & 0x0fff;
+}
+
+
+/**
+ * @brief Compute the pages holding a block and the bytes it holds in each, from its PC and length.
+ * 
+ * @param block Pointer to the block.
+ * @return Void.
+ */
+static void chip8_block_locate(struct chip8_block* block)
+{
+    int end = block->pc + block->length * 2;
+    int first = block->pc / CHIP8_BLOCK_PAGE_SIZE;
+    int last = (end - 1) / CHIP8_BLOCK_PAGE_SIZE;
+    block->pages[0] = first;
+    block->pages[1] = last;
+    block->masks[0] = chip8_block_range_mask(block->pc % CHIP8_BLOCK_PAGE_SIZE, last == first ? end - first * CHIP8_BLOCK_PAGE_SIZE : CHIP8_BLOCK_PAGE_SIZE);
+    block->masks[1] = last == first ? 0 : chip8_block_range_mask(0, end - last * CHIP8_BLOCK_PAGE_SIZE);
+}
+
+
+/**
+ * @brief Decode the instructions of a block.
+ * 
+ * @param pc Address of the first instruction.
+ * @param code The bytes from pc on.
+ * @param size Number of bytes of code.
+ * @return struct chip8_block* The block, NULL if there is no whole instruction or it could not be allocated.
+ */
+static struct chip8_block* chip8_block_compile(unsigned short pc, const unsigned char* code, int size)
+{
+    struct chip8_block_op ops[CHIP8_BLOCK_MAX_OPS];
+    int length = 0;
+    bool ended = false;
+    while (!ended && length < CHIP8_BLOCK_MAX_OPS && length * 2 + 1 < size)
+    {
+        unsigned short opcode = code[length * 2] << 8 | code[length * 2 + 1];
+        chip8_block_decode(&ops[length++], opcode);
+        ended = chip8_block_ends(opcode);
+    }
+    if (length == 0)
+    {
+        /* The entry is the last byte of memory */
+        return NULL;
+    }
+
+    struct chip8_block* block = malloc(sizeof(struct chip8_block) + length * sizeof(struct chip8_block_op));
+    if (!block)
+    {
+        return NULL;
+    }
+    block->pc = pc;
+    block->length = length;
+    chip8_block_locate(block);
+    block->retired = NULL;
+    memcpy(block->ops, ops, length * sizeof(struct chip8_block_op));
+    return block;
+}
+
+
+/**
+ * @brief Compile a request and install the block, unless its code has been written since
+ *        the request was made. Drops the reference of the request on the cache.
+ * 
+ * @param request Pointer to the request.
+ * @return Void.
+ */
+static void chip8_block_build(const struct chip8_block_request* request)
+{
+    struct chip8_block_cache* cache = request->cache;
+    struct chip8_block* block = chip8_block_compile(request->pc, request->code, request->size);
+
+    int first = request->pc / CHIP8_BLOCK_PAGE_SIZE;
+    int last = (request->pc + request->size - 1) / CHIP8_BLOCK_PAGE_SIZE;
+
+    SDL_AtomicLock(&cache->lock);
+    bool installed = block &&
+                     request->generations[0] == atomic_load_explicit(&cache->generations[first], memory_order_relaxed) &&
+                     request->generations[1] == atomic_load_explicit(&cache->generations[last], memory_order_relaxed) &&
+                     !atomic_load_explicit(&cache->blocks[request->pc], memory_order_relaxed);
+    if (installed)
+    {
+        chip8_block_link(cache, block);
+    }
+    cache->pending[first] -= 1;
+    cache->pending[last] -= last != first;
+    chip8_block_update_page(cache, first);
+    chip8_block_update_page(cache, last);
+    SDL_AtomicUnlock(&cache->lock);
+
+    if (installed)
+    {
+        atomic_fetch_add_explicit(&cache->stats.installed, 1, memory_order_relaxed);
+    }
+    else
+    {
+        /* The entry becomes a candidate again */
+        chip8_block_free(cache, block);
+        atomic_store_explicit(&cache->hotness[request->pc], 0, memory_order_relaxed);
+        atomic_fetch_add_explicit(&cache->stats.discarded, 1, memory_order_relaxed);
+    }
+    chip8_block_cache_release(cache);
+}
+
+
+/**
+ * @brief Get the size of a block in a block file.
+ * 
+ * @param length Number of instructions of the block.
+ * @return size_t The size, padded to 8 bytes.
+ */
+static size_t chip8_block_record_size(int length)
+{
+    size_t size = sizeof(struct chip8_block) + length * sizeof(struct chip8_block_op);
+    return (size + 7) & ~(size_t) 7;
+}
+
+
+/**
+ * @brief Build the path of the block file of a cache.
+ * 
+ * @param cache Pointer to a shared chip8_block_cache struct.
+ * @param directory The cache directory.
+ * @param filename Buffer receiving the path.
+ * @param size Size of the buffer.
+ * @return true The path fits in the buffer.
+ * @return false The path is too long.
+ */
+static bool chip8_block_file_name(const struct chip8_block_cache* cache, const char* directory, char* filename, size_t size)
+{
+    int length = snprintf(filename, size, "%s/%016llx-v%d.blocks", directory,
+                          (unsigned long long) cache->reference.hash, EMULATOR_VERSION);
+    return length > 0 && (size_t) length < size;
+}
+
+
+/**
+ * @brief Map a block file in memory, copy-on-write so the blocks can be linked in place.
+ * 
+ * @param filename Path of the file.
+ * @param size Receives the size of the file.
+ * @param mapping Receives the handle of the mapping, only used on Windows.
+ * @return void* Start of the mapping, NULL if the file could not be opened or mapped.
+ */
+static void* chip8_block_file_map(const char* filename, size_t* size, void** mapping)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+
+    LARGE_INTEGER file_size;
+    HANDLE handle = NULL;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+    {
+        handle = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    }
+    CloseHandle(file);
+    if (!handle)
+    {
+        return NULL;
+    }
+
+    void* data = MapViewOfFile(handle, FILE_MAP_COPY, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(handle);
+        return NULL;
+    }
+    *size = file_size.QuadPart;
+    *mapping = handle;
+    return data;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return NULL;
+    }
+    *size = st.st_size;
+    *mapping = NULL;
+    return data;
+#endif
+}
+
+
+/**
+ * @brief Check a block read from a block file against the reference memory of the cache,
+ *        and decode it again so nothing but its instructions is trusted.
+ * 
+ * @param cache Pointer to a shared chip8_block_cache struct.
+ * @param block Pointer to the block, its PC and length already checked to be in memory.
+ * @return true The block holds the code of the reference memory.
+ * @return false The block does not match, it must not be installed.
+ */
+static bool chip8_block_restore(const struct chip8_block_cache* cache, struct chip8_block* block)
+{
+    for (int i = 0 ; i < block->length ; i++)
+    {
+        unsigned short opcode = chip8_memory_get_short(&cache->reference, block->pc + i * 2);
+        if (block->ops[i].opcode != opcode || (i < block->length - 1 && chip8_block_ends(opcode)))
+        {
+            return false;
+        }
+        chip8_block_decode(&block->ops[i], opcode);
+    }
+    chip8_block_locate(block);
+    block->next[0] = NULL;
+    block->next[1] = NULL;
+    block->retired = NULL;
+    return true;
+}
+
+
+/**
+ * @brief Install the blocks saved in a cache directory for the memory image of a shared cache.
+ *        The blocks are used in place from the mapped file, which stays mapped until the cache is freed.
+ *        Saved blocks are checked against the memory image, a stale or damaged file is ignored.
+ * 
+ * @param cache Pointer to a shared chip8_block_cache struct, before it runs any instance.
+ * @param directory The cache directory.
+ * @return true Blocks have been loaded.
+ * @return false There is no usable block file for the cache.
+ */
+bool chip8_block_cache_load(struct chip8_block_cache* cache, const char* directory)
+{
+    char filename[1024];
+    if (!cache->shared || cache->file || !chip8_block_file_name(cache, directory, filename, sizeof(filename)))
+    {
+        return false;
+    }
+
+    size_t size;
+    void* mapping;
+    unsigned char* data = chip8_block_file_map(filename, &size, &mapping);
+    if (!data)
+    {
+        /* No file yet, the blocks are compiled and saved on this run */
+        return false;
+    }
+
+    const struct chip8_block_file_header* header = (const struct chip8_block_file_header*) data;
+    if (size < sizeof(struct chip8_block_file_header) ||
+        header->magic != CHIP8_BLOCK_FILE_MAGIC ||
+        header->version != CHIP8_BLOCK_FILE_VERSION ||
+        header->emulator_version != EMULATOR_VERSION ||
+        header->memory_hash != cache->reference.hash ||
+        header->block_size != sizeof(struct chip8_block) ||
+        header->size > size - sizeof(struct chip8_block_file_header))
+    {
+        CHIP8_LOG_WARNING("Ignoring block file %s: it does not match the emulator or the ROM", filename);
+        chip8_block_file_unmap(data, size, mapping);
+        return false;
+    }
+    cache->file = data;
+    cache->file_size = size;
+    cache->file_mapping = mapping;
+
+    size_t offset = sizeof(struct chip8_block_file_header);
+    size_t end = offset + header->size;
+    int loaded = 0;
+    int rejected = 0;
+    SDL_AtomicLock(&cache->lock);
+    for (uint32_t i = 0 ; i < header->count && offset + sizeof(struct chip8_block) <= end ; i++)
+    {
+        struct chip8_block* block = (struct chip8_block*) (data + offset);
+        if (block->length == 0 || block->length > CHIP8_BLOCK_MAX_OPS || block->pc + block->length * 2 > CHIP8_MEMORY_SIZE ||
+            offset + chip8_block_record_size(block->length) > end)
+        {
+            /* The rest of the file cannot be walked */
+            rejected += header->count - i;
+            break;
+        }
+        offset += chip8_block_record_size(block->length);
+
+        if (atomic_load_explicit(&cache->blocks[block->pc], memory_order_relaxed) || !chip8_block_restore(cache, block))
+        {
+            rejected++;
+            continue;
+        }
+        chip8_block_link(cache, block);
+        loaded++;
+    }
+    SDL_AtomicUnlock(&cache->lock);
+
+    atomic_fetch_add_explicit(&cache->stats.loaded, loaded, memory_order_relaxed);
+    CHIP8_LOG_INFO("Loaded %d blocks from %s, %d rejected", loaded, filename, rejected);
+    return loaded > 0;
+}
+
+
+/**
+ * @brief Save the installed blocks of a shared cache in a cache directory, created if missing.
+ *        The file is written next to its final path and renamed, so a reader never sees half of it.
+ * 
+ * @param cache Pointer to a shared chip8_block_cache struct.
+ * @param directory The cache directory.
+ * @return true The blocks have been saved.
+ * @return false The cache is private or the file could not be written.
+ */
+bool chip8_block_cache_save(struct chip8_block_cache* cache, const char* directory)
+{
+    char filename[1024];
+    char temporary[1024 + 4];
+    if (!cache->shared || !chip8_block_file_name(cache, directory, filename, sizeof(filename)))
+    {
+        return false;
+    }
+    snprintf(temporary, sizeof(temporary), "%s.tmp", filename);
+
+#ifdef _WIN32
+    _mkdir(directory);
+#else
+    mkdir(directory, 0755);
+#endif
+
+    FILE* file = fopen(temporary, "wb");
+    if (!file)
+    {
+        CHIP8_LOG_ERROR("Failed to create block file %s", temporary);
+        return false;
+    }
+
+    struct chip8_block_file_header header = { 0 };
+    header.magic = CHIP8_BLOCK_FILE_MAGIC;
+    header.version = CHIP8_BLOCK_FILE_VERSION;
+    header.emulator_version = EMULATOR_VERSION;
+    header.memory_hash = cache->reference.hash;
+    header.block_size = sizeof(struct chip8_block);
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    /* Blocks are not freed while the cache is entered, they can be written without the lock */
+    chip8_block_enter(cache);
+    for (int i = 0 ; written && i < CHIP8_MEMORY_SIZE ; i++)
+    {
+        const struct chip8_block* block = atomic_load_explicit(&cache->blocks[i], memory_order_acquire);
+        if (!block)
+        {
+            continue;
+        }
+
+        /* The pointers mean nothing in another process, and the padding must not leak memory contents */
+        union
+        {
+            struct chip8_block block;
+            unsigned char bytes[sizeof(struct chip8_block) + CHIP8_BLOCK_MAX_OPS * sizeof(struct chip8_block_op) + 8];
+        } record;
+        memset(&record, 0, sizeof(record));
+        record.block.pc = block->pc;
+        record.block.length = block->length;
+        memcpy(record.block.ops, block->ops, block->length * sizeof(struct chip8_block_op));
+
+        size_t size = chip8_block_record_size(block->length);
+        written = fwrite(&record, size, 1, file) == 1;
+        header.count++;
+        header.size += size;
+    }
+    chip8_block_leave(cache);
+
+    written = written && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    written = fclose(file) == 0 && written;
+#ifdef _WIN32
+    /* rename does not replace an existing file on Windows */
+    written = written && (remove(filename) == 0 || errno == ENOENT);
+#endif
+    written = written && rename(temporary, filename) == 0;
+    if (!written)
+    {
+        CHIP8_LOG_ERROR("Failed to write block file %s", filename);
+        remove(temporary);
+        return false;
+    }
+
+    CHIP8_LOG_INFO("Saved %u blocks to %s", header.count, filename);
+    return true;
+}
+
+
+/**
+ * @brief Entry point of the compiler thread: build the queued requests until stopped.
+ * 
+ * @param data Unused.
+ * @return int Always 0.
+ */
+static int chip8_block_compiler_thread(void* data)
+{
+    (void) data;
+    struct chip8_block_compiler* compiler = &chip8_block_compiler;
+    while (1)
+    {
+        SDL_SemWait(compiler->wake);
+
+        struct chip8_block_request request;
+        SDL_AtomicLock(&compiler->lock);
+        bool pending = compiler->head != compiler->tail;
+        if (pending)
+        {
+            request = compiler->requests[compiler->tail++ & (CHIP8_BLOCK_QUEUE_SIZE - 1)];
+        }
+        SDL_AtomicUnlock(&compiler->lock);
+
+        if (pending)
+        {
+            chip8_block_build(&request);
+        }
+        else if (atomic_load(&compiler->stop))
+        {
+            break;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Start the compiler thread. Without it, hot blocks are compiled by the instance
+ *        that reached the threshold, in the middle of its run.
+ * 
+ * @return Void.
+ */
+void chip8_block_compiler_start(void)
+{
+    struct chip8_block_compiler* compiler = &chip8_block_compiler;
+    compiler->head = 0;
+    compiler->tail = 0;
+    atomic_store(&compiler->stop, false);
+    compiler->wake = SDL_CreateSemaphore(0);
+    compiler->thread = compiler->wake ? SDL_CreateThread(chip8_block_compiler_thread, "compiler", NULL) : NULL;
+    if (!compiler->thread)
+    {
+        CHIP8_LOG_WARNING("Failed to start the block compiler, blocks are compiled inline");
+        if (compiler->wake)
+        {
+            SDL_DestroySemaphore(compiler->wake);
+        }
+        return;
+    }
+    atomic_store_explicit(&compiler->running, true, memory_order_release);
+}
+
+
+/**
+ * @brief Build the pending requests and stop the compiler thread.
+ * 
+ * @return Void.
+ */
+void chip8_block_compiler_stop(void)
+{
+    struct chip8_block_compiler* compiler = &chip8_block_compiler;
+    if (!atomic_load(&compiler->running))
+    {
+        return;
+    }
+
+    /* Requests made from now on are compiled inline */
+    SDL_AtomicLock(&compiler->lock);
+    atomic_store(&compiler->running, false);
+    SDL_AtomicUnlock(&compiler->lock);
+
+    atomic_store(&compiler->stop, true);
+    SDL_SemPost(compiler->wake);
+    SDL_WaitThread(compiler->thread, NULL);
+    SDL_DestroySemaphore(compiler->wake);
+}
+
+
+/**
+ * @brief Hand a hot entry over to the compiler.
+ * 
+ * @param chip8 Pointer to the chip8 struct that reached the entry.
+ * @param cache Pointer to the chip8_block_cache struct receiving the block.
+ * @param pc The entry.
+ * @return Void.
+ */
+static void chip8_block_request(const struct chip8* chip8, struct chip8_block_cache* cache, unsigned short pc)
+{
+    /* The blocks of a shared cache must be right for every instance that has not written them */
+    const struct chip8_memory* memory = cache->shared ? &cache->reference : &chip8->memory;
+    struct chip8_block_request request;
+    request.cache = cache;
+    request.pc = pc;
+    request.size = CHIP8_MEMORY_SIZE - pc < (int) sizeof(request.code) ? CHIP8_MEMORY_SIZE - pc : (int) sizeof(request.code);
+
+    /* From now on the writes to the pages of the code are checked, and make the request stale */
+    int first = pc / CHIP8_BLOCK_PAGE_SIZE;
+    int last = (pc + request.size - 1) / CHIP8_BLOCK_PAGE_SIZE;
+    SDL_AtomicLock(&cache->lock);
+    cache->pending[first] += 1;
+    cache->pending[last] += last != first;
+    chip8_block_update_page(cache, first);
+    chip8_block_update_page(cache, last);
+    request.generations[0] = atomic_load_explicit(&cache->generations[first], memory_order_relaxed);
+    request.generations[1] = atomic_load_explicit(&cache->generations[last], memory_order_relaxed);
+    SDL_AtomicUnlock(&cache->lock);
+    for (int i = 0 ; i < request.size ; i++)
+    {
+        request.code[i] = chip8_memory_get(memory, pc + i);
+    }
+    atomic_fetch_add_explicit(&cache->stats.requested, 1, memory_order_relaxed);
+    chip8_block_cache_retain(cache);
+
+    struct chip8_block_compiler* compiler = &chip8_block_compiler;
+    if (atomic_load_explicit(&compiler->running, memory_order_acquire))
+    {
+        SDL_AtomicLock(&compiler->lock);
+        bool queued = atomic_load_explicit(&compiler->running, memory_order_relaxed) &&
+                      compiler->head - compiler->tail < CHIP8_BLOCK_QUEUE_SIZE;
+        if (queued)
+        {
+            compiler->requests[compiler->head++ & (CHIP8_BLOCK_QUEUE_SIZE - 1)] = request;
+        }
+        SDL_AtomicUnlock(&compiler->lock);
+
+        if (queued)
+        {
+            SDL_SemPost(compiler->wake);
+            return;
+        }
+    }
+    chip8_block_build(&request);
+}
+
+
+/**
+ * @brief Check whether the memory of an instance still holds the code of a block.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param block Pointer to the block.
+ * @return true The block can be run by the instance.
+ * @return false The instance has written an instruction of the block.
+ */
+static bool chip8_block_matches(const struct chip8* chip8, const struct chip8_block* block)
+{
+    for (int i = 0 ; i < block->length ; i++)
+    {
+        if (chip8_memory_get_short(&chip8->memory, block->pc + i * 2) != block->ops[i].opcode)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief Move an instance from its shared cache to a private copy holding the blocks that still
+ *        match its memory, so it does not warm up again. Without memory for the copy, the
+ *        instance falls back to the interpreter.
+ * 
+ * @param chip8 Pointer to a chip8 struct using a shared cache.
+ * @return Void.
+ */
+static void chip8_block_diverge(struct chip8* chip8)
+{
+    struct chip8_block_cache* shared = chip8->block_cache;
+    struct chip8_block_cache* cache = chip8_block_cache_create();
+    for (int pc = 0 ; cache && pc < CHIP8_MEMORY_SIZE ; pc++)
+    {
+        atomic_store_explicit(&cache->hotness[pc], atomic_load_explicit(&shared->hotness[pc], memory_order_relaxed), memory_order_relaxed);
+        struct chip8_block* block = atomic_load_explicit(&shared->blocks[pc], memory_order_acquire);
+        if (!block || !chip8_block_matches(chip8, block))
+        {
+            continue;
+        }
+
+        size_t size = sizeof(struct chip8_block) + block->length * sizeof(struct chip8_block_op);
+        struct chip8_block* copy = malloc(size);
+        if (copy)
+        {
+            memcpy(copy, block, size);
+            chip8_block_link(cache, copy);
+        }
+    }
+
+    if (cache)
+    {
+        cache->timing = shared->timing;
+    }
+    atomic_fetch_add_explicit(&shared->stats.diverged, 1, memory_order_relaxed);
+    chip8->block_cache = cache;
+    memset(chip8->shadow_stack, 0, sizeof(chip8->shadow_stack));
+    memset(chip8->jump_sites, 0, sizeof(chip8->jump_sites));
+    if (cache)
+    {
+        chip8_block_enter(cache);
+    }
+    chip8_block_leave(shared);
+    chip8_block_cache_release(shared);
+}
+
+
+/**
+ * @brief Resolve the block at the target of a computed jump through the inline cache of the jump.
+ *        NNN is part of the block, so the offset added to it is enough to tell the targets apart.
+ * 
+ * @param chip8 Pointer to a chip8 struct whose PC is the target.
+ * @param cache Pointer to the chip8_block_cache struct of the instance.
+ * @param block Pointer to the block ended by the jump.
+ * @param offset Value of the register the jump added to NNN.
+ * @return struct chip8_block* The block installed at the target, NULL if there is none.
+ */
+static struct chip8_block* chip8_block_jump(struct chip8* chip8, struct chip8_block_cache* cache, const struct chip8_block* block, unsigned char offset)
+{
+    struct chip8_block_site* site = &chip8->jump_sites[(block->pc / 2) % CHIP8_BLOCK_JUMP_SITES];
+    uint32_t retirements = atomic_load_explicit(&cache->retirements, memory_order_relaxed);
+    if (site->block != block || site->retirements != retirements)
+    {
+        memset(site, 0, sizeof(struct chip8_block_site));
+        site->block = block;
+        site->retirements = retirements;
+    }
+
+    for (int i = 0 ; i < CHIP8_BLOCK_JUMP_WAYS ; i++)
+    {
+        if (site->targets[i] && site->offsets[i] == offset)
+        {
+            chip8->stats.jump_hits++;
+            return site->targets[i];
+        }
+    }
+
+    chip8->stats.jump_misses++;
+    unsigned short target = chip8->registers.PC;
+    if (target >= CHIP8_MEMORY_SIZE)
+    {
+        return NULL;
+    }
+    struct chip8_block* next = atomic_load_explicit(&cache->blocks[target], memory_order_acquire);
+    if (next)
+    {
+        site->offsets[site->victim] = offset;
+        site->targets[site->victim] = next;
+        site->victim = (site->victim + 1) % CHIP8_BLOCK_JUMP_WAYS;
+    }
+    return next;
+}
+
+
+#define CHIP8_BLOCK_CASE(name, mask, match, format, flags, ...) \
+    case CHIP8_OP_##name:                                      \
+    {                                                          \
+        __VA_ARGS__                                            \
+    }                                                          \
+    break;
+
+/**
+ * @brief Run the first instructions of a block, with the semantics of chip8isa.h and their operands already decoded.
+ *        Always inlined into the variants, where the quirks are a constant.
+ * 
+ * @param chip8 Pointer to a chip8 struct whose PC is the entry of the block.
+ * @param block Pointer to the block.
+ * @param length Number of instructions to run, at most the length of the block.
+ * @param quirks The quirk profile of the variant.
+ * @return Void.
+ */
+static inline __attribute__((always_inline)) void chip8_block_ops_profile(struct chip8* chip8, const struct chip8_block* block, int length, const unsigned int quirks)
+{
+    struct chip8_registers* registers = &chip8->registers;
+    unsigned char* V = registers->V;
+    unsigned short pc = block->pc;
+    for (int i = 0 ; i < length ; i++)
+    {
+        const struct chip8_block_op* op = &block->ops[i];
+        unsigned char x = op->x;
+        unsigned char y = op->y;
+        unsigned char kk = op->kk;
+        unsigned char n = op->kk & 0x0f;
+        unsigned short nnn = op->nnn;
+        /* Every instruction sees PC past itself, as in chip8_step */
+        pc += 2;
+        registers->PC = pc;
+        switch (op->id)
+        {
+            CHIP8_ISA(CHIP8_BLOCK_CASE)
+
+            default:
+                chip8_unknown_opcode(chip8, op->opcode);
+            break;
+        }
+    }
+}
+
+
+/* One block executor per quirk profile, as for the interpreter */
+#define CHIP8_BLOCK_VARIANT(profile)                                                                        \
+    static void chip8_block_ops_##profile(struct chip8* chip8, const struct chip8_block* block, int length)  \
+    {                                                                                                       \
+        chip8_block_ops_profile(chip8, block, length, profile);                                             \
+    }
+
+CHIP8_QUIRK_EACH(CHIP8_BLOCK_VARIANT)
+
+#define CHIP8_BLOCK_VARIANT_ENTRY(profile) chip8_block_ops_##profile,
+
+static void (* const chip8_block_variants[])(struct chip8*, const struct chip8_block*, int) = { CHIP8_QUIRK_EACH(CHIP8_BLOCK_VARIANT_ENTRY) };
+
+_Static_assert(sizeof(chip8_block_variants) / sizeof(chip8_block_variants[0]) == CHIP8_QUIRK_PROFILES,
+               "every quirk profile must have a block executor");
+
+
+/**
+ * @brief Run the instructions of a block, or only the first ones when the budget is shorter.
+ * 
+ * @param chip8 Pointer to a chip8 struct whose PC is the entry of the block.
+ * @param block Pointer to the block.
+ * @param ops The executor of the quirk profile of the instance.
+ * @param budget Most instructions that may be executed.
+ * @param next Receives the block to run next when a return or a computed jump has already resolved it, NULL otherwise.
+ * @return int The number of executed instructions.
+ */
+static int chip8_block_execute(struct chip8* chip8, const struct chip8_block* block,
+                               void (*ops)(struct chip8*, const struct chip8_block*, int),
+                               int budget, struct chip8_block** next)
+{
+    struct chip8_block_cache* cache = chip8->block_cache;
+    struct chip8_registers* registers = &chip8->registers;
+    int length = block->length < budget ? block->length : budget;
+    unsigned short pc = block->pc + length * 2;
+    ops(chip8, block, length);
+    chip8->stats.instructions += length;
+    chip8->stats.block_instructions += length;
+    if (length < block->length)
+    {
+        return length;
+    }
+
+    /* Control flow only ends blocks, resolve where it goes from the state of the instance */
+    const struct chip8_block_op* last = &block->ops[length - 1];
+    switch (last->id)
+    {
+        case CHIP8_OP_CALL:
+            if (registers->SP < CHIP8_TOTAL_STACK_DEPTH)
+            {
+                /* Resolve the return now, the block at the return address is likely installed by then */
+                struct chip8_block_frame* frame = &chip8->shadow_stack[registers->SP];
+                frame->retirements = atomic_load_explicit(&cache->retirements, memory_order_relaxed);
+                frame->block = atomic_load_explicit(&cache->blocks[pc], memory_order_acquire);
+                frame->pc = pc;
+            }
+        break;
+
+        case CHIP8_OP_RET:
+        {
+            /* The frame is only trusted when the stack popped the address it was pushed with */
+            unsigned int slot = registers->SP + 1;
+            const struct chip8_block_frame* frame = slot < CHIP8_TOTAL_STACK_DEPTH ? &chip8->shadow_stack[slot] : NULL;
+            if (frame && frame->block && frame->pc == registers->PC &&
+                frame->retirements == atomic_load_explicit(&cache->retirements, memory_order_relaxed))
+            {
+                *next = frame->block;
+                chip8->stats.return_hits++;
+            }
+            else
+            {
+                chip8->stats.return_misses++;
+            }
+        }
+        break;
+
+        case CHIP8_OP_JP_V0:
+            /* Whichever register the quirk profile adds, its value is what the jump added to NNN */
+            *next = chip8_block_jump(chip8, cache, block, (unsigned char) (registers->PC - last->nnn));
+        break;
+    }
+    return length;
+}
+
+
+/**
+ * @brief Execute instructions, running the installed blocks and interpreting the rest.
+ *        The result is the same as calling chip8_step the same number of times.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param cache Pointer to the chip8_block_cache struct of the instance.
+ * @param instructions Number of instructions to execute.
+ * @return Void.
+ */
+void chip8_block_run(struct chip8* chip8, int instructions)
+{
+    struct chip8_block_cache* cache = chip8->block_cache;
+    void (*ops)(struct chip8*, const struct chip8_block*, int) = chip8_block_variants[chip8->quirks];
+    bool timing = cache->timing;
+    uint64_t mark = timing ? SDL_GetPerformanceCounter() : 0;
+    uint64_t* tier = &chip8->stats.interpreter_ticks;
+    chip8_block_enter(cache);
+
+    /* The first instruction is where a frame resumes, not necessarily an entry, count it anyway */
+    bool entry = true;
+    struct chip8_block* next = NULL;
+    while (instructions > 0)
+    {
+        unsigned short pc = chip8->registers.PC;
+        struct chip8_block* block = next;
+        next = NULL;
+        if (!block && pc < CHIP8_MEMORY_SIZE)
+        {
+            block = atomic_load_explicit(&cache->blocks[pc], memory_order_acquire);
+        }
+
+        if (timing)
+        {
+            uint64_t* current = block ? &chip8->stats.block_ticks : &chip8->stats.interpreter_ticks;
+            if (current != tier)
+            {
+                uint64_t now = SDL_GetPerformanceCounter();
+                *tier += now - mark;
+                mark = now;
+                tier = current;
+            }
+        }
+
+        if (block && cache->shared &&
+            ((chip8->written[block->pages[0]] & block->masks[0]) | (chip8->written[block->pages[1]] & block->masks[1])))
+        {
+            if (!chip8_block_matches(chip8, block))
+            {
+                chip8_block_diverge(chip8);
+                cache = chip8->block_cache;
+                if (!cache)
+                {
+                    for ( ; instructions > 0 ; instructions--)
+                    {
+                        chip8_step(chip8);
+                    }
+                    break;
+                }
+                continue;
+            }
+            /* The bytes written are the same as the reference, no need to check them again */
+            chip8->written[block->pages[0]] &= ~block->masks[0];
+            chip8->written[block->pages[1]] &= ~block->masks[1];
+        }
+
+        if (block)
+        {
+            instructions -= chip8_block_execute(chip8, block, ops, instructions, &next);
+            entry = true;
+            continue;
+        }
+
+        if (entry && pc < CHIP8_MEMORY_SIZE)
+        {
+            /* Plain load and store, a count lost to another instance only delays the request */
+            uint32_t hotness = atomic_load_explicit(&cache->hotness[pc], memory_order_relaxed) + 1;
+            atomic_store_explicit(&cache->hotness[pc], hotness, memory_order_relaxed);
+            if (hotness == CHIP8_BLOCK_HOT_THRESHOLD)
+            {
+                chip8_block_request(chip8, cache, pc);
+            }
+        }
+
+        unsigned short opcode = chip8_memory_get_short(&chip8->memory, pc);
+        chip8_step(chip8);
+        instructions--;
+        entry = chip8_block_ends(opcode);
+    }
+
+    if (timing)
+    {
+        *tier += SDL_GetPerformanceCounter() - mark;
+    }
+    chip8_block_leave(cache);
+}
\ No newline at end of file
@@ -0,0 +1,367 @@
+#include "chip8env.h"
+#include "chip8hash.h"
+#include "chip8log.h"
+#include "chip8observation.h"
+#include <stdlib.h>
+#include <memory.h>
+
+/**
+ * @brief Get the size of the observation of one environment.
+ * 
+ * @param observation The observation format.
+ * @return size_t Size in bytes.
+ */
+static size_t chip8_env_observation_size(enum chip8_env_observation observation)
+{
+    if (observation == CHIP8_ENV_OBSERVATION_PACKED)
+    {
+        return CHIP8_HEIGHT * sizeof(uint64_t);
+    }
+    return CHIP8_WIDTH * CHIP8_HEIGHT;
+}
+
+
+/**
+ * @brief Write the screen of an environment into its slot of the observations.
+ * 
+ * @param envs Pointer to a chip8_envs struct.
+ * @param index The environment.
+ * @return Void.
+ */
+static void chip8_env_observe(struct chip8_envs* envs, int index)
+{
+    if (!envs->observations)
+    {
+        return;
+    }
+
+    const struct chip8_screen* screen = &envs->envs[index].chip8.screen;
+    unsigned char* slot = (unsigned char*) envs->observations + index * chip8_env_observation_size(envs->config.observation);
+    if (envs->config.observation == CHIP8_ENV_OBSERVATION_PACKED)
+    {
+        memcpy(slot, screen->pixels, sizeof(screen->pixels));
+        return;
+    }
+
+    chip8_observation_expand_u8(screen->pixels, CHIP8_HEIGHT, slot);
+}
+
+
+/**
+ * @brief Start a new episode, sharing the memory of the initial state until it is written.
+ *        Every episode of every environment draws its own random numbers.
+ * 
+ * @param envs Pointer to a chip8_envs struct.
+ * @param index The environment.
+ * @return Void.
+ */
+static void chip8_env_reset_one(struct chip8_envs* envs, int index)
+{
+    struct chip8_env* env = &envs->envs[index];
+    chip8_free(&env->chip8);
+    chip8_fork(&env->chip8, &envs->initial);
+
+    uint64_t stream = (uint64_t) index << 32 | env->episode;
+    chip8_seed(&env->chip8, (uint32_t) chip8_hash_mix(chip8_hash_mix(stream) ^ envs->config.seed));
+
+    for (int i = 0 ; i < envs->config.total_probes ; i++)
+    {
+        env->probed[i] = chip8_memory_get(&env->chip8.memory, envs->probes[i].address);
+    }
+    env->frames = 0;
+    env->episode += 1;
+    env->done = false;
+}
+
+
+/**
+ * @brief Play the action of an environment and evaluate its probes.
+ * 
+ * @param envs Pointer to a chip8_envs struct.
+ * @param index The environment.
+ * @return Void.
+ */
+static void chip8_env_step_one(struct chip8_envs* envs, int index)
+{
+    struct chip8_env* env = &envs->envs[index];
+    if (env->done)
+    {
+        chip8_env_reset_one(envs, index);
+    }
+
+    int key = envs->actions ? envs->actions[index] : CHIP8_ENV_NO_KEY;
+    if (key != CHIP8_ENV_NO_KEY)
+    {
+        chip8_keyboard_down(&env->chip8.keyboard, key);
+    }
+    for (int i = 0 ; i < envs->frames_per_step ; i++)
+    {
+        chip8_run_frame(&env->chip8, CHIP8_INSTRUCTIONS_PER_FRAME);
+    }
+    if (key != CHIP8_ENV_NO_KEY)
+    {
+        chip8_keyboard_up(&env->chip8.keyboard, key);
+    }
+    env->frames += envs->frames_per_step;
+
+    float reward = 0;
+    bool done = envs->config.max_episode_frames > 0 && env->frames >= envs->config.max_episode_frames;
+    for (int i = 0 ; i < envs->config.total_probes ; i++)
+    {
+        const struct chip8_env_probe* probe = &envs->probes[i];
+        unsigned char value = chip8_memory_get(&env->chip8.memory, probe->address);
+        switch (probe->kind)
+        {
+            case CHIP8_ENV_PROBE_REWARD:
+                reward += probe->scale * ((int) value - (int) env->probed[i]);
+            break;
+
+            case CHIP8_ENV_PROBE_DONE_EQUAL:
+                done |= value == probe->value;
+            break;
+
+            case CHIP8_ENV_PROBE_DONE_NOT_EQUAL:
+                done |= value != probe->value;
+            break;
+        }
+        env->probed[i] = value;
+    }
+    env->done = done;
+
+    if (envs->rewards)
+    {
+        envs->rewards[index] = reward;
+    }
+    if (envs->dones)
+    {
+        envs->dones[index] = done;
+    }
+}
+
+
+/**
+ * @brief Take environments of the current batch until none is left.
+ * 
+ * @param envs Pointer to a chip8_envs struct.
+ * @return Void.
+ */
+static void chip8_env_run_batch(struct chip8_envs* envs)
+{
+    for (;;)
+    {
+        int index = atomic_fetch_add_explicit(&envs->next, 1, memory_order_relaxed);
+        if (index >= envs->config.count)
+        {
+            return;
+        }
+
+        if (envs->resetting)
+        {
+            chip8_env_reset_one(envs, index);
+        }
+        else
+        {
+            chip8_env_step_one(envs, index);
+        }
+        chip8_env_observe(envs, index);
+    }
+}
+
+
+/**
+ * @brief Worker thread, runs its share of every batch.
+ * 
+ * @param data Pointer to the chip8_envs struct.
+ * @return int 0.
+ */
+static int chip8_env_worker(void* data)
+{
+    struct chip8_envs* envs = data;
+    for (;;)
+    {
+        SDL_SemWait(envs->start);
+        if (!atomic_load_explicit(&envs->running, memory_order_acquire))
+        {
+            return 0;
+        }
+        chip8_env_run_batch(envs);
+        SDL_SemPost(envs->finished);
+    }
+}
+
+
+/**
+ * @brief Run the batch described by the arguments stored in envs, on the workers and the caller thread.
+ * 
+ * @param envs Pointer to a chip8_envs struct.
+ * @return Void.
+ */
+static void chip8_env_dispatch(struct chip8_envs* envs)
+{
+    atomic_store_explicit(&envs->next, 0, memory_order_relaxed);
+    for (int i = 0 ; i < envs->config.threads ; i++)
+    {
+        SDL_SemPost(envs->start);
+    }
+    chip8_env_run_batch(envs);
+    for (int i = 0 ; i < envs->config.threads ; i++)
+    {
+        SDL_SemWait(envs->finished);
+    }
+}
+
+
+/**
+ * @brief Create the environments and their worker threads.
+ * 
+ * @param envs Pointer to a chip8_envs struct.
+ * @param config Pointer to the configuration, the ROM and probes are copied.
+ * @return bool True if the environments have been created.
+ */
+bool chip8_env_create(struct chip8_envs* envs, const struct chip8_env_config* config)
+{
+    memset(envs, 0, sizeof(struct chip8_envs));
+    if (config->count < 1 || config->threads < 0 || config->threads > CHIP8_ENV_MAX_THREADS ||
+        config->total_probes < 0 || config->total_probes > CHIP8_ENV_MAX_PROBES ||
+        config->rom_size == 0 || CHIP8_PROGRAM_LOAD_ADDRESS + config->rom_size >= CHIP8_MEMORY_SIZE ||
+        config->quirks >= CHIP8_QUIRK_PROFILES)
+    {
+        CHIP8_LOG_ERROR("Invalid environment configuration");
+        return false;
+    }
+    for (int i = 0 ; i < config->total_probes ; i++)
+    {
+        if (config->probes[i].address >= CHIP8_MEMORY_SIZE)
+        {
+            CHIP8_LOG_ERROR("Probe %d reads outside memory (%x)", i, config->probes[i].address);
+            return false;
+        }
+        envs->probes[i] = config->probes[i];
+    }
+    envs->config = *config;
+    envs->config.probes = envs->probes;
+
+    envs->envs = calloc(config->count, sizeof(struct chip8_env));
+    envs->start = SDL_CreateSemaphore(0);
+    envs->finished = SDL_CreateSemaphore(0);
+    if (!envs->envs || !envs->start || !envs->finished)
+    {
+        CHIP8_LOG_ERROR("Failed to allocate %d environments", config->count);
+        chip8_env_destroy(envs);
+        return false;
+    }
+
+    chip8_init(&envs->initial);
+    chip8_set_quirks(&envs->initial, config->quirks);
+    chip8_load(&envs->initial, config->rom, config->rom_size);
+
+    /* Every environment runs the blocks compiled for the ROM by any of them */
+    struct chip8_block_cache* block_cache = chip8_block_cache_shared(&envs->initial.memory);
+    if (block_cache)
+    {
+        chip8_set_block_cache(&envs->initial, block_cache);
+        chip8_block_cache_release(block_cache);
+    }
+
+    atomic_init(&envs->running, true);
+    for (int i = 0 ; i < config->threads ; i++)
+    {
+        envs->threads[i] = SDL_CreateThread(chip8_env_worker, "chip8 env", envs);
+        if (!envs->threads[i])
+        {
+            CHIP8_LOG_ERROR("Failed to create an environment thread: %s", SDL_GetError());
+            envs->config.threads = i;
+            chip8_env_destroy(envs);
+            return false;
+        }
+    }
+
+    chip8_env_reset(envs, NULL);
+    return true;
+}
+
+
+/**
+ * @brief Stop the worker threads and release the environments.
+ * 
+ * @param envs Pointer to a chip8_envs struct.
+ * @return Void.
+ */
+void chip8_env_destroy(struct chip8_envs* envs)
+{
+    atomic_store_explicit(&envs->running, false, memory_order_release);
+    for (int i = 0 ; i < envs->config.threads ; i++)
+    {
+        SDL_SemPost(envs->start);
+    }
+    for (int i = 0 ; i < envs->config.threads ; i++)
+    {
+        SDL_WaitThread(envs->threads[i], NULL);
+    }
+    envs->config.threads = 0;
+
+    if (envs->envs)
+    {
+        for (int i = 0 ; i < envs->config.count ; i++)
+        {
+            chip8_free(&envs->envs[i].chip8);
+        }
+        free(envs->envs);
+        envs->envs = NULL;
+    }
+    chip8_free(&envs->initial);
+    if (envs->start)
+    {
+        SDL_DestroySemaphore(envs->start);
+        envs->start = NULL;
+    }
+    if (envs->finished)
+    {
+        SDL_DestroySemaphore(envs->finished);
+        envs->finished = NULL;
+    }
+}
+
+
+/**
+ * @brief Start a new episode in every environment.
+ * 
+ * @param envs Pointer to a chip8_envs struct.
+ * @param observations Array receiving the first observation of each environment, or NULL.
+ * @return Void.
+ */
+void chip8_env_reset(struct chip8_envs* envs, void* observations)
+{
+    envs->resetting = true;
+    envs->actions = NULL;
+    envs->frames_per_step = 0;
+    envs->observations = observations;
+    envs->rewards = NULL;
+    envs->dones = NULL;
+    chip8_env_dispatch(envs);
+}
+
+
+/**
+ * @brief Advance every environment by one step. An environment whose episode ended
+ *        at the previous step starts a new one first.
+ * 
+ * @param envs Pointer to a chip8_envs struct.
+ * @param actions Key held by each environment during the step, CHIP8_ENV_NO_KEY for none.
+ * @param frames_per_step Number of frames the key is held.
+ * @param observations Array receiving the observation of each environment, or NULL.
+ * @param rewards Array receiving the reward of each environment, or NULL.
+ * @param dones Array receiving whether the episode of each environment has ended, or NULL.
+ * @return Void.
+ */
+void chip8_env_step(struct chip8_envs* envs, const int* actions, int frames_per_step,
+                    void* observations, float* rewards, bool* dones)
+{
+    envs->resetting = false;
+    envs->actions = actions;
+    envs->frames_per_step = frames_per_step;
+    envs->observations = observations;
+    envs->rewards = rewards;
+    envs->dones = dones;
+    chip8_env_dispatch(envs);
+}
\ No newline at end of file
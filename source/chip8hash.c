@@ -0,0 +1,108 @@
+#include "chip8hash.h"
+#include "chip8log.h"
+#include <stdlib.h>
+
+/* Slots are probed linearly, at most this many before the set is considered full */
+#define CHIP8_STATE_SET_MAX_PROBES 1024
+
+/**
+ * @brief Allocate an empty set.
+ * 
+ * @param set Pointer to a chip8_state_set struct.
+ * @param capacity Number of slots, rounded up to a power of two.
+ * @return bool True if the slots have been allocated.
+ */
+bool chip8_state_set_init(struct chip8_state_set* set, uint64_t capacity)
+{
+    set->capacity = 1;
+    while (set->capacity < capacity)
+    {
+        set->capacity <<= 1;
+    }
+
+    set->slots = calloc(set->capacity, sizeof(uint64_t));
+    if (!set->slots)
+    {
+        CHIP8_LOG_ERROR("Failed to allocate a state set of %llu slots", (unsigned long long) set->capacity);
+        return false;
+    }
+    atomic_init(&set->count, 0);
+    atomic_init(&set->overflows, 0);
+    return true;
+}
+
+
+/**
+ * @brief Release the slots of the set.
+ * 
+ * @param set Pointer to a chip8_state_set struct.
+ * @return Void.
+ */
+void chip8_state_set_free(struct chip8_state_set* set)
+{
+    free((void*) set->slots);
+    set->slots = NULL;
+}
+
+
+/**
+ * @brief Add a hash to the set. Safe to call from any number of threads at once.
+ * 
+ * @param set Pointer to a chip8_state_set struct.
+ * @param hash The state hash.
+ * @return bool True if the hash was not in the set yet, false if it was already (or the set is full).
+ */
+bool chip8_state_set_insert(struct chip8_state_set* set, uint64_t hash)
+{
+    /* 0 marks empty slots */
+    hash = hash ? hash : 1;
+
+    uint64_t mask = set->capacity - 1;
+    for (uint64_t i = 0 ; i < CHIP8_STATE_SET_MAX_PROBES && i <= mask ; i++)
+    {
+        _Atomic uint64_t* slot = &set->slots[(hash + i) & mask];
+        uint64_t current = atomic_load_explicit(slot, memory_order_relaxed);
+        if (current == 0 &&
+            atomic_compare_exchange_strong_explicit(slot, &current, hash, memory_order_relaxed, memory_order_relaxed))
+        {
+            atomic_fetch_add_explicit(&set->count, 1, memory_order_relaxed);
+            return true;
+        }
+        /* Either the slot was taken or another thread has just filled it */
+        if (current == hash)
+        {
+            return false;
+        }
+    }
+
+    atomic_fetch_add_explicit(&set->overflows, 1, memory_order_relaxed);
+    return false;
+}
+
+
+/**
+ * @brief Check whether a hash is in the set.
+ * 
+ * @param set Pointer to a chip8_state_set struct.
+ * @param hash The state hash.
+ * @return bool True if the hash is in the set.
+ */
+bool chip8_state_set_contains(const struct chip8_state_set* set, uint64_t hash)
+{
+    hash = hash ? hash : 1;
+
+    uint64_t mask = set->capacity - 1;
+    for (uint64_t i = 0 ; i < CHIP8_STATE_SET_MAX_PROBES && i <= mask ; i++)
+    {
+        uint64_t current = atomic_load_explicit(&set->slots[(hash + i) & mask], memory_order_relaxed);
+        if (current == hash)
+        {
+            return true;
+        }
+        if (current == 0)
+        {
+            return false;
+        }
+    }
+    return false;
+}
\ No newline at end of file
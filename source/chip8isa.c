@@ -0,0 +1,305 @@
+#include "chip8isa.h"
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#define CHIP8_ISA_CHECK(name, mask, match, format, flags, ...) \
+    _Static_assert((mask) == CHIP8_ISA_GROUP_MASK((match) >> 12), #name " must use the mask of its group");
+
+CHIP8_ISA(CHIP8_ISA_CHECK)
+
+#define CHIP8_ISA_ENTRY(name, mask, match, format, flags, ...) { #name, mask, match, format, flags },
+
+const struct chip8_isa_entry chip8_isa_table[CHIP8_OP_COUNT] =
+{
+    CHIP8_ISA(CHIP8_ISA_ENTRY)
+    { "UNKNOWN", 0x0000, 0x0000, "DW {opcode}", 0 }
+};
+
+/* An operand of the formats, with where it sits in the opcode */
+struct chip8_isa_operand
+{
+    const char* name;
+    int shift;
+    unsigned short limit;
+    /* Digits written by the disassembler */
+    int digits;
+};
+
+static const struct chip8_isa_operand chip8_isa_operands[] =
+{
+    { "x", 8, 0xf, 1 },
+    { "y", 4, 0xf, 1 },
+    { "n", 0, 0xf, 1 },
+    { "kk", 0, 0xff, 2 },
+    { "nnn", 0, 0xfff, 3 },
+    { "opcode", 0, 0xffff, 4 }
+};
+
+/**
+ * @brief Find the operand named by a placeholder of a format.
+ * 
+ * @param format Pointer to the opening brace of the placeholder, moved past the closing one.
+ * @return const struct chip8_isa_operand* The operand, NULL if the name is unknown.
+ */
+static const struct chip8_isa_operand* chip8_isa_operand(const char** format)
+{
+    const char* name = *format + 1;
+    const char* end = strchr(name, '}');
+    if (!end)
+    {
+        return NULL;
+    }
+    *format = end + 1;
+
+    for (size_t i = 0 ; i < sizeof(chip8_isa_operands) / sizeof(chip8_isa_operands[0]) ; i++)
+    {
+        if (strlen(chip8_isa_operands[i].name) == (size_t) (end - name) &&
+            strncmp(chip8_isa_operands[i].name, name, end - name) == 0)
+        {
+            return &chip8_isa_operands[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * @brief Write the assembly text of an opcode, as in the format of its instruction.
+ *        Registers and nibbles are written as one hexadecimal digit, bytes and addresses with a 0x prefix.
+ * 
+ * @param opcode The opcode.
+ * @param text Buffer receiving the text.
+ * @param size Size of the buffer.
+ * @return int The length of the whole text, as snprintf, which was truncated if it is not less than size.
+ */
+int chip8_isa_disassemble(unsigned short opcode, char* text, size_t size)
+{
+    const char* format = chip8_isa_table[chip8_isa_decode(opcode)].format;
+    int length = 0;
+    while (*format)
+    {
+        char* out = (size_t) length < size ? text + length : NULL;
+        size_t left = out ? size - length : 0;
+        if (*format != '{')
+        {
+            if (left > 1)
+            {
+                *out = *format;
+            }
+            length++;
+            format++;
+            continue;
+        }
+
+        const struct chip8_isa_operand* operand = chip8_isa_operand(&format);
+        unsigned int value = operand ? (opcode >> operand->shift) & operand->limit : 0;
+        if (operand && operand->digits == 1)
+        {
+            length += snprintf(out, left, "%X", value);
+        }
+        else
+        {
+            length += snprintf(out, left, "0x%0*X", operand ? operand->digits : 1, value);
+        }
+    }
+
+    if (size > 0)
+    {
+        text[(size_t) length < size ? (size_t) length : size - 1] = '\0';
+    }
+    return length;
+}
+
+
+/**
+ * @brief Parse a hexadecimal number, with an optional 0x or # prefix.
+ * 
+ * @param text Pointer to the text, moved past the number.
+ * @param value Receives the number.
+ * @return true A number has been parsed.
+ * @return false There is no number at the text.
+ */
+static bool chip8_isa_parse_number(const char** text, unsigned int* value)
+{
+    const char* p = *text;
+    if (*p == '#')
+    {
+        p++;
+    }
+    else if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && isxdigit((unsigned char) p[2]))
+    {
+        p += 2;
+    }
+
+    if (!isxdigit((unsigned char) *p))
+    {
+        return false;
+    }
+    *value = 0;
+    while (isxdigit((unsigned char) *p) && *value <= 0xffff)
+    {
+        *value = *value * 16 + (isdigit((unsigned char) *p) ? *p - '0' : toupper((unsigned char) *p) - 'A' + 10);
+        p++;
+    }
+    *text = p;
+    return true;
+}
+
+
+/**
+ * @brief Match a text against the format of an instruction.
+ * 
+ * @param entry Pointer to the entry of the instruction.
+ * @param text The text.
+ * @param opcode Receives the opcode when the text matches.
+ * @return true The text is the instruction.
+ * @return false The text does not match the format or an operand is out of range.
+ */
+static bool chip8_isa_match(const struct chip8_isa_entry* entry, const char* text, unsigned short* opcode)
+{
+    const char* format = entry->format;
+    unsigned int result = entry->match;
+    while (*format)
+    {
+        if (*format == ' ')
+        {
+            /* A space of the format stands for any run of spaces, even an empty one */
+            while (isspace((unsigned char) *text))
+            {
+                text++;
+            }
+            format++;
+            continue;
+        }
+        if (*format != '{')
+        {
+            if (toupper((unsigned char) *text) != toupper((unsigned char) *format))
+            {
+                return false;
+            }
+            text++;
+            format++;
+            continue;
+        }
+
+        const struct chip8_isa_operand* operand = chip8_isa_operand(&format);
+        unsigned int value;
+        if (!operand || !chip8_isa_parse_number(&text, &value) || value > operand->limit)
+        {
+            return false;
+        }
+        result |= value << operand->shift;
+    }
+
+    while (isspace((unsigned char) *text))
+    {
+        text++;
+    }
+    if (*text)
+    {
+        return false;
+    }
+    *opcode = result;
+    return true;
+}
+
+
+/**
+ * @brief Encode one instruction written as the disassembler writes it. Mnemonics are not case
+ *        sensitive, numbers are hexadecimal and spaces are optional around the operands.
+ * 
+ * @param text The instruction, without comment.
+ * @param opcode Receives the opcode.
+ * @return true The instruction has been encoded.
+ * @return false The text is not an instruction.
+ */
+bool chip8_isa_assemble(const char* text, unsigned short* opcode)
+{
+    while (isspace((unsigned char) *text))
+    {
+        text++;
+    }
+    /* DW, the format of the unknown opcodes, is tried last */
+    for (int i = 0 ; i < CHIP8_OP_COUNT ; i++)
+    {
+        if (chip8_isa_match(&chip8_isa_table[i], text, opcode))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* A name accepted for a set of quirks */
+struct chip8_isa_quirk_name
+{
+    const char* name;
+    unsigned int quirks;
+};
+
+static const struct chip8_isa_quirk_name chip8_isa_quirk_names[] =
+{
+    /* Profiles of the interpreters */
+    { "modern", 0 },
+    { "cosmac", CHIP8_QUIRK_SHIFT_VY | CHIP8_QUIRK_LOAD_STORE_I | CHIP8_QUIRK_VF_RESET | CHIP8_QUIRK_CLIP },
+    { "schip", CHIP8_QUIRK_CLIP | CHIP8_QUIRK_JUMP_VX },
+    /* Single quirks */
+    { "shift-vy", CHIP8_QUIRK_SHIFT_VY },
+    { "load-store-i", CHIP8_QUIRK_LOAD_STORE_I },
+    { "vf-reset", CHIP8_QUIRK_VF_RESET },
+    { "clip", CHIP8_QUIRK_CLIP },
+    { "jump-vx", CHIP8_QUIRK_JUMP_VX }
+};
+
+/**
+ * @brief Parse a quirk profile written as a comma separated list of profile names (modern, cosmac,
+ *        schip), quirk names (shift-vy, load-store-i, vf-reset, clip, jump-vx) or hexadecimal masks.
+ * 
+ * @param text The profile, such as "schip,vf-reset".
+ * @param quirks Receives the CHIP8_QUIRK_* flags of the profile.
+ * @return true The profile has been parsed.
+ * @return false A name is unknown or a mask has bits outside the quirks.
+ */
+bool chip8_isa_parse_quirks(const char* text, unsigned int* quirks)
+{
+    unsigned int result = 0;
+    while (true)
+    {
+        size_t length = strcspn(text, ",");
+        const char* end = text + length;
+        const char* number = text;
+        unsigned int value;
+        if (chip8_isa_parse_number(&number, &value) && number == end)
+        {
+            if (value >= CHIP8_QUIRK_PROFILES)
+            {
+                return false;
+            }
+            result |= value;
+        }
+        else
+        {
+            size_t i = 0;
+            size_t count = sizeof(chip8_isa_quirk_names) / sizeof(chip8_isa_quirk_names[0]);
+            while (i < count && (strlen(chip8_isa_quirk_names[i].name) != length ||
+                                 strncmp(chip8_isa_quirk_names[i].name, text, length) != 0))
+            {
+                i++;
+            }
+            if (i == count)
+            {
+                return false;
+            }
+            result |= chip8_isa_quirk_names[i].quirks;
+        }
+
+        if (*end == '\0')
+        {
+            break;
+        }
+        text = end + 1;
+    }
+    *quirks = result;
+    return true;
+}
\ No newline at end of file
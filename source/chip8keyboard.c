@@ -1,37 +1,71 @@
 #include "chip8keyboard.h"
 #include <assert.h>
+#include <memory.h>
+
+_Static_assert((CHIP8_KEYBOARD_LOOKUP_SIZE & (CHIP8_KEYBOARD_LOOKUP_SIZE - 1)) == 0, "lookup size must be a power of two");
+_Static_assert((CHIP8_KEYBOARD_QUEUE_SIZE & (CHIP8_KEYBOARD_QUEUE_SIZE - 1)) == 0, "queue size must be a power of two");
 
 static void chip8_keyboard_in_bounds(int key)
 {
     assert(key >= 0 && key < CHIP8_TOTAL_KEYS);
 }
 
+/**
+ * @brief Get the lookup slot where the search for a host keycode starts.
+ * 
+ * @param key Host keycode.
+ * @return int Index into the lookup table.
+ */
+static int chip8_keyboard_slot(int key)
+{
+    return key & (CHIP8_KEYBOARD_LOOKUP_SIZE - 1);
+}
+
 /**
  * @brief Define the map of the keyboard.
  * 
  * @param keyboard Pointer to a chip8_keyboard struct.
- * @param map Array containing the keyboard mapping.
+ * @param map Array containing the host keycode of every virtual key.
  */
-void chip8_keyboard_set_map(struct chip8_keyboard* keyboard, const char* map)
+void chip8_keyboard_set_map(struct chip8_keyboard* keyboard, const int* map)
 {
     keyboard->keyboard_map = map;
+    memset(keyboard->lookup, -1, sizeof(keyboard->lookup));
+
+    for (int i = 0 ; i < CHIP8_TOTAL_KEYS ; i++)
+    {
+        int slot = chip8_keyboard_slot(map[i]);
+        while (keyboard->lookup[slot] != -1)
+        {
+            slot = chip8_keyboard_slot(slot + 1);
+        }
+        keyboard->lookup[slot] = i;
+    }
 }
 
 /**
  * @brief Map the physical keyboard with the Chip-8 virtual keyboard.
  * 
  * @param keyboard Pointer to a chip8_keyboard struct.
- * @param key Character corresponding to the physical key.
- * @return int The mapped Chip-8 virtual key.
+ * @param key Host keycode of the physical key.
+ * @return int The mapped Chip-8 virtual key, -1 if the key is not mapped.
  */
-int chip8_keyboard_map(struct chip8_keyboard* keyboard, char key)
+int chip8_keyboard_map(struct chip8_keyboard* keyboard, int key)
 {
-    for (int i = 0 ; i < CHIP8_TOTAL_KEYS ; i++)
+    if (!keyboard->keyboard_map)
     {
-        if (keyboard->keyboard_map[i] == key)
+        return -1;
+    }
+
+    int slot = chip8_keyboard_slot(key);
+    while (keyboard->lookup[slot] != -1)
+    {
+        int virtual_key = keyboard->lookup[slot];
+        if (keyboard->keyboard_map[virtual_key] == key)
         {
-            return i;
+            return virtual_key;
         }
+        slot = chip8_keyboard_slot(slot + 1);
     }
 
     return -1;
@@ -48,7 +82,11 @@ int chip8_keyboard_map(struct chip8_keyboard* keyboard, char key)
 void chip8_keyboard_down(struct chip8_keyboard* keyboard, int key)
 {
     chip8_keyboard_in_bounds(key);
-    keyboard->keyboard[key] = true;
+    atomic_fetch_or_explicit(&keyboard->state, 1 << key, memory_order_relaxed);
+    if (keyboard->waiting && keyboard->pressed == -1)
+    {
+        keyboard->pressed = key;
+    }
 }
 
 
@@ -62,7 +100,7 @@ void chip8_keyboard_down(struct chip8_keyboard* keyboard, int key)
 void chip8_keyboard_up(struct chip8_keyboard* keyboard, int key)
 {
     chip8_keyboard_in_bounds(key);
-    keyboard->keyboard[key] = false;
+    atomic_fetch_and_explicit(&keyboard->state, ~(1 << key), memory_order_relaxed);
 }
 
 
@@ -76,5 +114,113 @@ void chip8_keyboard_up(struct chip8_keyboard* keyboard, int key)
  */
 bool chip8_keyboard_is_down(struct chip8_keyboard* keyboard, int key)
 {
-    return keyboard->keyboard[key];
+    keyboard->polls += 1;
+    uint16_t state = atomic_load_explicit(&keyboard->state, memory_order_relaxed);
+    return (state >> (key & 0x0f)) & 1;
+}
+
+
+/**
+ * @brief Poll for a key press on behalf of LD Vx, K without blocking.
+ *        The first call starts waiting, the key pressed after it is returned by a later call.
+ * 
+ * @param keyboard Pointer to a chip8_keyboard struct.
+ * @return int The virtual key pressed, -1 if no key has been pressed yet.
+ */
+int chip8_keyboard_take_press(struct chip8_keyboard* keyboard)
+{
+    keyboard->polls += 1;
+    if (!keyboard->waiting)
+    {
+        keyboard->waiting = true;
+        keyboard->pressed = -1;
+        return -1;
+    }
+
+    int key = keyboard->pressed;
+    if (key != -1)
+    {
+        keyboard->waiting = false;
+        keyboard->pressed = -1;
+    }
+    return key;
+}
+
+
+/**
+ * @brief Update the keyboard with an event taken from the queue.
+ * 
+ * @param keyboard Pointer to a chip8_keyboard struct.
+ * @param event Pointer to the event to apply.
+ * @return Void.
+ */
+void chip8_keyboard_apply(struct chip8_keyboard* keyboard, const struct chip8_keyboard_event* event)
+{
+    if (event->down)
+    {
+        chip8_keyboard_down(keyboard, event->key);
+    }
+    else
+    {
+        chip8_keyboard_up(keyboard, event->key);
+    }
+}
+
+
+/**
+ * @brief Initialize an empty event queue.
+ * 
+ * @param queue Pointer to a chip8_keyboard_queue struct.
+ * @return Void.
+ */
+void chip8_keyboard_queue_init(struct chip8_keyboard_queue* queue)
+{
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+}
+
+
+/**
+ * @brief Append an event to the queue. Must only be called by the producer thread.
+ * 
+ * @param queue Pointer to a chip8_keyboard_queue struct.
+ * @param event Pointer to the event to copy into the queue.
+ * @return true The event has been queued.
+ * @return false The queue is full and the event has been dropped.
+ */
+bool chip8_keyboard_queue_push(struct chip8_keyboard_queue* queue, const struct chip8_keyboard_event* event)
+{
+    unsigned int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head - tail == CHIP8_KEYBOARD_QUEUE_SIZE)
+    {
+        return false;
+    }
+
+    queue->events[head % CHIP8_KEYBOARD_QUEUE_SIZE] = *event;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+
+/**
+ * @brief Take the oldest event from the queue. Must only be called by the consumer thread.
+ * 
+ * @param queue Pointer to a chip8_keyboard_queue struct.
+ * @param event Pointer where the event is copied.
+ * @return true An event has been taken.
+ * @return false The queue is empty.
+ */
+bool chip8_keyboard_queue_pop(struct chip8_keyboard_queue* queue, struct chip8_keyboard_event* event)
+{
+    unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail == head)
+    {
+        return false;
+    }
+
+    *event = queue->events[tail % CHIP8_KEYBOARD_QUEUE_SIZE];
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
 }
\ No newline at end of file
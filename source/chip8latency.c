@@ -0,0 +1,205 @@
+#include "chip8latency.h"
+#include <memory.h>
+#include <SDL2/SDL_timer.h>
+
+/**
+ * @brief Reset the statistics and start with no sample in flight.
+ * 
+ * @param latency Pointer to a chip8_latency struct.
+ * @return Void.
+ */
+void chip8_latency_init(struct chip8_latency* latency)
+{
+    memset(latency, 0, sizeof(struct chip8_latency));
+    atomic_init(&latency->stage, CHIP8_LATENCY_IDLE);
+    latency->frequency = SDL_GetPerformanceFrequency();
+}
+
+
+/**
+ * @brief Add the time elapsed between two timestamps to a histogram.
+ * 
+ * @param latency Pointer to a chip8_latency struct.
+ * @param histogram Pointer to the histogram to update.
+ * @param start Timestamp of the key press.
+ * @param end Timestamp of the stage that has been reached.
+ * @return Void.
+ */
+static void chip8_latency_record(struct chip8_latency* latency, struct chip8_latency_histogram* histogram, uint64_t start, uint64_t end)
+{
+    uint64_t us = (end - start) * 1000000 / latency->frequency;
+    uint64_t bucket = us / CHIP8_LATENCY_BUCKET_US;
+    if (bucket < CHIP8_LATENCY_BUCKETS)
+    {
+        histogram->buckets[bucket] += 1;
+    }
+    else
+    {
+        histogram->overflow += 1;
+    }
+    histogram->count += 1;
+}
+
+
+/**
+ * @brief Start a new sample when a key press is applied to the emulator.
+ *        A previous sample that did not reach the screen is abandoned.
+ * 
+ * @param latency Pointer to a chip8_latency struct.
+ * @param chip8 Pointer to the chip8 struct the event is applied to.
+ * @param event Pointer to the event taken from the keyboard queue.
+ * @return Void.
+ */
+void chip8_latency_key_event(struct chip8_latency* latency, struct chip8* chip8, const struct chip8_keyboard_event* event)
+{
+    if (!event->down)
+    {
+        return;
+    }
+
+    int stage = atomic_load_explicit(&latency->stage, memory_order_acquire);
+    if (stage == CHIP8_LATENCY_CHANGED)
+    {
+        latency->overlapped += 1;
+        return;
+    }
+
+    if (stage != CHIP8_LATENCY_IDLE)
+    {
+        latency->abandoned += 1;
+    }
+
+    latency->event_time = event->timestamp;
+    latency->polls = chip8->keyboard.polls;
+    atomic_store_explicit(&latency->stage, CHIP8_LATENCY_PRESSED, memory_order_relaxed);
+}
+
+
+/**
+ * @brief Advance the sample in flight after an instruction has been executed.
+ * 
+ * @param latency Pointer to a chip8_latency struct.
+ * @param chip8 Pointer to the chip8 struct that executed the instruction.
+ * @return Void.
+ */
+void chip8_latency_exec(struct chip8_latency* latency, struct chip8* chip8)
+{
+    switch (atomic_load_explicit(&latency->stage, memory_order_relaxed))
+    {
+        case CHIP8_LATENCY_PRESSED:
+            if (chip8->keyboard.polls != latency->polls)
+            {
+                latency->observe_time = SDL_GetPerformanceCounter();
+                latency->screen_version = chip8->screen.version;
+                atomic_store_explicit(&latency->stage, CHIP8_LATENCY_OBSERVED, memory_order_relaxed);
+                chip8_latency_record(latency, &latency->observe, latency->event_time, latency->observe_time);
+            }
+        break;
+
+        case CHIP8_LATENCY_OBSERVED:
+            if (chip8->screen.version != latency->screen_version)
+            {
+                latency->change_time = SDL_GetPerformanceCounter();
+                latency->change_version = chip8->screen.version;
+                chip8_latency_record(latency, &latency->change, latency->event_time, latency->change_time);
+                /* Hand the sample over to the presenter */
+                atomic_store_explicit(&latency->stage, CHIP8_LATENCY_CHANGED, memory_order_release);
+            }
+        break;
+
+        default:
+        break;
+    }
+}
+
+
+/**
+ * @brief Complete the sample in flight when a screen holding the change is presented.
+ * 
+ * @param latency Pointer to a chip8_latency struct.
+ * @param screen Pointer to the chip8_screen struct that has just been presented.
+ * @return Void.
+ */
+void chip8_latency_present(struct chip8_latency* latency, const struct chip8_screen* screen)
+{
+    if (atomic_load_explicit(&latency->stage, memory_order_acquire) != CHIP8_LATENCY_CHANGED)
+    {
+        return;
+    }
+
+    /* Screens older than the change do not complete the sample */
+    if ((int) (screen->version - latency->change_version) < 0)
+    {
+        return;
+    }
+
+    chip8_latency_record(latency, &latency->present, latency->event_time, SDL_GetPerformanceCounter());
+    atomic_store_explicit(&latency->stage, CHIP8_LATENCY_IDLE, memory_order_release);
+}
+
+
+/**
+ * @brief Get a percentile of a histogram.
+ * 
+ * @param histogram Pointer to a chip8_latency_histogram struct.
+ * @param percentile The percentile to compute, from 0 to 100.
+ * @return unsigned int Upper bound of the bucket holding the percentile, in microseconds.
+ */
+unsigned int chip8_latency_percentile(const struct chip8_latency_histogram* histogram, int percentile)
+{
+    /* Rank of the sample, rounded up so that p100 is the last sample */
+    uint64_t rank = ((uint64_t) histogram->count * percentile + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0 ; i < CHIP8_LATENCY_BUCKETS ; i++)
+    {
+        seen += histogram->buckets[i];
+        if (seen >= rank && seen > 0)
+        {
+            return (i + 1) * CHIP8_LATENCY_BUCKET_US;
+        }
+    }
+    return CHIP8_LATENCY_BUCKETS * CHIP8_LATENCY_BUCKET_US;
+}
+
+
+/**
+ * @brief Print one line of the report.
+ * 
+ * @param out Stream where the report is written.
+ * @param name Name of the stage.
+ * @param histogram Pointer to the histogram of the stage.
+ * @return Void.
+ */
+static void chip8_latency_report_histogram(FILE* out, const char* name, const struct chip8_latency_histogram* histogram)
+{
+    if (histogram->count == 0)
+    {
+        fprintf(out, "  %-16s no samples\n", name);
+        return;
+    }
+
+    fprintf(out, "  %-16s n=%-6u p50=%6.1fms p95=%6.1fms p99=%6.1fms over=%u\n",
+            name,
+            histogram->count,
+            chip8_latency_percentile(histogram, 50) / 1000.0,
+            chip8_latency_percentile(histogram, 95) / 1000.0,
+            chip8_latency_percentile(histogram, 99) / 1000.0,
+            histogram->overflow);
+}
+
+
+/**
+ * @brief Print the latency percentiles of the session.
+ * 
+ * @param latency Pointer to a chip8_latency struct.
+ * @param out Stream where the report is written.
+ * @return Void.
+ */
+void chip8_latency_report(struct chip8_latency* latency, FILE* out)
+{
+    fprintf(out, "Input latency (key press to stage):\n");
+    chip8_latency_report_histogram(out, "keyboard read", &latency->observe);
+    chip8_latency_report_histogram(out, "screen change", &latency->change);
+    chip8_latency_report_histogram(out, "present", &latency->present);
+    fprintf(out, "  abandoned presses: %u, overlapped presses: %u\n", latency->abandoned, latency->overlapped);
+}
\ No newline at end of file
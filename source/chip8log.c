@@ -0,0 +1,423 @@
+#include "chip8log.h"
+#include <memory.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_timer.h>
+#include <SDL2/SDL_atomic.h>
+
+_Static_assert((CHIP8_LOG_RECORDS & (CHIP8_LOG_RECORDS - 1)) == 0, "log size must be a power of two");
+
+/* Pause of the logging thread when the queue is empty, in milliseconds */
+#define CHIP8_LOG_IDLE_INTERVAL 5
+
+struct chip8_log_record
+{
+    /* Position of the record in the queue, tells whether the cell is free or holds a message */
+    _Atomic unsigned int sequence;
+    enum chip8_log_level level;
+    int count;
+    int line;
+    uint64_t timestamp;
+    const char* file;
+    const char* format;
+    struct chip8_log_arg args[CHIP8_LOG_MAX_ARGS];
+    /* Copies of the string arguments */
+    char text[CHIP8_LOG_TEXT_SIZE];
+};
+
+/*
+    Bounded multi-producer queue of records drained by the logging thread.
+    Every producer claims a cell with a compare-and-swap on enqueue.
+*/
+struct chip8_log
+{
+    struct chip8_log_record records[CHIP8_LOG_RECORDS];
+    _Atomic unsigned int enqueue;
+    /* Only used by the logging thread */
+    unsigned int dequeue;
+    _Atomic int level;
+    _Atomic bool running;
+    /* Producers between their check of running and the publication of their record */
+    _Atomic unsigned int writers;
+    atomic_bool stop;
+    _Atomic unsigned int dropped;
+    FILE* out;
+    uint64_t origin;
+    uint64_t frequency;
+    SDL_Thread* thread;
+};
+
+static struct chip8_log chip8_log;
+
+static const char* chip8_log_level_names[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+/**
+ * @brief Set the lowest level of the messages that are logged.
+ * 
+ * @param level The lowest level, CHIP8_LOG_LEVEL_NONE disables logging.
+ * @return Void.
+ */
+void chip8_log_set_level(enum chip8_log_level level)
+{
+    atomic_store_explicit(&chip8_log.level, level, memory_order_relaxed);
+}
+
+
+/**
+ * @brief Check whether messages of a level are logged.
+ * 
+ * @param level Level of the message.
+ * @return true The message has to be logged.
+ * @return false The message is filtered out.
+ */
+bool chip8_log_is_enabled(enum chip8_log_level level)
+{
+    return (int) level >= atomic_load_explicit(&chip8_log.level, memory_order_relaxed);
+}
+
+
+/**
+ * @brief Copy a message and its arguments into a record, strings are copied into the record text.
+ * 
+ * @param record Pointer to the record to fill.
+ * @param level Level of the message.
+ * @param file Source file of the message.
+ * @param line Source line of the message.
+ * @param format Format of the message.
+ * @param args Arguments of the message.
+ * @param count Number of arguments.
+ * @return Void.
+ */
+static void chip8_log_fill(struct chip8_log_record* record, enum chip8_log_level level, const char* file, int line, const char* format, const struct chip8_log_arg* args, int count)
+{
+    record->level = level;
+    record->file = file;
+    record->line = line;
+    record->format = format;
+    record->timestamp = SDL_GetPerformanceCounter();
+    record->count = count < CHIP8_LOG_MAX_ARGS ? count : CHIP8_LOG_MAX_ARGS;
+
+    unsigned int used = 0;
+    for (int i = 0 ; i < record->count ; i++)
+    {
+        record->args[i] = args[i];
+        if (args[i].type != CHIP8_LOG_ARG_STRING)
+        {
+            continue;
+        }
+
+        /* Strings may not outlive the call, keep a truncated copy */
+        const char* text = args[i].value.p ? args[i].value.p : "(null)";
+        size_t length = strlen(text);
+        if (length > CHIP8_LOG_TEXT_SIZE - 1 - used)
+        {
+            length = CHIP8_LOG_TEXT_SIZE - 1 - used;
+        }
+        memcpy(&record->text[used], text, length);
+        record->text[used + length] = '\0';
+        record->args[i].value.text = used;
+        used += length + 1;
+        if (used > CHIP8_LOG_TEXT_SIZE - 1)
+        {
+            used = CHIP8_LOG_TEXT_SIZE - 1;
+        }
+    }
+}
+
+
+/**
+ * @brief Format a record and write it on a line.
+ * 
+ * @param out Stream where the line is written.
+ * @param record Pointer to the record to format.
+ * @return Void.
+ */
+static void chip8_log_format(FILE* out, const struct chip8_log_record* record)
+{
+    const char* file = strrchr(record->file, '/');
+    const char* base = strrchr(record->file, '\\');
+    if (base > file)
+    {
+        file = base;
+    }
+    file = file ? file + 1 : record->file;
+
+    double seconds = chip8_log.frequency ? (double) (record->timestamp - chip8_log.origin) / chip8_log.frequency : 0.0;
+    fprintf(out, "%10.6f %-5s %s:%d ", seconds, chip8_log_level_names[record->level], file, record->line);
+
+    /* Format the conversions one at a time with the argument they consume */
+    int arg = 0;
+    const char* p = record->format;
+    while (*p)
+    {
+        if (*p != '%')
+        {
+            fputc(*p++, out);
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            fputc('%', out);
+            p += 2;
+            continue;
+        }
+
+        /* Keep the flags, width and precision, drop the length modifiers */
+        char spec[32];
+        int length = 0;
+        spec[length++] = *p++;
+        while (*p && strchr("-+ #0123456789.", *p) && length < 24)
+        {
+            spec[length++] = *p++;
+        }
+        while (*p && strchr("hlLqjzt", *p))
+        {
+            p++;
+        }
+        char conversion = *p ? *p++ : 's';
+
+        if (arg >= record->count)
+        {
+            fputs("<?>", out);
+            continue;
+        }
+
+        const struct chip8_log_arg* value = &record->args[arg++];
+        switch (value->type)
+        {
+            case CHIP8_LOG_ARG_STRING:
+                spec[length++] = 's';
+                spec[length] = '\0';
+                fprintf(out, spec, &record->text[value->value.text]);
+            break;
+
+            case CHIP8_LOG_ARG_POINTER:
+                spec[length++] = 'p';
+                spec[length] = '\0';
+                fprintf(out, spec, value->value.p);
+            break;
+
+            case CHIP8_LOG_ARG_DOUBLE:
+                spec[length++] = strchr("eEfFgGaA", conversion) ? conversion : 'g';
+                spec[length] = '\0';
+                fprintf(out, spec, value->value.d);
+            break;
+
+            default:
+                if (conversion == 'c')
+                {
+                    /* %c takes an int, there is no long long form */
+                    spec[length++] = 'c';
+                    spec[length] = '\0';
+                    fprintf(out, spec, (int) (value->type == CHIP8_LOG_ARG_UINT ? (long long) value->value.u : value->value.i));
+                    break;
+                }
+                spec[length++] = 'l';
+                spec[length++] = 'l';
+                spec[length++] = strchr("diouxX", conversion) ? conversion : 'd';
+                spec[length] = '\0';
+                if (value->type == CHIP8_LOG_ARG_UINT)
+                {
+                    fprintf(out, spec, value->value.u);
+                }
+                else
+                {
+                    fprintf(out, spec, value->value.i);
+                }
+            break;
+        }
+    }
+    fputc('\n', out);
+}
+
+
+/**
+ * @brief Queue a message for the logging thread, or drop it when the queue is full.
+ * 
+ * @param level Level of the message.
+ * @param file Source file of the message.
+ * @param line Source line of the message.
+ * @param format Format of the message, must be a string literal.
+ * @param args Arguments of the message.
+ * @param count Number of arguments.
+ * @return Void.
+ */
+static void chip8_log_enqueue(enum chip8_log_level level, const char* file, int line, const char* format, const struct chip8_log_arg* args, int count)
+{
+    unsigned int position = atomic_load_explicit(&chip8_log.enqueue, memory_order_relaxed);
+    struct chip8_log_record* record;
+    while (1)
+    {
+        record = &chip8_log.records[position & (CHIP8_LOG_RECORDS - 1)];
+        unsigned int sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+        int difference = (int) (sequence - position);
+        if (difference == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&chip8_log.enqueue, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (difference < 0)
+        {
+            /* The queue is full, never block the caller */
+            atomic_fetch_add_explicit(&chip8_log.dropped, 1, memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            position = atomic_load_explicit(&chip8_log.enqueue, memory_order_relaxed);
+        }
+    }
+
+    chip8_log_fill(record, level, file, line, format, args, count);
+    atomic_store_explicit(&record->sequence, position + 1, memory_order_release);
+}
+
+
+/**
+ * @brief Log a message. Used through the CHIP8_LOG macros.
+ *        When the logging thread is not running the message is written right away to stderr.
+ * 
+ * @param level Level of the message.
+ * @param file Source file of the message.
+ * @param line Source line of the message.
+ * @param format Format of the message, must be a string literal.
+ * @param args Arguments of the message.
+ * @param count Number of arguments.
+ * @return Void.
+ */
+void chip8_log_write(enum chip8_log_level level, const char* file, int line, const char* format, const struct chip8_log_arg* args, int count)
+{
+    /* Counted before running is read, so chip8_log_stop can wait for the record to be published */
+    atomic_fetch_add(&chip8_log.writers, 1);
+    if (atomic_load(&chip8_log.running))
+    {
+        chip8_log_enqueue(level, file, line, format, args, count);
+        atomic_fetch_sub_explicit(&chip8_log.writers, 1, memory_order_release);
+        return;
+    }
+    atomic_fetch_sub_explicit(&chip8_log.writers, 1, memory_order_relaxed);
+
+    /* Messages of several threads would be mixed character by character */
+    static SDL_SpinLock lock;
+    struct chip8_log_record record;
+    chip8_log_fill(&record, level, file, line, format, args, count);
+    SDL_AtomicLock(&lock);
+    chip8_log_format(stderr, &record);
+    SDL_AtomicUnlock(&lock);
+}
+
+
+/**
+ * @brief Format and write the queued records.
+ * 
+ * @return bool Whether any record has been written.
+ */
+static bool chip8_log_drain(void)
+{
+    bool written = false;
+    while (1)
+    {
+        unsigned int position = chip8_log.dequeue;
+        struct chip8_log_record* record = &chip8_log.records[position & (CHIP8_LOG_RECORDS - 1)];
+        if (atomic_load_explicit(&record->sequence, memory_order_acquire) != position + 1)
+        {
+            break;
+        }
+
+        chip8_log_format(chip8_log.out, record);
+        atomic_store_explicit(&record->sequence, position + CHIP8_LOG_RECORDS, memory_order_release);
+        chip8_log.dequeue = position + 1;
+        written = true;
+    }
+
+    if (written)
+    {
+        fflush(chip8_log.out);
+    }
+    return written;
+}
+
+
+/**
+ * @brief Entry point of the logging thread.
+ * 
+ * @param data Unused.
+ * @return int Always 0.
+ */
+static int chip8_log_thread(void* data)
+{
+    (void) data;
+    while (!atomic_load(&chip8_log.stop))
+    {
+        if (!chip8_log_drain())
+        {
+            SDL_Delay(CHIP8_LOG_IDLE_INTERVAL);
+        }
+    }
+    chip8_log_drain();
+    return 0;
+}
+
+
+/**
+ * @brief Start the logging thread, messages are queued from now on.
+ * 
+ * @param out Stream where the messages are written.
+ * @return Void.
+ */
+void chip8_log_start(FILE* out)
+{
+    for (unsigned int i = 0 ; i < CHIP8_LOG_RECORDS ; i++)
+    {
+        atomic_init(&chip8_log.records[i].sequence, i);
+    }
+    atomic_init(&chip8_log.enqueue, 0);
+    chip8_log.dequeue = 0;
+    chip8_log.out = out;
+    chip8_log.origin = SDL_GetPerformanceCounter();
+    chip8_log.frequency = SDL_GetPerformanceFrequency();
+    atomic_store(&chip8_log.stop, false);
+    chip8_log.thread = SDL_CreateThread(chip8_log_thread, "log", NULL);
+    atomic_store_explicit(&chip8_log.running, true, memory_order_release);
+}
+
+
+/**
+ * @brief Write the pending messages and stop the logging thread.
+ *        Messages logged afterwards are written right away.
+ * 
+ * @return Void.
+ */
+void chip8_log_stop(void)
+{
+    if (!atomic_load(&chip8_log.running))
+    {
+        return;
+    }
+
+    atomic_store(&chip8_log.running, false);
+    atomic_store(&chip8_log.stop, true);
+    SDL_WaitThread(chip8_log.thread, NULL);
+
+    /* Threads that saw the logger running may still be filling their record, wait until every one is published */
+    while (atomic_load(&chip8_log.writers) != 0)
+    {
+        SDL_Delay(0);
+    }
+    chip8_log_drain();
+}
+
+
+/**
+ * @brief Get the number of messages lost because the queue was full.
+ * 
+ * @return unsigned int The number of dropped messages.
+ */
+unsigned int chip8_log_dropped(void)
+{
+    return atomic_load(&chip8_log.dropped);
+}
\ No newline at end of file
@@ -1,5 +1,12 @@
 #include "chip8memory.h"
+#include "chip8log.h"
+#include "chip8hash.h"
 #include<assert.h>
+#include <stdlib.h>
+#include <memory.h>
+
+/* Page referenced by untouched memory, it is never written nor freed */
+static struct chip8_memory_page chip8_memory_zero_page;
 
 /**
  * @brief Verifies that the received index is within the memory bounds.
@@ -14,6 +21,136 @@ static void chip8_is_memory_in_bounds(int index)
 
 
 
+/**
+ * @brief Drop a reference to a page, freeing it with the last one.
+ * 
+ * @param page Pointer to the page, NULL is ignored.
+ * @return Void.
+ */
+static void chip8_memory_release(struct chip8_memory_page* page)
+{
+    if (page && page != &chip8_memory_zero_page &&
+        atomic_fetch_sub_explicit(&page->references, 1, memory_order_acq_rel) == 1)
+    {
+        free(page);
+    }
+}
+
+
+
+/**
+ * @brief Make the page holding a byte private to the memory before writing it.
+ *        A page referenced by another instance is copied, the copy replacing it.
+ * 
+ * @param memory Pointer to a chip8_memory struct.
+ * @param index An index of a byte of the page.
+ * @return struct chip8_memory_page* The page, that can now be written.
+ */
+static struct chip8_memory_page* chip8_memory_own(struct chip8_memory* memory, int index)
+{
+    struct chip8_memory_page* page = memory->pages[index / CHIP8_MEMORY_PAGE_SIZE];
+    if (page != &chip8_memory_zero_page && atomic_load_explicit(&page->references, memory_order_acquire) == 1)
+    {
+        return page;
+    }
+
+    struct chip8_memory_page* copy = malloc(sizeof(struct chip8_memory_page));
+    if (!copy)
+    {
+        CHIP8_LOG_ERROR("Failed to allocate a memory page");
+    }
+    assert(copy);
+    atomic_init(&copy->references, 1);
+    memcpy(copy->bytes, page->bytes, CHIP8_MEMORY_PAGE_SIZE);
+
+    memory->pages[index / CHIP8_MEMORY_PAGE_SIZE] = copy;
+    chip8_memory_release(page);
+    return copy;
+}
+
+
+
+/**
+ * @brief Set every byte of the memory to 0, without allocating any page.
+ * 
+ * @param memory Pointer to a chip8_memory struct.
+ * @return Void.
+ */
+void chip8_memory_init(struct chip8_memory* memory)
+{
+    for (int i = 0 ; i < CHIP8_MEMORY_PAGES ; i++)
+    {
+        memory->pages[i] = &chip8_memory_zero_page;
+    }
+    memory->hash = 0;
+}
+
+
+
+/**
+ * @brief Drop the pages of the memory, which must be initialized again before any use.
+ * 
+ * @param memory Pointer to a chip8_memory struct.
+ * @return Void.
+ */
+void chip8_memory_free(struct chip8_memory* memory)
+{
+    for (int i = 0 ; i < CHIP8_MEMORY_PAGES ; i++)
+    {
+        chip8_memory_release(memory->pages[i]);
+        memory->pages[i] = NULL;
+    }
+}
+
+
+
+/**
+ * @brief Make the memory reference the pages of another one, replacing its own.
+ *        Both keep the same content until one of them writes a page, which is then copied.
+ * 
+ * @param memory Pointer to the chip8_memory struct receiving the pages.
+ * @param source Pointer to the chip8_memory struct whose pages are shared.
+ * @return Void.
+ */
+void chip8_memory_share(struct chip8_memory* memory, const struct chip8_memory* source)
+{
+    for (int i = 0 ; i < CHIP8_MEMORY_PAGES ; i++)
+    {
+        struct chip8_memory_page* page = source->pages[i];
+        if (page != &chip8_memory_zero_page)
+        {
+            atomic_fetch_add_explicit(&page->references, 1, memory_order_relaxed);
+        }
+        chip8_memory_release(memory->pages[i]);
+        memory->pages[i] = page;
+    }
+    memory->hash = source->hash;
+}
+
+
+
+/**
+ * @brief Compare two memories, pages shared by both are not read.
+ * 
+ * @param a Pointer to a chip8_memory struct.
+ * @param b Pointer to a chip8_memory struct.
+ * @return bool True if both memories hold the same bytes.
+ */
+bool chip8_memory_equal(const struct chip8_memory* a, const struct chip8_memory* b)
+{
+    for (int i = 0 ; i < CHIP8_MEMORY_PAGES ; i++)
+    {
+        if (a->pages[i] != b->pages[i] &&
+            memcmp(a->pages[i]->bytes, b->pages[i]->bytes, CHIP8_MEMORY_PAGE_SIZE) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+
 /**
  * @brief Store the value in memory at the byte indicated by index.
  * 
@@ -25,7 +162,43 @@ static void chip8_is_memory_in_bounds(int index)
 void chip8_memory_set(struct chip8_memory* memory, int index, unsigned char value)
 {
     chip8_is_memory_in_bounds(index);
-    memory->memory[index] = value;
+    unsigned char* byte = &chip8_memory_own(memory, index)->bytes[index % CHIP8_MEMORY_PAGE_SIZE];
+    memory->hash ^= chip8_hash_key(CHIP8_HASH_MEMORY, index, *byte) ^ chip8_hash_key(CHIP8_HASH_MEMORY, index, value);
+    *byte = value;
+}
+
+
+
+/**
+ * @brief Store a block of bytes in memory starting at the byte indicated by index.
+ * 
+ * @param memory Pointer to a chip8_memory struct.
+ * @param index An index to access the first memory byte.
+ * @param data Address of the bytes to store.
+ * @param size Number of bytes to store.
+ * @return Void.
+ */
+void chip8_memory_copy(struct chip8_memory* memory, int index, const void* data, size_t size)
+{
+    chip8_is_memory_in_bounds(index);
+    assert(index + size <= CHIP8_MEMORY_SIZE);
+
+    const unsigned char* bytes = data;
+    while (size > 0)
+    {
+        size_t offset = index % CHIP8_MEMORY_PAGE_SIZE;
+        size_t length = CHIP8_MEMORY_PAGE_SIZE - offset < size ? CHIP8_MEMORY_PAGE_SIZE - offset : size;
+        unsigned char* destination = &chip8_memory_own(memory, index)->bytes[offset];
+        for (size_t i = 0 ; i < length ; i++)
+        {
+            memory->hash ^= chip8_hash_key(CHIP8_HASH_MEMORY, index + i, destination[i]) ^
+                            chip8_hash_key(CHIP8_HASH_MEMORY, index + i, bytes[i]);
+        }
+        memcpy(destination, bytes, length);
+        index += length;
+        bytes += length;
+        size -= length;
+    }
 }
 
 
@@ -37,10 +210,10 @@ void chip8_memory_set(struct chip8_memory* memory, int index, unsigned char valu
  * @param index An index to indicate the byte of memory from which its value will be returned.
  * @return unsigned char The corresponding value.
  */
-unsigned char chip8_memory_get(struct chip8_memory* memory, int index)
+unsigned char chip8_memory_get(const struct chip8_memory* memory, int index)
 {
     chip8_is_memory_in_bounds(index);
-    return memory->memory[index];
+    return memory->pages[index / CHIP8_MEMORY_PAGE_SIZE]->bytes[index % CHIP8_MEMORY_PAGE_SIZE];
 }
 
 
@@ -52,7 +225,7 @@ unsigned char chip8_memory_get(struct chip8_memory* memory, int index)
  * @param index An index to indicate the two bytes of memory from which its values will be returned
  * @return unsigned short The corresponding values.
  */
-unsigned short chip8_memory_get_short(struct chip8_memory* memory, int index)
+unsigned short chip8_memory_get_short(const struct chip8_memory* memory, int index)
 {
     unsigned char byte1 = chip8_memory_get(memory, index);
     unsigned char byte2 = chip8_memory_get(memory, index + 1);
@@ -0,0 +1,447 @@
+#include "chip8observation.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <memory.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHIP8_OBSERVATION_X86
+#include <immintrin.h>
+#endif
+
+_Static_assert((CHIP8_OBSERVATION_HISTORY & (CHIP8_OBSERVATION_HISTORY - 1)) == 0, "history size must be a power of two");
+_Static_assert(CHIP8_OBSERVATION_HISTORY > CHIP8_OBSERVATION_MAX_STACK, "the history must hold the frame before the deepest stack");
+
+/* Kernels expanding packed words, the most significant bit being the first pixel */
+struct chip8_observation_kernels
+{
+    enum chip8_observation_kernel kind;
+    void (*expand_u8)(const uint64_t* words, int total_words, uint8_t* out);
+    void (*expand_f32)(const uint64_t* words, int total_words, float* out);
+};
+
+
+/**
+ * @brief Expand packed words into one byte per pixel, one pixel at a time.
+ * 
+ * @param words The packed words.
+ * @param total_words Number of words.
+ * @param out Receives 64 bytes per word.
+ * @return Void.
+ */
+static void chip8_observation_expand_u8_scalar(const uint64_t* words, int total_words, uint8_t* out)
+{
+    for (int i = 0 ; i < total_words ; i++)
+    {
+        for (int x = 0 ; x < 64 ; x++)
+        {
+            *out++ = (words[i] >> (63 - x)) & 1;
+        }
+    }
+}
+
+
+/**
+ * @brief Expand packed words into one float per pixel, one pixel at a time.
+ * 
+ * @param words The packed words.
+ * @param total_words Number of words.
+ * @param out Receives 64 floats per word.
+ * @return Void.
+ */
+static void chip8_observation_expand_f32_scalar(const uint64_t* words, int total_words, float* out)
+{
+    for (int i = 0 ; i < total_words ; i++)
+    {
+        for (int x = 0 ; x < 64 ; x++)
+        {
+            *out++ = (float) ((words[i] >> (63 - x)) & 1);
+        }
+    }
+}
+
+
+static const struct chip8_observation_kernels chip8_observation_scalar =
+{
+    CHIP8_OBSERVATION_KERNEL_SCALAR,
+    chip8_observation_expand_u8_scalar,
+    chip8_observation_expand_f32_scalar
+};
+
+
+#ifdef CHIP8_OBSERVATION_X86
+
+/**
+ * @brief Expand packed words into bytes, 16 pixels per vector.
+ *        Each byte of the word is repeated 8 times by unpacking, then tested against its bit.
+ * 
+ * @param words The packed words.
+ * @param total_words Number of words.
+ * @param out Receives 64 bytes per word.
+ * @return Void.
+ */
+__attribute__((target("sse2")))
+static void chip8_observation_expand_u8_sse2(const uint64_t* words, int total_words, uint8_t* out)
+{
+    const __m128i bits = _mm_setr_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+    const __m128i one = _mm_set1_epi8(1);
+
+    for (int i = 0 ; i < total_words ; i++)
+    {
+        /* Leftmost pixels in the first byte */
+        __m128i row = _mm_loadl_epi64((const __m128i*) &(uint64_t) { __builtin_bswap64(words[i]) });
+        __m128i bytes = _mm_unpacklo_epi8(row, row);
+        __m128i low = _mm_unpacklo_epi16(bytes, bytes);
+        __m128i high = _mm_unpackhi_epi16(bytes, bytes);
+        __m128i spread[4] =
+        {
+            _mm_unpacklo_epi32(low, low),
+            _mm_unpackhi_epi32(low, low),
+            _mm_unpacklo_epi32(high, high),
+            _mm_unpackhi_epi32(high, high)
+        };
+        for (int k = 0 ; k < 4 ; k++)
+        {
+            __m128i set = _mm_cmpeq_epi8(_mm_and_si128(spread[k], bits), bits);
+            _mm_storeu_si128((__m128i*) (out + 16 * k), _mm_and_si128(set, one));
+        }
+        out += 64;
+    }
+}
+
+
+/**
+ * @brief Expand packed words into floats, 4 pixels per vector.
+ * 
+ * @param words The packed words.
+ * @param total_words Number of words.
+ * @param out Receives 64 floats per word.
+ * @return Void.
+ */
+__attribute__((target("sse2")))
+static void chip8_observation_expand_f32_sse2(const uint64_t* words, int total_words, float* out)
+{
+    const __m128i high_bits = _mm_setr_epi32(128, 64, 32, 16);
+    const __m128i low_bits = _mm_setr_epi32(8, 4, 2, 1);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (int i = 0 ; i < total_words ; i++)
+    {
+        for (int b = 0 ; b < 8 ; b++)
+        {
+            __m128i byte = _mm_set1_epi32((int) (words[i] >> (56 - 8 * b)) & 0xff);
+            __m128i high = _mm_cmpeq_epi32(_mm_and_si128(byte, high_bits), high_bits);
+            __m128i low = _mm_cmpeq_epi32(_mm_and_si128(byte, low_bits), low_bits);
+            _mm_storeu_ps(out, _mm_and_ps(_mm_castsi128_ps(high), one));
+            _mm_storeu_ps(out + 4, _mm_and_ps(_mm_castsi128_ps(low), one));
+            out += 8;
+        }
+    }
+}
+
+
+/**
+ * @brief Expand packed words into bytes, 32 pixels per vector.
+ *        A shuffle repeats each byte of the word 8 times, then it is tested against its bit.
+ * 
+ * @param words The packed words.
+ * @param total_words Number of words.
+ * @param out Receives 64 bytes per word.
+ * @return Void.
+ */
+__attribute__((target("avx2")))
+static void chip8_observation_expand_u8_avx2(const uint64_t* words, int total_words, uint8_t* out)
+{
+    /* The word is little-endian, its leftmost pixels are in byte 7 */
+    const __m256i left = _mm256_setr_epi8(7, 7, 7, 7, 7, 7, 7, 7, 6, 6, 6, 6, 6, 6, 6, 6,
+                                          5, 5, 5, 5, 5, 5, 5, 5, 4, 4, 4, 4, 4, 4, 4, 4);
+    const __m256i right = _mm256_setr_epi8(3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2,
+                                           1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i bits = _mm256_setr_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1,
+                                          -128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+    const __m256i one = _mm256_set1_epi8(1);
+
+    for (int i = 0 ; i < total_words ; i++)
+    {
+        __m256i row = _mm256_set1_epi64x((long long) words[i]);
+        __m256i first = _mm256_cmpeq_epi8(_mm256_and_si256(_mm256_shuffle_epi8(row, left), bits), bits);
+        __m256i second = _mm256_cmpeq_epi8(_mm256_and_si256(_mm256_shuffle_epi8(row, right), bits), bits);
+        _mm256_storeu_si256((__m256i*) out, _mm256_and_si256(first, one));
+        _mm256_storeu_si256((__m256i*) (out + 32), _mm256_and_si256(second, one));
+        out += 64;
+    }
+}
+
+
+/**
+ * @brief Expand packed words into floats, 8 pixels per vector.
+ * 
+ * @param words The packed words.
+ * @param total_words Number of words.
+ * @param out Receives 64 floats per word.
+ * @return Void.
+ */
+__attribute__((target("avx2")))
+static void chip8_observation_expand_f32_avx2(const uint64_t* words, int total_words, float* out)
+{
+    const __m256i bits = _mm256_setr_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    for (int i = 0 ; i < total_words ; i++)
+    {
+        for (int b = 0 ; b < 8 ; b++)
+        {
+            __m256i byte = _mm256_set1_epi32((int) (words[i] >> (56 - 8 * b)) & 0xff);
+            __m256i set = _mm256_cmpeq_epi32(_mm256_and_si256(byte, bits), bits);
+            _mm256_storeu_ps(out, _mm256_and_ps(_mm256_castsi256_ps(set), one));
+            out += 8;
+        }
+    }
+}
+
+
+static const struct chip8_observation_kernels chip8_observation_sse2 =
+{
+    CHIP8_OBSERVATION_KERNEL_SSE2,
+    chip8_observation_expand_u8_sse2,
+    chip8_observation_expand_f32_sse2
+};
+
+static const struct chip8_observation_kernels chip8_observation_avx2 =
+{
+    CHIP8_OBSERVATION_KERNEL_AVX2,
+    chip8_observation_expand_u8_avx2,
+    chip8_observation_expand_f32_avx2
+};
+
+#endif
+
+
+/* Kernels in use, chosen on first use from the features of the processor */
+static _Atomic(const struct chip8_observation_kernels*) chip8_observation_kernels;
+
+
+/**
+ * @brief Get the kernels in use, choosing the fastest one supported on the first call.
+ * 
+ * @return const struct chip8_observation_kernels* The kernels.
+ */
+static const struct chip8_observation_kernels* chip8_observation_current(void)
+{
+    const struct chip8_observation_kernels* kernels = atomic_load_explicit(&chip8_observation_kernels, memory_order_relaxed);
+    if (!kernels)
+    {
+        chip8_observation_set_kernel(CHIP8_OBSERVATION_KERNEL_AUTO);
+        kernels = atomic_load_explicit(&chip8_observation_kernels, memory_order_relaxed);
+    }
+    return kernels;
+}
+
+
+/**
+ * @brief Choose the kernels used by the conversions.
+ * 
+ * @param kernel The kernel, CHIP8_OBSERVATION_KERNEL_AUTO for the fastest one supported.
+ * @return bool False if the processor does not support the kernel, which is then not changed.
+ */
+bool chip8_observation_set_kernel(enum chip8_observation_kernel kernel)
+{
+    const struct chip8_observation_kernels* kernels = &chip8_observation_scalar;
+#ifdef CHIP8_OBSERVATION_X86
+    __builtin_cpu_init();
+    bool sse2 = __builtin_cpu_supports("sse2");
+    bool avx2 = __builtin_cpu_supports("avx2");
+    if (kernel == CHIP8_OBSERVATION_KERNEL_AUTO)
+    {
+        kernel = avx2 ? CHIP8_OBSERVATION_KERNEL_AVX2 : sse2 ? CHIP8_OBSERVATION_KERNEL_SSE2 : CHIP8_OBSERVATION_KERNEL_SCALAR;
+    }
+    if ((kernel == CHIP8_OBSERVATION_KERNEL_SSE2 && !sse2) || (kernel == CHIP8_OBSERVATION_KERNEL_AVX2 && !avx2))
+    {
+        return false;
+    }
+    if (kernel == CHIP8_OBSERVATION_KERNEL_SSE2)
+    {
+        kernels = &chip8_observation_sse2;
+    }
+    else if (kernel == CHIP8_OBSERVATION_KERNEL_AVX2)
+    {
+        kernels = &chip8_observation_avx2;
+    }
+#else
+    if (kernel == CHIP8_OBSERVATION_KERNEL_SSE2 || kernel == CHIP8_OBSERVATION_KERNEL_AVX2)
+    {
+        return false;
+    }
+#endif
+    atomic_store_explicit(&chip8_observation_kernels, kernels, memory_order_relaxed);
+    return true;
+}
+
+
+/**
+ * @brief Get the kernel used by the conversions.
+ * 
+ * @return enum chip8_observation_kernel The kernel.
+ */
+enum chip8_observation_kernel chip8_observation_get_kernel(void)
+{
+    return chip8_observation_current()->kind;
+}
+
+
+/**
+ * @brief Expand packed words into one byte per pixel (0 or 1).
+ * 
+ * @param words The packed words, the most significant bit is the first pixel.
+ * @param total_words Number of words.
+ * @param out Receives 64 bytes per word.
+ * @return Void.
+ */
+void chip8_observation_expand_u8(const uint64_t* words, int total_words, uint8_t* out)
+{
+    chip8_observation_current()->expand_u8(words, total_words, out);
+}
+
+
+/**
+ * @brief Expand packed words into one float per pixel (0.0 or 1.0).
+ * 
+ * @param words The packed words, the most significant bit is the first pixel.
+ * @param total_words Number of words.
+ * @param out Receives 64 floats per word.
+ * @return Void.
+ */
+void chip8_observation_expand_f32(const uint64_t* words, int total_words, float* out)
+{
+    chip8_observation_current()->expand_f32(words, total_words, out);
+}
+
+
+/**
+ * @brief Fill the whole history with a screen, at the start of an episode.
+ * 
+ * @param history Pointer to a chip8_observation_history struct.
+ * @param screen Pointer to the first screen.
+ * @return Void.
+ */
+void chip8_observation_reset(struct chip8_observation_history* history, const struct chip8_screen* screen)
+{
+    for (int i = 0 ; i < CHIP8_OBSERVATION_HISTORY ; i++)
+    {
+        memcpy(history->frames[i], screen->pixels, sizeof(screen->pixels));
+    }
+    history->head = 0;
+}
+
+
+/**
+ * @brief Add a screen to the history, the oldest frame is dropped.
+ * 
+ * @param history Pointer to a chip8_observation_history struct.
+ * @param screen Pointer to the new screen.
+ * @return Void.
+ */
+void chip8_observation_push(struct chip8_observation_history* history, const struct chip8_screen* screen)
+{
+    history->head = (history->head + 1) & (CHIP8_OBSERVATION_HISTORY - 1);
+    memcpy(history->frames[history->head], screen->pixels, sizeof(screen->pixels));
+}
+
+
+/**
+ * @brief Get the number of pixels of one frame of an observation.
+ * 
+ * @param config Pointer to the observation configuration.
+ * @return int Number of pixels.
+ */
+static int chip8_observation_pixels(const struct chip8_observation_config* config)
+{
+    return config->downsample ? (CHIP8_WIDTH / 2) * (CHIP8_HEIGHT / 2) : CHIP8_WIDTH * CHIP8_HEIGHT;
+}
+
+
+/**
+ * @brief Get the size of the observation of one instance.
+ * 
+ * @param config Pointer to the observation configuration.
+ * @return size_t Size in bytes.
+ */
+size_t chip8_observation_size(const struct chip8_observation_config* config)
+{
+    size_t pixel = config->format == CHIP8_OBSERVATION_U8 ? sizeof(uint8_t) : sizeof(float);
+    return (size_t) config->stack * chip8_observation_pixels(config) * pixel;
+}
+
+
+/**
+ * @brief Halve a packed row, each pixel being set if either pixel of its pair is.
+ * 
+ * @param row The packed row.
+ * @return uint64_t The 32 pixels in the low half of the word, the first one in bit 31.
+ */
+static uint64_t chip8_observation_halve(uint64_t row)
+{
+    uint64_t x = (row | (row >> 1)) & 0x5555555555555555ULL;
+    x = (x | (x >> 1)) & 0x3333333333333333ULL;
+    x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x >> 4)) & 0x00ff00ff00ff00ffULL;
+    x = (x | (x >> 8)) & 0x0000ffff0000ffffULL;
+    x = (x | (x >> 16)) & 0x00000000ffffffffULL;
+    return x;
+}
+
+
+/**
+ * @brief Write the observations of a batch of instances into one contiguous buffer.
+ * 
+ * @param config Pointer to the observation configuration.
+ * @param histories The history of every instance.
+ * @param count Number of instances.
+ * @param out Receives count * chip8_observation_size(config) bytes.
+ * @return Void.
+ */
+void chip8_observation_write(const struct chip8_observation_config* config,
+                             const struct chip8_observation_history* histories, int count, void* out)
+{
+    assert(config->stack >= 1 && config->stack <= CHIP8_OBSERVATION_MAX_STACK);
+    const struct chip8_observation_kernels* kernels = chip8_observation_current();
+    size_t frame_size = chip8_observation_size(config) / config->stack;
+    unsigned char* destination = out;
+
+    for (int i = 0 ; i < count ; i++)
+    {
+        const struct chip8_observation_history* history = &histories[i];
+        for (int k = 0 ; k < config->stack ; k++)
+        {
+            const uint64_t* frame = history->frames[(history->head - k) & (CHIP8_OBSERVATION_HISTORY - 1)];
+            const uint64_t* previous = history->frames[(history->head - k - 1) & (CHIP8_OBSERVATION_HISTORY - 1)];
+
+            uint64_t words[CHIP8_HEIGHT];
+            int total_words = CHIP8_HEIGHT;
+            for (int y = 0 ; y < CHIP8_HEIGHT ; y++)
+            {
+                words[y] = config->max_pool ? frame[y] | previous[y] : frame[y];
+            }
+            if (config->downsample)
+            {
+                /* Two halved rows per word, so the words still expand to contiguous rows */
+                total_words = CHIP8_HEIGHT / 4;
+                for (int w = 0 ; w < total_words ; w++)
+                {
+                    uint64_t top = chip8_observation_halve(words[4 * w] | words[4 * w + 1]);
+                    uint64_t bottom = chip8_observation_halve(words[4 * w + 2] | words[4 * w + 3]);
+                    words[w] = top << 32 | bottom;
+                }
+            }
+
+            if (config->format == CHIP8_OBSERVATION_U8)
+            {
+                kernels->expand_u8(words, total_words, destination);
+            }
+            else
+            {
+                kernels->expand_f32(words, total_words, (float*) destination);
+            }
+            destination += frame_size;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "chip8profile.h"
+#include "chip8log.h"
+#include <assert.h>
+#include <stdio.h>
+#include <SDL2/SDL_timer.h>
+
+/**
+ * @brief Initialize the profiler, with empty tracks.
+ * 
+ * @param profile Pointer to a chip8_profile struct.
+ * @param enabled Whether events are recorded, a disabled profiler costs one test per event.
+ * @return Void.
+ */
+void chip8_profile_init(struct chip8_profile* profile, bool enabled)
+{
+    profile->enabled = enabled;
+    profile->frequency = SDL_GetPerformanceFrequency();
+    profile->origin = SDL_GetPerformanceCounter();
+    for (int i = 0 ; i < CHIP8_PROFILE_TRACKS ; i++)
+    {
+        profile->tracks[i].name = NULL;
+        profile->tracks[i].count = 0;
+        profile->tracks[i].dropped = 0;
+    }
+}
+
+
+/**
+ * @brief Claim the track where a thread records its events.
+ * 
+ * @param profile Pointer to a chip8_profile struct.
+ * @param index Index of the track, every thread must use its own.
+ * @param name Name of the thread shown in the trace viewer.
+ * @return struct chip8_profile_track* The track of the thread.
+ */
+struct chip8_profile_track* chip8_profile_track(struct chip8_profile* profile, int index, const char* name)
+{
+    assert(index >= 0 && index < CHIP8_PROFILE_TRACKS);
+    profile->tracks[index].name = name;
+    return &profile->tracks[index];
+}
+
+
+/**
+ * @brief Get the start time of a span.
+ * 
+ * @param profile Pointer to a chip8_profile struct.
+ * @return uint64_t The current time, or 0 when the profiler is disabled.
+ */
+uint64_t chip8_profile_begin(struct chip8_profile* profile)
+{
+    return profile->enabled ? SDL_GetPerformanceCounter() : 0;
+}
+
+
+/**
+ * @brief Reserve the next event of a track.
+ * 
+ * @param track Pointer to a chip8_profile_track struct.
+ * @return struct chip8_profile_event* The event to fill, NULL when the track is full.
+ */
+static struct chip8_profile_event* chip8_profile_next(struct chip8_profile_track* track)
+{
+    if (track->count == CHIP8_PROFILE_EVENTS)
+    {
+        track->dropped += 1;
+        return NULL;
+    }
+    return &track->events[track->count++];
+}
+
+
+/**
+ * @brief Record a span that started at chip8_profile_begin() and ends now.
+ * 
+ * @param profile Pointer to a chip8_profile struct.
+ * @param track Pointer to the track of the calling thread.
+ * @param name Name of the phase, must be a string literal.
+ * @param start Value returned by chip8_profile_begin().
+ * @return Void.
+ */
+void chip8_profile_end(struct chip8_profile* profile, struct chip8_profile_track* track, const char* name, uint64_t start)
+{
+    if (!profile->enabled)
+    {
+        return;
+    }
+
+    struct chip8_profile_event* event = chip8_profile_next(track);
+    if (event)
+    {
+        event->name = name;
+        event->start = start;
+        event->value = SDL_GetPerformanceCounter();
+        event->type = CHIP8_PROFILE_SPAN;
+    }
+}
+
+
+/**
+ * @brief Record the value of a counter at the current time.
+ * 
+ * @param profile Pointer to a chip8_profile struct.
+ * @param track Pointer to the track of the calling thread.
+ * @param name Name of the counter, must be a string literal.
+ * @param value Value of the counter.
+ * @return Void.
+ */
+void chip8_profile_counter(struct chip8_profile* profile, struct chip8_profile_track* track, const char* name, uint64_t value)
+{
+    if (!profile->enabled)
+    {
+        return;
+    }
+
+    struct chip8_profile_event* event = chip8_profile_next(track);
+    if (event)
+    {
+        event->name = name;
+        event->start = SDL_GetPerformanceCounter();
+        event->value = value;
+        event->type = CHIP8_PROFILE_COUNTER;
+    }
+}
+
+
+/**
+ * @brief Convert a timestamp to microseconds since the profiler was initialized.
+ * 
+ * @param profile Pointer to a chip8_profile struct.
+ * @param time Performance counter value.
+ * @return double The time in microseconds.
+ */
+static double chip8_profile_us(struct chip8_profile* profile, uint64_t time)
+{
+    return (double) (time - profile->origin) * 1000000.0 / profile->frequency;
+}
+
+
+/**
+ * @brief Write the recorded events as Chrome trace-event JSON,
+ *        to be opened with chrome://tracing or ui.perfetto.dev.
+ *        Must be called once the threads have stopped recording.
+ * 
+ * @param profile Pointer to a chip8_profile struct.
+ * @param filename Path of the JSON file to create.
+ * @return true The file has been written.
+ * @return false The file could not be created.
+ */
+bool chip8_profile_write(struct chip8_profile* profile, const char* filename)
+{
+    FILE* f = fopen(filename, "w");
+    if (!f)
+    {
+        return false;
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"chip8\"}}");
+
+    for (int tid = 0 ; tid < CHIP8_PROFILE_TRACKS ; tid++)
+    {
+        struct chip8_profile_track* track = &profile->tracks[tid];
+        if (!track->name)
+        {
+            continue;
+        }
+
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", tid, track->name);
+        for (unsigned int i = 0 ; i < track->count ; i++)
+        {
+            struct chip8_profile_event* event = &track->events[i];
+            if (event->type == CHIP8_PROFILE_SPAN)
+            {
+                fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        event->name, tid,
+                        chip8_profile_us(profile, event->start),
+                        chip8_profile_us(profile, event->value) - chip8_profile_us(profile, event->start));
+            }
+            else
+            {
+                fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%llu}}",
+                        event->name, tid,
+                        chip8_profile_us(profile, event->start),
+                        (unsigned long long) event->value);
+            }
+        }
+
+        if (track->dropped > 0)
+        {
+            CHIP8_LOG_WARNING("Profile track %s dropped %u events", track->name, track->dropped);
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "chip8render.h"
+#include <assert.h>
+#include <memory.h>
+#include <stdatomic.h>
+#include "chip8observation.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHIP8_RENDER_X86
+#include <immintrin.h>
+#endif
+
+/* Pixels written past the end of a line by the vector stores */
+#define CHIP8_RENDER_LINE_SLACK 4
+
+
+/**
+ * @brief Expand the pixels of one row into a scaled line, one pixel at a time.
+ * 
+ * @param set The pixels of the row, one byte each, 0 or 1.
+ * @param colors The color of the pixels that are off and on.
+ * @param scale Width of each pixel in the line.
+ * @param line Receives CHIP8_WIDTH * scale pixels.
+ * @return Void.
+ */
+static void chip8_render_line_scalar(const uint8_t* set, const uint32_t* colors, int scale, uint32_t* line)
+{
+    for (int x = 0 ; x < CHIP8_WIDTH ; x++)
+    {
+        uint32_t color = colors[set[x]];
+        for (int i = 0 ; i < scale ; i++)
+        {
+            *line++ = color;
+        }
+    }
+}
+
+
+#ifdef CHIP8_RENDER_X86
+
+/**
+ * @brief Expand the pixels of one row into a scaled line, 4 pixels per store.
+ *        The color is broadcast to a vector and every span is written with whole vectors,
+ *        the last one spilling into the next span, which overwrites it.
+ * 
+ * @param set The pixels of the row, one byte each, 0 or 1.
+ * @param colors The color of the pixels that are off and on.
+ * @param scale Width of each pixel in the line.
+ * @param line Receives CHIP8_WIDTH * scale pixels, with CHIP8_RENDER_LINE_SLACK more that may be written.
+ * @return Void.
+ */
+__attribute__((target("sse2")))
+static void chip8_render_line_sse2(const uint8_t* set, const uint32_t* colors, int scale, uint32_t* line)
+{
+    const __m128i vectors[2] = { _mm_set1_epi32((int) colors[0]), _mm_set1_epi32((int) colors[1]) };
+
+    for (int x = 0 ; x < CHIP8_WIDTH ; x++)
+    {
+        __m128i color = vectors[set[x]];
+        for (int i = 0 ; i < scale ; i += 4)
+        {
+            _mm_storeu_si128((__m128i*) (line + i), color);
+        }
+        line += scale;
+    }
+}
+
+#endif
+
+
+/* Line kernel chosen by the first render, NULL until then */
+static _Atomic(void (*)(const uint8_t*, const uint32_t*, int, uint32_t*)) chip8_render_line;
+
+
+/**
+ * @brief Get the line kernel, checking the processor only the first time.
+ * 
+ * @return The SSE2 kernel when the processor supports it, the scalar one otherwise.
+ */
+static void (*chip8_render_line_kernel(void))(const uint8_t*, const uint32_t*, int, uint32_t*)
+{
+    void (*expand)(const uint8_t*, const uint32_t*, int, uint32_t*) = atomic_load_explicit(&chip8_render_line, memory_order_relaxed);
+    if (expand)
+    {
+        return expand;
+    }
+
+    expand = chip8_render_line_scalar;
+#ifdef CHIP8_RENDER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+    {
+        expand = chip8_render_line_sse2;
+    }
+#endif
+    atomic_store_explicit(&chip8_render_line, expand, memory_order_relaxed);
+    return expand;
+}
+
+
+/**
+ * @brief Render a screen into 32-bit pixels, each screen pixel becoming a square of scale pixels.
+ *        The pixels are expanded to bytes by the observation kernels, then to lines by vector
+ *        stores when the processor supports SSE2.
+ * 
+ * @param screen Pointer to the chip8_screen struct to render.
+ * @param pixels The first pixel of the destination, which is CHIP8_WIDTH * scale by CHIP8_HEIGHT * scale.
+ * @param pitch Bytes between the starts of two lines of the destination.
+ * @param scale Size of a screen pixel, from 1 to CHIP8_MAX_WINDOW_SCALE.
+ * @param on Color of the pixels that are set.
+ * @param off Color of the other pixels.
+ * @return Void.
+ */
+void chip8_render_argb(const struct chip8_screen* screen, uint32_t* pixels, int pitch, int scale, uint32_t on, uint32_t off)
+{
+    assert( scale >= 1 && scale <= CHIP8_MAX_WINDOW_SCALE );
+
+    uint8_t set[CHIP8_HEIGHT * CHIP8_WIDTH];
+    chip8_observation_expand_u8(screen->pixels, CHIP8_HEIGHT, set);
+
+    void (*expand)(const uint8_t*, const uint32_t*, int, uint32_t*) = chip8_render_line_kernel();
+
+    const uint32_t colors[2] = { off, on };
+    uint32_t line[CHIP8_WIDTH * CHIP8_MAX_WINDOW_SCALE + CHIP8_RENDER_LINE_SLACK];
+    size_t size = CHIP8_WIDTH * scale * sizeof(uint32_t);
+    unsigned char* out = (unsigned char*) pixels;
+    for (int y = 0 ; y < CHIP8_HEIGHT ; y++)
+    {
+        expand(&set[y * CHIP8_WIDTH], colors, scale, line);
+        for (int i = 0 ; i < scale ; i++)
+        {
+            memcpy(out, line, size);
+            out += pitch;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "chip8rompack.h"
+#include "chip8.h"
+#include "chip8log.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Compute the 64-bit FNV-1a hash of a ROM image.
+ * 
+ * @param data The ROM image.
+ * @param size Size of the ROM image.
+ * @return uint64_t The hash.
+ */
+uint64_t chip8_rom_hash(const unsigned char* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0 ; i < size ; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+
+/**
+ * @brief Fill the metadata of an index entry from the ROM image.
+ *        The CHIP8_ROM_USES_* flags come from a linear sweep of the image, so data bytes may be counted as instructions.
+ * 
+ * @param entry Pointer to the entry to fill, its name and quirk profile are left untouched.
+ * @param data The ROM image.
+ * @param size Size of the ROM image.
+ * @return Void.
+ */
+void chip8_rom_analyze(struct chip8_rompack_entry* entry, const unsigned char* data, size_t size)
+{
+    entry->hash = chip8_rom_hash(data, size);
+    entry->size = size;
+    entry->uses = 0;
+    entry->entry_opcode = size >= 2 ? data[0] << 8 | data[1] : 0;
+    entry->entry_target = CHIP8_PROGRAM_LOAD_ADDRESS;
+    if ((entry->entry_opcode & 0xf000) == 0x1000)
+    {
+        entry->entry_target = entry->entry_opcode & 0x0fff;
+    }
+
+    for (size_t i = 0 ; i + 1 < size ; i += 2)
+    {
+        unsigned short opcode = data[i] << 8 | data[i + 1];
+        switch (chip8_isa_decode(opcode))
+        {
+            case CHIP8_OP_OR: case CHIP8_OP_AND: case CHIP8_OP_XOR:
+                entry->uses |= CHIP8_ROM_USES_LOGIC;
+            break;
+
+            case CHIP8_OP_SHR: case CHIP8_OP_SHL:
+                entry->uses |= CHIP8_ROM_USES_SHIFT;
+            break;
+
+            case CHIP8_OP_JP_V0:
+                entry->uses |= CHIP8_ROM_USES_JUMP_OFFSET;
+            break;
+
+            case CHIP8_OP_LD_VX_K:
+                entry->uses |= CHIP8_ROM_USES_WAIT_KEY;
+            break;
+
+            case CHIP8_OP_LD_B:
+                entry->uses |= CHIP8_ROM_USES_BCD;
+            break;
+
+            case CHIP8_OP_LD_MEM_VX: case CHIP8_OP_LD_VX_MEM:
+                entry->uses |= CHIP8_ROM_USES_LOAD_STORE;
+            break;
+
+            default:
+            break;
+        }
+    }
+}
+
+
+/**
+ * @brief Map a file in memory, read-only.
+ * 
+ * @param pack Pointer to the chip8_rompack struct receiving the mapping.
+ * @param filename Path of the file.
+ * @return true The file has been mapped.
+ * @return false The file could not be opened or mapped.
+ */
+static bool chip8_rompack_map(struct chip8_rompack* pack, const char* filename)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+    {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    CloseHandle(file);
+    if (!mapping)
+    {
+        return false;
+    }
+
+    pack->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!pack->data)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+    pack->size = size.QuadPart;
+    pack->mapping = mapping;
+    return true;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    pack->data = data;
+    pack->size = st.st_size;
+    pack->mapping = NULL;
+    return true;
+#endif
+}
+
+
+/**
+ * @brief Remove the mapping of the pack.
+ * 
+ * @param pack Pointer to a mapped chip8_rompack struct.
+ * @return Void.
+ */
+static void chip8_rompack_unmap(struct chip8_rompack* pack)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(pack->data);
+    CloseHandle(pack->mapping);
+#else
+    munmap((void*) pack->data, pack->size);
+#endif
+    pack->data = NULL;
+    pack->size = 0;
+}
+
+
+/**
+ * @brief Map a ROM pack and check its index.
+ * 
+ * @param pack Pointer to the chip8_rompack struct to fill.
+ * @param filename Path of the pack.
+ * @return true The pack is ready to be used.
+ * @return false The pack could not be mapped or is not valid.
+ */
+bool chip8_rompack_open(struct chip8_rompack* pack, const char* filename)
+{
+    if (!chip8_rompack_map(pack, filename))
+    {
+        CHIP8_LOG_ERROR("Failed to map the ROM pack %s", filename);
+        return false;
+    }
+
+    pack->header = (const struct chip8_rompack_header*) pack->data;
+    pack->entries = (const struct chip8_rompack_entry*) (pack->header + 1);
+
+    bool valid = pack->size >= sizeof(struct chip8_rompack_header)
+        && pack->header->magic == CHIP8_ROMPACK_MAGIC
+        && pack->header->version == CHIP8_ROMPACK_VERSION
+        && pack->header->count <= (pack->size - sizeof(struct chip8_rompack_header)) / sizeof(struct chip8_rompack_entry);
+
+    for (uint32_t i = 0 ; valid && i < pack->header->count ; i++)
+    {
+        const struct chip8_rompack_entry* entry = &pack->entries[i];
+        valid = entry->offset <= pack->size
+            && entry->size <= pack->size - entry->offset
+            && CHIP8_PROGRAM_LOAD_ADDRESS + entry->size < CHIP8_MEMORY_SIZE
+            && entry->quirks < CHIP8_QUIRK_PROFILES
+            && memchr(entry->name, '\0', CHIP8_ROMPACK_NAME_SIZE) != NULL;
+    }
+
+    if (!valid)
+    {
+        CHIP8_LOG_ERROR("%s is not a valid ROM pack", filename);
+        chip8_rompack_unmap(pack);
+        return false;
+    }
+
+    CHIP8_LOG_INFO("Mapped ROM pack %s with %u ROMs", filename, pack->header->count);
+    return true;
+}
+
+
+/**
+ * @brief Unmap a ROM pack, the entries and images it returned become invalid.
+ * 
+ * @param pack Pointer to a chip8_rompack struct.
+ * @return Void.
+ */
+void chip8_rompack_close(struct chip8_rompack* pack)
+{
+    if (pack->data)
+    {
+        chip8_rompack_unmap(pack);
+    }
+}
+
+
+/**
+ * @brief Look for a ROM by name with a binary search of the index.
+ * 
+ * @param pack Pointer to a chip8_rompack struct.
+ * @param name Name of the ROM.
+ * @return const struct chip8_rompack_entry* The entry of the ROM, NULL if there is no such ROM.
+ */
+const struct chip8_rompack_entry* chip8_rompack_find(const struct chip8_rompack* pack, const char* name)
+{
+    uint32_t low = 0;
+    uint32_t high = pack->header->count;
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        int order = strcmp(name, pack->entries[middle].name);
+        if (order == 0)
+        {
+            return &pack->entries[middle];
+        }
+        if (order < 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * @brief Get the image of a ROM inside the mapping.
+ * 
+ * @param pack Pointer to a chip8_rompack struct.
+ * @param entry Pointer to the entry of the ROM.
+ * @return const unsigned char* The ROM image.
+ */
+const unsigned char* chip8_rompack_data(const struct chip8_rompack* pack, const struct chip8_rompack_entry* entry)
+{
+    return pack->data + entry->offset;
+}
+
+
+/**
+ * @brief Load a ROM into an instance, copying it once from the mapping, with the quirk profile of its entry.
+ * 
+ * @param pack Pointer to a chip8_rompack struct.
+ * @param entry Pointer to the entry of the ROM.
+ * @param chip8 Pointer to an initialized chip8 struct.
+ * @return Void.
+ */
+void chip8_rompack_load(const struct chip8_rompack* pack, const struct chip8_rompack_entry* entry, struct chip8* chip8)
+{
+    chip8_set_quirks(chip8, entry->quirks);
+    chip8_load(chip8, (const char*) chip8_rompack_data(pack, entry), entry->size);
+}
\ No newline at end of file
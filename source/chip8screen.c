@@ -1,10 +1,16 @@
 #include "chip8screen.h"
 #include <assert.h>
 #include <memory.h>
+#include "chip8hash.h"
+
+/* The packed rows rely on the screen being exactly one 64-bit word wide */
+_Static_assert(CHIP8_WIDTH == 64, "chip8_screen rows are packed in 64-bit words");
 
 void chip8_screen_clear(struct chip8_screen* screen)
 {
     memset(screen->pixels, 0, sizeof(screen->pixels));
+    screen->version += 1;
+    screen->hash = 0;
 }
 
 /**
@@ -20,6 +26,35 @@ static void chip8_screen_in_bounds(int x, int y)
 }
 
 
+/**
+ * @brief Get the bit of a packed row that holds the pixel at x.
+ * 
+ * @param x The x-axis pixel position.
+ * @return uint64_t Mask with only the pixel bit set.
+ */
+static uint64_t chip8_screen_pixel_mask(int x)
+{
+    return 0x8000000000000000ULL >> x;
+}
+
+
+/**
+ * @brief XOR a mask into a packed row, keeping the screen hash up to date.
+ * 
+ * @param screen Pointer to a chip8_screen struct.
+ * @param y The row, already wrapped to the screen height.
+ * @param mask The pixels to flip.
+ * @return uint64_t The pixels of the mask that were set before the flip.
+ */
+static uint64_t chip8_screen_flip(struct chip8_screen* screen, int y, uint64_t mask)
+{
+    uint64_t pixels = screen->pixels[y];
+    screen->pixels[y] = pixels ^ mask;
+    screen->hash ^= chip8_hash_key(CHIP8_HASH_SCREEN, y, pixels) ^ chip8_hash_key(CHIP8_HASH_SCREEN, y, pixels ^ mask);
+    return pixels & mask;
+}
+
+
 /**
  * @brief Set the corresponding pixel on the screen.
  * 
@@ -31,7 +66,8 @@ static void chip8_screen_in_bounds(int x, int y)
 void chip8_screen_set(struct chip8_screen* screen, int x, int y)
 {
     chip8_screen_in_bounds(x, y);
-    screen->pixels[y][x] = true;
+    chip8_screen_flip(screen, y, ~screen->pixels[y] & chip8_screen_pixel_mask(x));
+    screen->version += 1;
 }
 
 
@@ -44,45 +80,182 @@ void chip8_screen_set(struct chip8_screen* screen, int x, int y)
  * @return true The pixel is set.
  * @return false The pixel is not set.
  */
-bool chip8_screen_is_set(struct chip8_screen* screen, int x, int y)
+bool chip8_screen_is_set(const struct chip8_screen* screen, int x, int y)
 {
     chip8_screen_in_bounds(x, y);
-    return screen->pixels[y][x];
+    return (screen->pixels[y] & chip8_screen_pixel_mask(x)) != 0;
+}
+
+
+/**
+ * @brief Expand one sprite byte into a packed screen row placed at x.
+ *        Pixels beyond the right edge wrap around to the left edge.
+ * 
+ * @param byte The sprite byte, the most significant bit is the leftmost pixel.
+ * @param x The x-axis pixel position (any value, it is wrapped to the screen width).
+ * @return uint64_t The packed row mask.
+ */
+uint64_t chip8_screen_sprite_row(unsigned char byte, int x)
+{
+    uint64_t row = (uint64_t) byte << 56;
+    x %= CHIP8_WIDTH;
+    if (x == 0)
+    {
+        return row;
+    }
+    return (row >> x) | (row << (CHIP8_WIDTH - x));
+}
+
+
+/**
+ * @brief Get the rows of a sprite that are drawn, clipped sprites lose the ones below the bottom edge.
+ * 
+ * @param y The y-axis pixel position (any value, it is wrapped to the screen height).
+ * @param length The length of the sprite (in pixels).
+ * @param clip Clip the sprite instead of wrapping it around, a constant in every caller.
+ * @return int The number of rows to draw.
+ */
+static inline __attribute__((always_inline)) int chip8_screen_visible_rows(int y, int length, const bool clip)
+{
+    int below = CHIP8_HEIGHT - y % CHIP8_HEIGHT;
+    return clip && length > below ? below : length;
+}
+
+
+/**
+ * @brief Get the pixels of the rows of a sprite that are drawn, clipped sprites lose the ones
+ *        that wrapped around from the right edge.
+ * 
+ * @param x The x-axis pixel position (any value, it is wrapped to the screen width).
+ * @param clip Clip the sprite instead of wrapping it around, a constant in every caller.
+ * @return uint64_t Mask of the pixels to draw.
+ */
+static inline __attribute__((always_inline)) uint64_t chip8_screen_visible_mask(int x, const bool clip)
+{
+    return clip ? ~0ULL >> (x % CHIP8_WIDTH) : ~0ULL;
 }
 
 
 /**
  * @brief Draw a sprite on the screen at the specified pixel.
+ *        Always inlined into the wrapping and the clipping entry points, where clip is a constant.
  * 
  * @param screen Pointer to a chip8_screen struct.
  * @param x The x-axis pixel position.
  * @param y The y-axis pixel position.
  * @param sprite Memory address of the first byte of the sprite to draw.
  * @param size The length of the sprite (in pixels).
+ * @param clip Clip the sprite at the edges of the screen instead of wrapping it around.
  * @return true There has been a pixel collision.
  * @return false No pixel collision.
  */
-bool chip8_screen_draw_sprite(struct chip8_screen* screen, int x, int y, const char* sprite, int length)
+static inline __attribute__((always_inline)) bool chip8_screen_draw_sprite_profile(struct chip8_screen* screen, int x, int y, const char* sprite, int length, const bool clip)
 {
-    bool pixel_collision = false;
+    uint64_t collision = 0;
+    uint64_t mask = chip8_screen_visible_mask(x, clip);
+    int rows = chip8_screen_visible_rows(y, length, clip);
 
-    for (int ly = 0 ; ly < length ; ly++)
+    for (int ly = 0 ; ly < rows ; ly++)
     {
-        char c = sprite[ly];
-        for (int lx = 0 ; lx < 8 ; lx++)
-        {
-            if ( (c & (0x80 >> lx)) == 0)
-            {
-                continue;
-            }
-
-            if (screen->pixels[(y + ly) % CHIP8_HEIGHT][(x + lx) % CHIP8_WIDTH])
-            {
-                pixel_collision = true;
-            }
-
-            screen->pixels[(y + ly) % CHIP8_HEIGHT][(x + lx) % CHIP8_WIDTH] ^= true;
-        }
+        uint64_t row = chip8_screen_sprite_row(sprite[ly], x) & mask;
+        collision |= chip8_screen_flip(screen, (y + ly) % CHIP8_HEIGHT, row);
     }
-    return pixel_collision;
+    screen->version += 1;
+    return collision != 0;
+}
+
+
+/**
+ * @brief Draw a sprite that has already been expanded into packed rows.
+ *        Always inlined into the wrapping and the clipping entry points, where clip is a constant.
+ * 
+ * @param screen Pointer to a chip8_screen struct.
+ * @param x The x-axis pixel position the rows have been shifted to.
+ * @param y The y-axis pixel position.
+ * @param rows The packed rows of the sprite, already shifted to their x position.
+ * @param size The length of the sprite (in pixels).
+ * @param clip Clip the sprite at the edges of the screen instead of wrapping it around.
+ * @return true There has been a pixel collision.
+ * @return false No pixel collision.
+ */
+static inline __attribute__((always_inline)) bool chip8_screen_draw_rows_profile(struct chip8_screen* screen, int x, int y, const uint64_t* rows, int length, const bool clip)
+{
+    uint64_t collision = 0;
+    uint64_t mask = chip8_screen_visible_mask(x, clip);
+    int visible = chip8_screen_visible_rows(y, length, clip);
+
+    for (int ly = 0 ; ly < visible ; ly++)
+    {
+        collision |= chip8_screen_flip(screen, (y + ly) % CHIP8_HEIGHT, rows[ly] & mask);
+    }
+    screen->version += 1;
+    return collision != 0;
+}
+
+
+/**
+ * @brief Draw a sprite on the screen at the specified pixel, wrapping it around the edges.
+ * 
+ * @param screen Pointer to a chip8_screen struct.
+ * @param x The x-axis pixel position.
+ * @param y The y-axis pixel position.
+ * @param sprite Memory address of the first byte of the sprite to draw.
+ * @param size The length of the sprite (in pixels).
+ * @return true There has been a pixel collision.
+ * @return false No pixel collision.
+ */
+bool chip8_screen_draw_sprite(struct chip8_screen* screen, int x, int y, const char* sprite, int length)
+{
+    return chip8_screen_draw_sprite_profile(screen, x, y, sprite, length, false);
+}
+
+
+/**
+ * @brief Draw a sprite on the screen at the specified pixel, clipping it at the edges.
+ * 
+ * @param screen Pointer to a chip8_screen struct.
+ * @param x The x-axis pixel position.
+ * @param y The y-axis pixel position.
+ * @param sprite Memory address of the first byte of the sprite to draw.
+ * @param size The length of the sprite (in pixels).
+ * @return true There has been a pixel collision.
+ * @return false No pixel collision.
+ */
+bool chip8_screen_draw_sprite_clipped(struct chip8_screen* screen, int x, int y, const char* sprite, int length)
+{
+    return chip8_screen_draw_sprite_profile(screen, x, y, sprite, length, true);
+}
+
+
+/**
+ * @brief Draw a sprite that has already been expanded into packed rows, wrapping it around the edges.
+ * 
+ * @param screen Pointer to a chip8_screen struct.
+ * @param x The x-axis pixel position the rows have been shifted to.
+ * @param y The y-axis pixel position.
+ * @param rows The packed rows of the sprite, already shifted to their x position.
+ * @param size The length of the sprite (in pixels).
+ * @return true There has been a pixel collision.
+ * @return false No pixel collision.
+ */
+bool chip8_screen_draw_rows(struct chip8_screen* screen, int x, int y, const uint64_t* rows, int length)
+{
+    return chip8_screen_draw_rows_profile(screen, x, y, rows, length, false);
+}
+
+
+/**
+ * @brief Draw a sprite that has already been expanded into packed rows, clipping it at the edges.
+ * 
+ * @param screen Pointer to a chip8_screen struct.
+ * @param x The x-axis pixel position the rows have been shifted to.
+ * @param y The y-axis pixel position.
+ * @param rows The packed rows of the sprite, already shifted to their x position.
+ * @param size The length of the sprite (in pixels).
+ * @return true There has been a pixel collision.
+ * @return false No pixel collision.
+ */
+bool chip8_screen_draw_rows_clipped(struct chip8_screen* screen, int x, int y, const uint64_t* rows, int length)
+{
+    return chip8_screen_draw_rows_profile(screen, x, y, rows, length, true);
 }
\ No newline at end of file
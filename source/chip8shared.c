@@ -0,0 +1,490 @@
+#include "chip8shared.h"
+#include "chip8.h"
+#include "chip8log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_timer.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Both processes update the same atomics, which only works when they need no lock */
+_Static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_SHORT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+               "the shared control plane needs lock-free atomics");
+_Static_assert((CHIP8_SHARED_COMMANDS & (CHIP8_SHARED_COMMANDS - 1)) == 0, "command ring size must be a power of two");
+_Static_assert(sizeof(struct chip8_shared_header) <= CHIP8_SHARED_LINE, "the instances start on the second line");
+
+/* Polls without finding a command before a serving thread starts sleeping */
+#define CHIP8_SHARED_SPINS 4096
+
+/* Instances served by one thread */
+struct chip8_shared_server
+{
+    struct chip8_shared* shared;
+    const struct chip8* initial;
+    struct chip8* instances;
+    /* Keypad applied to each instance by its last step */
+    uint16_t* keypads;
+    /* Number of instances, as validated when the segment was mapped */
+    int count;
+    int first;
+    int stride;
+};
+
+
+/**
+ * @brief Get the size of a segment holding a number of instances.
+ * 
+ * @param count Number of instances.
+ * @return size_t Size in bytes.
+ */
+static size_t chip8_shared_size(int count)
+{
+    return CHIP8_SHARED_LINE + (size_t) count * sizeof(struct chip8_shared_instance);
+}
+
+
+/**
+ * @brief Map a named shared memory segment, creating it when size is not 0.
+ * 
+ * @param shared Pointer to the chip8_shared struct receiving the mapping.
+ * @param name Name of the segment.
+ * @param size Size of the segment to create, 0 to open an existing one.
+ * @return true The segment has been mapped.
+ * @return false The segment could not be created, opened or mapped.
+ */
+static bool chip8_shared_map(struct chip8_shared* shared, const char* name, size_t size)
+{
+    /* POSIX names start with a slash */
+    snprintf(shared->name, sizeof(shared->name), "%s%s", name[0] == '/' ? "" : "/", name);
+    shared->owner = size > 0;
+
+#ifdef _WIN32
+    HANDLE mapping;
+    if (size > 0)
+    {
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                     (DWORD) ((uint64_t) size >> 32), (DWORD) size, shared->name + 1);
+    }
+    else
+    {
+        mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, shared->name + 1);
+    }
+    if (!mapping)
+    {
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!data)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+    if (size == 0)
+    {
+        MEMORY_BASIC_INFORMATION info;
+        VirtualQuery(data, &info, sizeof(info));
+        size = info.RegionSize;
+    }
+    shared->mapping = mapping;
+#else
+    int fd = shm_open(shared->name, size > 0 ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    struct stat st;
+    bool sized = size > 0 ? ftruncate(fd, size) == 0 : fstat(fd, &st) == 0 && (size = st.st_size) > 0;
+    void* data = sized ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        if (shared->owner)
+        {
+            shm_unlink(shared->name);
+        }
+        return false;
+    }
+    shared->mapping = NULL;
+#endif
+
+    shared->header = data;
+    shared->instances = (struct chip8_shared_instance*) ((unsigned char*) data + CHIP8_SHARED_LINE);
+    shared->size = size;
+    return true;
+}
+
+
+/**
+ * @brief Create the segment and its control blocks, on the emulator side.
+ * 
+ * @param shared Pointer to the chip8_shared struct to fill.
+ * @param name Name of the segment.
+ * @param count Number of instances.
+ * @return true The segment is ready to be served.
+ * @return false The segment could not be created.
+ */
+bool chip8_shared_create(struct chip8_shared* shared, const char* name, int count)
+{
+    if (count < 1 || count > CHIP8_SHARED_MAX_INSTANCES || !chip8_shared_map(shared, name, chip8_shared_size(count)))
+    {
+        CHIP8_LOG_ERROR("Failed to create the shared segment %s for %d instances", name, count);
+        return false;
+    }
+
+    /* The header is completed last, an orchestrator checks the magic before anything else */
+    memset(shared->header, 0, shared->size);
+    shared->header->version = CHIP8_SHARED_VERSION;
+    shared->header->count = count;
+    shared->count = count;
+    shared->header->instance_size = sizeof(struct chip8_shared_instance);
+    atomic_thread_fence(memory_order_release);
+    shared->header->magic = CHIP8_SHARED_MAGIC;
+
+    CHIP8_LOG_INFO("Created the shared segment %s with %d instances (%u bytes)", shared->name, count, (unsigned int) shared->size);
+    return true;
+}
+
+
+/**
+ * @brief Map an existing segment, on the orchestrator side.
+ * 
+ * @param shared Pointer to the chip8_shared struct to fill.
+ * @param name Name of the segment.
+ * @return true The segment is mapped and valid.
+ * @return false The segment does not exist or is not valid.
+ */
+bool chip8_shared_open(struct chip8_shared* shared, const char* name)
+{
+    if (!chip8_shared_map(shared, name, 0))
+    {
+        CHIP8_LOG_ERROR("Failed to open the shared segment %s", name);
+        return false;
+    }
+
+    const struct chip8_shared_header* header = shared->header;
+    uint32_t count = shared->size >= CHIP8_SHARED_LINE ? header->count : 0;
+    if (shared->size < CHIP8_SHARED_LINE || header->magic != CHIP8_SHARED_MAGIC || header->version != CHIP8_SHARED_VERSION ||
+        header->instance_size != sizeof(struct chip8_shared_instance) ||
+        count < 1 || count > CHIP8_SHARED_MAX_INSTANCES || chip8_shared_size(count) > shared->size)
+    {
+        CHIP8_LOG_ERROR("%s is not a valid shared segment", name);
+        chip8_shared_close(shared);
+        return false;
+    }
+    shared->count = count;
+    atomic_thread_fence(memory_order_acquire);
+    return true;
+}
+
+
+/**
+ * @brief Unmap the segment, the creator also removes its name.
+ * 
+ * @param shared Pointer to a mapped chip8_shared struct.
+ * @return Void.
+ */
+void chip8_shared_close(struct chip8_shared* shared)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(shared->header);
+    CloseHandle(shared->mapping);
+#else
+    munmap(shared->header, shared->size);
+    if (shared->owner)
+    {
+        shm_unlink(shared->name);
+    }
+#endif
+    shared->header = NULL;
+    shared->instances = NULL;
+    shared->size = 0;
+}
+
+
+/**
+ * @brief Queue a command for an instance. Only one thread may push to an instance.
+ * 
+ * @param instance Pointer to the control block of the instance.
+ * @param type The command.
+ * @param argument The argument of the command.
+ * @return true The command has been queued.
+ * @return false The ring is full.
+ */
+bool chip8_shared_push(struct chip8_shared_instance* instance, uint32_t type, uint32_t argument)
+{
+    uint32_t head = atomic_load_explicit(&instance->command_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&instance->command_tail, memory_order_acquire);
+    if (head - tail == CHIP8_SHARED_COMMANDS)
+    {
+        return false;
+    }
+
+    struct chip8_shared_command* command = &instance->commands[head & (CHIP8_SHARED_COMMANDS - 1)];
+    command->type = type;
+    command->argument = argument;
+    atomic_store_explicit(&instance->command_head, head + 1, memory_order_release);
+    return true;
+}
+
+
+/**
+ * @brief Check whether an instance has run all the commands queued for it.
+ *        Once it has, its published frame reflects the last of them.
+ * 
+ * @param instance Pointer to the control block of the instance.
+ * @return true No command is pending.
+ * @return false Commands are still pending.
+ */
+bool chip8_shared_idle(struct chip8_shared_instance* instance)
+{
+    return atomic_load_explicit(&instance->command_tail, memory_order_acquire) ==
+           atomic_load_explicit(&instance->command_head, memory_order_relaxed);
+}
+
+
+/**
+ * @brief Get the last frame of an instance, to be read in place.
+ *        While the instance keeps running, the reading must be validated by chip8_shared_end_read.
+ * 
+ * @param instance Pointer to the control block of the instance.
+ * @param sequence Receives the sequence of the frame.
+ * @return const struct chip8_shared_frame* The frame.
+ */
+const struct chip8_shared_frame* chip8_shared_begin_read(struct chip8_shared_instance* instance, uint32_t* sequence)
+{
+    for (;;)
+    {
+        uint32_t index = atomic_load_explicit(&instance->published, memory_order_acquire);
+        const struct chip8_shared_frame* frame = &instance->buffers[index & 1];
+        *sequence = atomic_load_explicit(&frame->sequence, memory_order_acquire);
+        if ((*sequence & 1) == 0)
+        {
+            return frame;
+        }
+    }
+}
+
+
+/**
+ * @brief Check that a frame has not been overwritten while it was read.
+ * 
+ * @param frame The frame returned by chip8_shared_begin_read.
+ * @param sequence The sequence returned by chip8_shared_begin_read.
+ * @return true What has been read is consistent.
+ * @return false The frame has been overwritten, it must be read again.
+ */
+bool chip8_shared_end_read(const struct chip8_shared_frame* frame, uint32_t sequence)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&((struct chip8_shared_frame*) frame)->sequence, memory_order_relaxed) == sequence;
+}
+
+
+/**
+ * @brief Write the state of an instance into the buffer that is not published, then publish it.
+ * 
+ * @param control Pointer to the control block of the instance.
+ * @param chip8 Pointer to the instance.
+ * @return Void.
+ */
+static void chip8_shared_publish(struct chip8_shared_instance* control, const struct chip8* chip8)
+{
+    uint32_t index = atomic_load_explicit(&control->published, memory_order_relaxed) ^ 1;
+    struct chip8_shared_frame* frame = &control->buffers[index];
+    uint32_t sequence = atomic_load_explicit(&frame->sequence, memory_order_relaxed);
+
+    atomic_store_explicit(&frame->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    frame->frame = atomic_load_explicit(&control->frames, memory_order_relaxed);
+    memcpy(frame->pixels, chip8->screen.pixels, sizeof(frame->pixels));
+    frame->registers = chip8->registers;
+    atomic_store_explicit(&frame->sequence, sequence + 2, memory_order_release);
+    atomic_store_explicit(&control->published, index, memory_order_release);
+}
+
+
+/**
+ * @brief Run the commands queued for one instance.
+ * 
+ * @param server Pointer to the server of the instance.
+ * @param index The instance.
+ * @return bool True if at least one command has been run.
+ */
+static bool chip8_shared_run(struct chip8_shared_server* server, int index)
+{
+    struct chip8_shared_instance* control = &server->shared->instances[index];
+    struct chip8* chip8 = &server->instances[index];
+    uint32_t tail = atomic_load_explicit(&control->command_tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&control->command_head, memory_order_acquire);
+    uint32_t first = tail;
+
+    for ( ; tail != head ; tail++)
+    {
+        const struct chip8_shared_command* command = &control->commands[tail & (CHIP8_SHARED_COMMANDS - 1)];
+        switch (command->type)
+        {
+            case CHIP8_SHARED_COMMAND_RESET:
+            {
+                /* The generator belongs to the instance, a reset does not rewind it to the initial state */
+                uint32_t random = chip8->random;
+                chip8_free(chip8);
+                chip8_fork(chip8, server->initial);
+                chip8->random = random;
+                server->keypads[index] = 0;
+                chip8_shared_publish(control, chip8);
+            }
+            break;
+
+            case CHIP8_SHARED_COMMAND_STEP:
+            {
+                /* Key changes go through the keyboard so that LD Vx, K sees the presses */
+                uint16_t keypad = atomic_load_explicit(&control->keypad, memory_order_relaxed);
+                uint16_t changed = keypad ^ server->keypads[index];
+                for (int key = 0 ; key < CHIP8_TOTAL_KEYS ; key++)
+                {
+                    if (!(changed & (1 << key)))
+                    {
+                        continue;
+                    }
+                    if (keypad & (1 << key))
+                    {
+                        chip8_keyboard_down(&chip8->keyboard, key);
+                    }
+                    else
+                    {
+                        chip8_keyboard_up(&chip8->keyboard, key);
+                    }
+                }
+                server->keypads[index] = keypad;
+
+                for (uint32_t i = 0 ; i < command->argument ; i++)
+                {
+                    chip8_run_frame(chip8, CHIP8_INSTRUCTIONS_PER_FRAME);
+                }
+                atomic_fetch_add_explicit(&control->frames, command->argument, memory_order_relaxed);
+                chip8_shared_publish(control, chip8);
+            }
+            break;
+
+            case CHIP8_SHARED_COMMAND_SEED:
+                chip8_seed(chip8, command->argument);
+            break;
+
+            default:
+                CHIP8_LOG_WARNING("Unknown shared command %u for instance %d", command->type, index);
+            break;
+        }
+        atomic_store_explicit(&control->command_tail, tail + 1, memory_order_release);
+    }
+    return tail != first;
+}
+
+
+/**
+ * @brief Serving thread, runs the commands of its instances until the orchestrator stops the emulator.
+ * 
+ * @param data Pointer to the chip8_shared_server struct of the thread.
+ * @return int 0.
+ */
+static int chip8_shared_worker(void* data)
+{
+    struct chip8_shared_server* server = data;
+    struct chip8_shared_header* header = server->shared->header;
+    int idle = 0;
+
+    while (!atomic_load_explicit(&header->stop, memory_order_acquire))
+    {
+        bool busy = false;
+        for (int i = server->first ; i < server->count ; i += server->stride)
+        {
+            busy |= chip8_shared_run(server, i);
+        }
+
+        /* Keep polling while commands arrive, sleep once the orchestrator is quiet */
+        idle = busy ? 0 : idle + 1;
+        if (idle > CHIP8_SHARED_SPINS)
+        {
+            SDL_Delay(1);
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Run the instances of the segment until the orchestrator sets the stop flag.
+ *        Every instance starts as a copy-on-write fork of the initial state.
+ * 
+ * @param shared Pointer to a chip8_shared struct created by chip8_shared_create.
+ * @param initial Pointer to the state each instance starts (and is reset) from.
+ * @param threads Number of serving threads, the instances are spread evenly among them.
+ * @return Void.
+ */
+void chip8_shared_serve(struct chip8_shared* shared, const struct chip8* initial, int threads)
+{
+    int count = shared->count;
+    threads = threads < 1 ? 1 : threads > count ? count : threads;
+
+    struct chip8* instances = calloc(count, sizeof(struct chip8));
+    uint16_t* keypads = calloc(count, sizeof(uint16_t));
+    struct chip8_shared_server* servers = calloc(threads, sizeof(struct chip8_shared_server));
+    SDL_Thread** handles = calloc(threads, sizeof(SDL_Thread*));
+    if (!instances || !keypads || !servers || !handles)
+    {
+        CHIP8_LOG_ERROR("Failed to allocate %d shared instances", count);
+        free(instances);
+        free(keypads);
+        free(servers);
+        free(handles);
+        return;
+    }
+
+    for (int i = 0 ; i < count ; i++)
+    {
+        chip8_fork(&instances[i], initial);
+        chip8_shared_publish(&shared->instances[i], &instances[i]);
+    }
+
+    CHIP8_LOG_INFO("Serving %d instances on %d threads", count, threads);
+    for (int t = 0 ; t < threads ; t++)
+    {
+        servers[t] = (struct chip8_shared_server) { shared, initial, instances, keypads, count, t, threads };
+    }
+    for (int t = 1 ; t < threads ; t++)
+    {
+        handles[t] = SDL_CreateThread(chip8_shared_worker, "chip8 shared", &servers[t]);
+        if (!handles[t])
+        {
+            /* Some instances would never run, the emulator stops */
+            CHIP8_LOG_ERROR("Failed to create a serving thread: %s", SDL_GetError());
+            atomic_store_explicit(&shared->header->stop, 1, memory_order_release);
+            break;
+        }
+    }
+    /* The calling thread serves the first share itself */
+    chip8_shared_worker(&servers[0]);
+    for (int t = 1 ; t < threads && handles[t] ; t++)
+    {
+        SDL_WaitThread(handles[t], NULL);
+    }
+    CHIP8_LOG_INFO("The orchestrator has stopped the emulator");
+
+    for (int i = 0 ; i < count ; i++)
+    {
+        chip8_free(&instances[i]);
+    }
+    free(instances);
+    free(keypads);
+    free(servers);
+    free(handles);
+}
\ No newline at end of file
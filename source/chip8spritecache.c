@@ -0,0 +1,100 @@
+#include "chip8spritecache.h"
+#include "chip8screen.h"
+#include <assert.h>
+
+/**
+ * @brief Drop every cached sprite.
+ * 
+ * @param cache Pointer to a chip8_sprite_cache struct.
+ * @return Void.
+ */
+void chip8_sprite_cache_clear(struct chip8_sprite_cache* cache)
+{
+    /* Only the tags are reset, the rows of an unused entry are never read */
+    for (int i = 0 ; i < CHIP8_SPRITE_CACHE_ENTRIES ; i++)
+    {
+        cache->entries[i].height = 0;
+        cache->entries[i].built = 0;
+    }
+    cache->victim = 0;
+}
+
+
+/**
+ * @brief Find the entry holding the sprite, or claim one for it.
+ * 
+ * @param cache Pointer to a chip8_sprite_cache struct.
+ * @param address Memory address of the first byte of the sprite.
+ * @param height The length of the sprite (in pixels).
+ * @return struct chip8_sprite_cache_entry* The entry of the sprite.
+ */
+static struct chip8_sprite_cache_entry* chip8_sprite_cache_find(struct chip8_sprite_cache* cache, int address, int height)
+{
+    for (int i = 0 ; i < CHIP8_SPRITE_CACHE_ENTRIES ; i++)
+    {
+        struct chip8_sprite_cache_entry* entry = &cache->entries[i];
+        if (entry->height == height && entry->address == address)
+        {
+            return entry;
+        }
+    }
+
+    struct chip8_sprite_cache_entry* entry = &cache->entries[cache->victim];
+    cache->victim = (cache->victim + 1) % CHIP8_SPRITE_CACHE_ENTRIES;
+    entry->address = address;
+    entry->height = height;
+    entry->built = 0;
+    return entry;
+}
+
+
+/**
+ * @brief Get the rows of a sprite pre-shifted to the x offset, building them on first use.
+ * 
+ * @param cache Pointer to a chip8_sprite_cache struct.
+ * @param memory Pointer to the chip8_memory struct the sprite is read from.
+ * @param address Memory address of the first byte of the sprite.
+ * @param height The length of the sprite (in pixels).
+ * @param x The x-axis pixel position (any value, it is wrapped to the screen width).
+ * @return const uint64_t* The packed rows, ready to be drawn with chip8_screen_draw_rows().
+ */
+const uint64_t* chip8_sprite_cache_get(struct chip8_sprite_cache* cache, struct chip8_memory* memory, int address, int height, int x)
+{
+    assert(height > 0 && height <= CHIP8_SPRITE_MAX_HEIGHT);
+    x %= CHIP8_WIDTH;
+
+    struct chip8_sprite_cache_entry* entry = chip8_sprite_cache_find(cache, address, height);
+    uint64_t offset = 1ULL << x;
+    if (!(entry->built & offset))
+    {
+        for (int ly = 0 ; ly < height ; ly++)
+        {
+            unsigned char byte = chip8_memory_get(memory, (address + ly) % CHIP8_MEMORY_SIZE);
+            entry->rows[x][ly] = chip8_screen_sprite_row(byte, x);
+        }
+        entry->built |= offset;
+    }
+    return entry->rows[x];
+}
+
+
+/**
+ * @brief Discard the sprites that cover a memory byte that has just been written.
+ * 
+ * @param cache Pointer to a chip8_sprite_cache struct.
+ * @param index The memory byte that has been written.
+ * @return Void.
+ */
+void chip8_sprite_cache_invalidate(struct chip8_sprite_cache* cache, int index)
+{
+    for (int i = 0 ; i < CHIP8_SPRITE_CACHE_ENTRIES ; i++)
+    {
+        struct chip8_sprite_cache_entry* entry = &cache->entries[i];
+        int offset = (index - entry->address + CHIP8_MEMORY_SIZE) % CHIP8_MEMORY_SIZE;
+        if (offset < entry->height)
+        {
+            entry->height = 0;
+            entry->built = 0;
+        }
+    }
+}
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "chip8stack.h"
 #include "chip8.h"
+#include "chip8log.h"
+#include "chip8hash.h"
 #include <assert.h>
 
 /**
@@ -10,7 +12,11 @@
  */
 static void chip8_is_stack_in_bounds(struct chip8* chip8)
 {
-    assert(chip8->registers.SP < sizeof(chip8->stack.stack));
+    if (chip8->registers.SP >= CHIP8_TOTAL_STACK_DEPTH)
+    {
+        CHIP8_LOG_ERROR("Stack pointer %u out of bounds at PC %03x", chip8->registers.SP, chip8->registers.PC);
+    }
+    assert(chip8->registers.SP < CHIP8_TOTAL_STACK_DEPTH);
 }
 
 
@@ -25,7 +31,10 @@ void chip8_stack_push(struct chip8* chip8, unsigned short val)
 {
     chip8->registers.SP += 1;
     chip8_is_stack_in_bounds(chip8);
-    chip8->stack.stack[chip8->registers.SP] = val;
+    unsigned short* slot = &chip8->stack.stack[chip8->registers.SP];
+    chip8->stack.hash ^= chip8_hash_key(CHIP8_HASH_STACK, chip8->registers.SP, *slot) ^
+                         chip8_hash_key(CHIP8_HASH_STACK, chip8->registers.SP, val);
+    *slot = val;
 }
 
 
@@ -0,0 +1,213 @@
+#include "chip8terminal.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+/* Pixels covered by a cell */
+static const int chip8_terminal_cell_width[] = { 1, 2 };
+static const int chip8_terminal_cell_height[] = { 2, 4 };
+
+/* Half block characters by cell value, bit 0 being the top pixel and bit 1 the bottom one */
+static const char* const chip8_terminal_half_blocks[] = { " ", "\xe2\x96\x80", "\xe2\x96\x84", "\xe2\x96\x88" };
+
+/* Braille dot of each pixel of a cell, by row and column */
+static const unsigned char chip8_terminal_braille_dots[4][2] =
+{
+    { 0x01, 0x08 },
+    { 0x02, 0x10 },
+    { 0x04, 0x20 },
+    { 0x40, 0x80 }
+};
+
+
+/**
+ * @brief Write the whole data to a file descriptor, resuming after partial writes.
+ * 
+ * @param fd The file descriptor.
+ * @param data The data.
+ * @param size Size of the data.
+ * @return true The data has been written.
+ * @return false The write failed.
+ */
+static bool chip8_terminal_write(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+#ifdef _WIN32
+        int written = _write(fd, data, (unsigned int) size);
+#else
+        ssize_t written = write(fd, data, size);
+#endif
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+
+/**
+ * @brief Get the value of a cell: the pixels it covers, one bit each.
+ * 
+ * @param cells The kind of cells.
+ * @param rows The packed rows of the screen.
+ * @param column Column of the cell.
+ * @param row Row of the cell.
+ * @return unsigned int The cell value, the index of its half block or its braille dots.
+ */
+static unsigned int chip8_terminal_cell(enum chip8_terminal_cells cells, const uint64_t* rows, int column, int row)
+{
+    if (cells == CHIP8_TERMINAL_HALF_BLOCKS)
+    {
+        int shift = 63 - column;
+        return (rows[2 * row] >> shift & 1) | (rows[2 * row + 1] >> shift & 1) << 1;
+    }
+
+    unsigned int dots = 0;
+    for (int y = 0 ; y < 4 ; y++)
+    {
+        uint64_t pixels = rows[4 * row + y] >> (62 - 2 * column);
+        dots |= (pixels >> 1 & 1) * chip8_terminal_braille_dots[y][0];
+        dots |= (pixels & 1) * chip8_terminal_braille_dots[y][1];
+    }
+    return dots;
+}
+
+
+/**
+ * @brief Append the character of a cell to a buffer.
+ * 
+ * @param cells The kind of cells.
+ * @param value The value of the cell.
+ * @param out Receives the UTF-8 character, at most CHIP8_TERMINAL_CELL_SIZE bytes.
+ * @return int The number of bytes written.
+ */
+static int chip8_terminal_encode(enum chip8_terminal_cells cells, unsigned int value, char* out)
+{
+    if (cells == CHIP8_TERMINAL_HALF_BLOCKS)
+    {
+        const char* block = chip8_terminal_half_blocks[value];
+        int length = (int) strlen(block);
+        memcpy(out, block, length);
+        return length;
+    }
+
+    /* U+2800 + dots */
+    out[0] = (char) 0xe2;
+    out[1] = (char) (0xa0 | value >> 6);
+    out[2] = (char) (0x80 | (value & 0x3f));
+    return 3;
+}
+
+
+/**
+ * @brief Take over a terminal: clear it and hide the cursor. The terminal then shows a blank screen.
+ * 
+ * @param terminal Pointer to a chip8_terminal struct.
+ * @param fd File descriptor of the terminal, such as the one of stdout.
+ * @param cells The kind of cells the screen is drawn with.
+ * @return bool True if the terminal has been cleared.
+ */
+bool chip8_terminal_open(struct chip8_terminal* terminal, int fd, enum chip8_terminal_cells cells)
+{
+    memset(terminal, 0, sizeof(struct chip8_terminal));
+    terminal->fd = fd;
+    terminal->cells = cells;
+
+#ifdef _WIN32
+    /* The Windows console only understands escape codes and UTF-8 when asked to */
+    HANDLE console = (HANDLE) _get_osfhandle(fd);
+    DWORD mode;
+    if (GetConsoleMode(console, &mode))
+    {
+        SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+        SetConsoleOutputCP(CP_UTF8);
+    }
+#endif
+
+    /* Reset the attributes, clear and hide the cursor */
+    static const char start[] = "\x1b[0m\x1b[2J\x1b[?25l";
+    return chip8_terminal_write(fd, start, sizeof(start) - 1);
+}
+
+
+/**
+ * @brief Draw a screen on the terminal. Only the cells that differ from the previous frame
+ *        are written, with a cursor move before each run of changed cells.
+ * 
+ * @param terminal Pointer to a chip8_terminal struct.
+ * @param screen Pointer to the chip8_screen struct to draw.
+ * @return bool False if writing to the terminal failed.
+ */
+bool chip8_terminal_present(struct chip8_terminal* terminal, const struct chip8_screen* screen)
+{
+    enum chip8_terminal_cells cells = terminal->cells;
+    int width = chip8_terminal_cell_width[cells];
+    int height = chip8_terminal_cell_height[cells];
+    char* out = terminal->buffer;
+
+    for (int row = 0 ; row < CHIP8_HEIGHT / height ; row++)
+    {
+        /* Most rows of cells do not change between frames */
+        if (memcmp(&screen->pixels[row * height], &terminal->shown[row * height], height * sizeof(uint64_t)) == 0)
+        {
+            continue;
+        }
+
+        /* Column the cursor is at, after the last cell written */
+        int cursor = -1;
+        for (int column = 0 ; column < CHIP8_WIDTH / width ; column++)
+        {
+            unsigned int value = chip8_terminal_cell(cells, screen->pixels, column, row);
+            if (value == chip8_terminal_cell(cells, terminal->shown, column, row))
+            {
+                continue;
+            }
+            if (cursor != column)
+            {
+                out += sprintf(out, "\x1b[%d;%dH", row + 1, column + 1);
+            }
+            out += chip8_terminal_encode(cells, value, out);
+            cursor = column + 1;
+        }
+    }
+
+    memcpy(terminal->shown, screen->pixels, sizeof(terminal->shown));
+    size_t size = out - terminal->buffer;
+    if (size == 0)
+    {
+        return true;
+    }
+    terminal->frames += 1;
+    terminal->bytes += size;
+    return chip8_terminal_write(terminal->fd, terminal->buffer, size);
+}
+
+
+/**
+ * @brief Give the terminal back: show the cursor again, below the last frame.
+ * 
+ * @param terminal Pointer to a chip8_terminal struct.
+ * @return Void.
+ */
+void chip8_terminal_close(struct chip8_terminal* terminal)
+{
+    char end[32];
+    int length = snprintf(end, sizeof(end), "\x1b[%d;1H\x1b[?25h\n",
+                          CHIP8_HEIGHT / chip8_terminal_cell_height[terminal->cells] + 1);
+    chip8_terminal_write(terminal->fd, end, length);
+}
\ No newline at end of file
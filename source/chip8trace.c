@@ -0,0 +1,274 @@
+#include "chip8trace.h"
+#include "chip8.h"
+#include <memory.h>
+#include <SDL2/SDL_timer.h>
+
+_Static_assert((CHIP8_TRACE_RECORDS & (CHIP8_TRACE_RECORDS - 1)) == 0, "trace size must be a power of two");
+
+/* Largest number of records the writer thread saves at once */
+#define CHIP8_TRACE_SPILL_CHUNK 4096
+
+/* Pause of the writer thread between two spills, in milliseconds */
+#define CHIP8_TRACE_SPILL_INTERVAL 10
+
+/**
+ * @brief Initialize an empty and disabled trace.
+ * 
+ * @param trace Pointer to a chip8_trace struct.
+ * @return Void.
+ */
+void chip8_trace_init(struct chip8_trace* trace)
+{
+    atomic_init(&trace->head, 0);
+    atomic_init(&trace->enabled, false);
+    atomic_init(&trace->stop, false);
+    atomic_init(&trace->dropped, 0);
+    trace->file = NULL;
+    trace->writer = NULL;
+    trace->spilled = 0;
+}
+
+
+/**
+ * @brief Start or stop recording the executed instructions.
+ * 
+ * @param trace Pointer to a chip8_trace struct.
+ * @param enabled Whether the instructions are recorded.
+ * @return Void.
+ */
+void chip8_trace_set_enabled(struct chip8_trace* trace, bool enabled)
+{
+    atomic_store_explicit(&trace->enabled, enabled, memory_order_relaxed);
+}
+
+
+/**
+ * @brief Check whether the executed instructions are being recorded.
+ * 
+ * @param trace Pointer to a chip8_trace struct.
+ * @return true Tracing is enabled.
+ * @return false Tracing is disabled.
+ */
+bool chip8_trace_is_enabled(struct chip8_trace* trace)
+{
+    return atomic_load_explicit(&trace->enabled, memory_order_relaxed);
+}
+
+
+/**
+ * @brief Fetch and execute the next instruction, recording it when tracing is enabled.
+ * 
+ * @param trace Pointer to a chip8_trace struct.
+ * @param chip8 Pointer to the chip8 struct to step.
+ * @return Void.
+ */
+void chip8_trace_step(struct chip8_trace* trace, struct chip8* chip8)
+{
+    if (!atomic_load_explicit(&trace->enabled, memory_order_relaxed))
+    {
+        chip8_step(chip8);
+        return;
+    }
+
+    unsigned short pc = chip8->registers.PC;
+    unsigned short opcode = chip8_memory_get_short(&chip8->memory, pc);
+    unsigned char before[CHIP8_TOTAL_DATA_REGISTERS];
+    memcpy(before, chip8->registers.V, sizeof(before));
+
+    chip8_step(chip8);
+
+    uint32_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    struct chip8_trace_record* record = &trace->records[head & (CHIP8_TRACE_RECORDS - 1)];
+    record->sequence = head;
+    record->PC = pc;
+    record->opcode = opcode;
+    record->I = chip8->registers.I;
+    record->changed = 0;
+    for (int i = 0 ; i < CHIP8_TOTAL_DATA_REGISTERS ; i++)
+    {
+        record->changed |= (before[i] != chip8->registers.V[i]) << i;
+    }
+    memcpy(record->V, chip8->registers.V, sizeof(record->V));
+    record->SP = chip8->registers.SP;
+    record->delay_timer = chip8->registers.delay_timer;
+    atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
+
+
+/**
+ * @brief Write the header of a trace file.
+ * 
+ * @param file The trace file.
+ * @return true The header has been written.
+ * @return false The write failed.
+ */
+static bool chip8_trace_write_header(FILE* file)
+{
+    struct chip8_trace_header header;
+    header.magic = CHIP8_TRACE_MAGIC;
+    header.version = CHIP8_TRACE_VERSION;
+    header.record_size = sizeof(struct chip8_trace_record);
+    header.reserved = 0;
+    return fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+
+/**
+ * @brief Write the records that have not been spilled yet to the trace file.
+ *        Records overwritten by the emulation thread while they were copied are dropped.
+ * 
+ * @param trace Pointer to a chip8_trace struct.
+ * @return Void.
+ */
+static void chip8_trace_spill(struct chip8_trace* trace)
+{
+    static struct chip8_trace_record chunk[CHIP8_TRACE_SPILL_CHUNK];
+
+    while (1)
+    {
+        /*
+         The record at head may be the one being written, in the slot of the record
+         CHIP8_TRACE_RECORDS before it, which is then dropped too
+        */
+        uint32_t head = atomic_load_explicit(&trace->head, memory_order_acquire);
+        if (head - trace->spilled >= CHIP8_TRACE_RECORDS)
+        {
+            uint32_t lost = head - trace->spilled - CHIP8_TRACE_RECORDS + 1;
+            atomic_fetch_add_explicit(&trace->dropped, lost, memory_order_relaxed);
+            trace->spilled += lost;
+        }
+
+        uint32_t count = head - trace->spilled;
+        if (count == 0)
+        {
+            return;
+        }
+        if (count > CHIP8_TRACE_SPILL_CHUNK)
+        {
+            count = CHIP8_TRACE_SPILL_CHUNK;
+        }
+
+        for (uint32_t i = 0 ; i < count ; i++)
+        {
+            chunk[i] = trace->records[(trace->spilled + i) & (CHIP8_TRACE_RECORDS - 1)];
+        }
+
+        /* Skip the records the emulation thread may have overwritten during the copy */
+        uint32_t first = 0;
+        uint32_t now = atomic_load_explicit(&trace->head, memory_order_acquire);
+        if (now - trace->spilled >= CHIP8_TRACE_RECORDS)
+        {
+            first = now - trace->spilled - CHIP8_TRACE_RECORDS + 1;
+            if (first > count)
+            {
+                first = count;
+            }
+            atomic_fetch_add_explicit(&trace->dropped, first, memory_order_relaxed);
+        }
+
+        fwrite(&chunk[first], sizeof(struct chip8_trace_record), count - first, trace->file);
+        trace->spilled += count;
+    }
+}
+
+
+/**
+ * @brief Entry point of the writer thread: spill the records periodically until the trace is closed.
+ * 
+ * @param data Pointer to the chip8_trace struct.
+ * @return int Always 0.
+ */
+static int chip8_trace_writer(void* data)
+{
+    struct chip8_trace* trace = data;
+
+    while (!atomic_load(&trace->stop))
+    {
+        chip8_trace_spill(trace);
+        SDL_Delay(CHIP8_TRACE_SPILL_INTERVAL);
+    }
+    chip8_trace_spill(trace);
+
+    return 0;
+}
+
+
+/**
+ * @brief Spill the records to a file from a background thread.
+ * 
+ * @param trace Pointer to a chip8_trace struct.
+ * @param filename Path of the trace file to create.
+ * @return true The file has been created and the writer thread started.
+ * @return false The file could not be created.
+ */
+bool chip8_trace_open(struct chip8_trace* trace, const char* filename)
+{
+    trace->file = fopen(filename, "wb");
+    if (!trace->file)
+    {
+        return false;
+    }
+
+    if (!chip8_trace_write_header(trace->file))
+    {
+        fclose(trace->file);
+        trace->file = NULL;
+        return false;
+    }
+
+    trace->spilled = atomic_load(&trace->head);
+    atomic_store(&trace->stop, false);
+    trace->writer = SDL_CreateThread(chip8_trace_writer, "trace writer", trace);
+    return true;
+}
+
+
+/**
+ * @brief Stop the writer thread after it has spilled the last records, and close the file.
+ * 
+ * @param trace Pointer to a chip8_trace struct.
+ * @return Void.
+ */
+void chip8_trace_close(struct chip8_trace* trace)
+{
+    if (!trace->file)
+    {
+        return;
+    }
+
+    atomic_store(&trace->stop, true);
+    SDL_WaitThread(trace->writer, NULL);
+    trace->writer = NULL;
+    fclose(trace->file);
+    trace->file = NULL;
+}
+
+
+/**
+ * @brief Save the records still held by the ring buffer to a file.
+ *        Must not be called while instructions are being traced.
+ * 
+ * @param trace Pointer to a chip8_trace struct.
+ * @param filename Path of the trace file to create.
+ * @return true The file has been written.
+ * @return false The file could not be written.
+ */
+bool chip8_trace_dump(struct chip8_trace* trace, const char* filename)
+{
+    FILE* file = fopen(filename, "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    bool res = chip8_trace_write_header(file);
+    uint32_t head = atomic_load(&trace->head);
+    uint32_t count = head < CHIP8_TRACE_RECORDS ? head : CHIP8_TRACE_RECORDS;
+    for (uint32_t i = head - count ; res && i != head ; i++)
+    {
+        res = fwrite(&trace->records[i & (CHIP8_TRACE_RECORDS - 1)], sizeof(struct chip8_trace_record), 1, file) == 1;
+    }
+
+    fclose(file);
+    return res;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "chip8triplebuffer.h"
+#include <memory.h>
+
+/**
+ * @brief Initialize the three buffers with blank screens.
+ * 
+ * @param buffer Pointer to a chip8_triple_buffer struct.
+ * @return Void.
+ */
+void chip8_triple_buffer_init(struct chip8_triple_buffer* buffer)
+{
+    memset(buffer->buffers, 0, sizeof(buffer->buffers));
+    buffer->back = 0;
+    atomic_init(&buffer->middle, 1);
+    buffer->front = 2;
+}
+
+
+/**
+ * @brief Get the buffer where the writer composes the next frame.
+ * 
+ * @param buffer Pointer to a chip8_triple_buffer struct.
+ * @return struct chip8_screen* The buffer owned by the writer.
+ */
+struct chip8_screen* chip8_triple_buffer_back(struct chip8_triple_buffer* buffer)
+{
+    return &buffer->buffers[buffer->back];
+}
+
+
+/**
+ * @brief Hand the completed back buffer to the reader. Must only be called by the writer.
+ *        A frame that the reader has not taken yet is replaced.
+ * 
+ * @param buffer Pointer to a chip8_triple_buffer struct.
+ * @return Void.
+ */
+void chip8_triple_buffer_publish(struct chip8_triple_buffer* buffer)
+{
+    unsigned char fresh = buffer->back | CHIP8_TRIPLE_BUFFER_FRESH;
+    unsigned char previous = atomic_exchange_explicit(&buffer->middle, fresh, memory_order_acq_rel);
+    buffer->back = previous & ~CHIP8_TRIPLE_BUFFER_FRESH;
+}
+
+
+/**
+ * @brief Take the most recent frame if the writer has published one. Must only be called by the reader.
+ * 
+ * @param buffer Pointer to a chip8_triple_buffer struct.
+ * @return true A new frame is now available with chip8_triple_buffer_front().
+ * @return false No frame has been published since the last call.
+ */
+bool chip8_triple_buffer_acquire(struct chip8_triple_buffer* buffer)
+{
+    if (!(atomic_load_explicit(&buffer->middle, memory_order_relaxed) & CHIP8_TRIPLE_BUFFER_FRESH))
+    {
+        return false;
+    }
+
+    unsigned char previous = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel);
+    buffer->front = previous & ~CHIP8_TRIPLE_BUFFER_FRESH;
+    return true;
+}
+
+
+/**
+ * @brief Get the frame last acquired by the reader.
+ * 
+ * @param buffer Pointer to a chip8_triple_buffer struct.
+ * @return const struct chip8_screen* The buffer owned by the reader.
+ */
+const struct chip8_screen* chip8_triple_buffer_front(struct chip8_triple_buffer* buffer)
+{
+    return &buffer->buffers[buffer->front];
+}
\ No newline at end of file
@@ -1,12 +1,25 @@
 #include<stdio.h>
+#include <string.h>
+#include <stdlib.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <signal.h>
 #include <Windows.h>
 #include "SDL2/SDL.h"
 #include "chip8.h"
 #include "chip8keyboard.h"
+#include "chip8latency.h"
+#include "chip8triplebuffer.h"
+#include "chip8trace.h"
+#include "chip8profile.h"
+#include "chip8log.h"
+#include "chip8rompack.h"
+#include "chip8shared.h"
+#include "chip8render.h"
+#include "chip8terminal.h"
 
-/* This array contains the Chip-8 virtual keys */ 
-const char keyboard_map[CHIP8_TOTAL_KEYS] = 
+/* This array contains the host keycode of every Chip-8 virtual key */ 
+const int keyboard_map[CHIP8_TOTAL_KEYS] = 
 {
     SDLK_0, SDLK_1, SDLK_2, SDLK_3,
     SDLK_4, SDLK_5, SDLK_6, SDLK_7,
@@ -14,29 +27,364 @@ const char keyboard_map[CHIP8_TOTAL_KEYS] =
     SDLK_c, SDLK_d, SDLK_e, SDLK_f
 };
 
-int main(int argc, char** argv)
+/* Pre-shifted sprites drawn by the emulator, too large to live on the stack */
+static struct chip8_sprite_cache sprite_cache;
+
+/* Key events captured from SDL, applied to the emulator between instructions */
+static struct chip8_keyboard_queue keyboard_queue;
+
+/* Execution trace, toggled with F1 and spilled to a file with --trace */
+static struct chip8_trace trace;
+
+/* Frame phases recorded with --profile, one track per thread */
+static struct chip8_profile profile;
+static struct chip8_profile_track* presenter_track;
+static struct chip8_profile_track* emulation_track;
+
+/* Input-to-photon latency statistics, collected with --latency */
+static struct chip8_latency latency;
+
+/* Presenter drawing on the terminal, used instead of the window with --terminal */
+static struct chip8_terminal terminal;
+
+/**
+ * @brief Queue a key event for the emulator if the key is mapped to a virtual key.
+ * 
+ * @param chip8 Pointer to a chip8 struct.
+ * @param event Pointer to the SDL keyboard event.
+ * @return Void.
+ */
+static void queue_key_event(struct chip8* chip8, const SDL_KeyboardEvent* event)
 {
-    /* 
-    Verify that a filename has been provided before running the program.
-    If no filename is received, the program will be terminated.                    
+    /* Auto-repeated key downs do not change the state of the key */
+    if (event->repeat)
+    {
+        return;
+    }
+
+    int virtual_key = chip8_keyboard_map(&chip8->keyboard, event->keysym.sym);
+    if (virtual_key == -1)
+    {
+        return;
+    }
+
+    struct chip8_keyboard_event key_event;
+    key_event.timestamp = SDL_GetPerformanceCounter();
+    key_event.key = virtual_key;
+    key_event.down = event->type == SDL_KEYDOWN;
+    if (!chip8_keyboard_queue_push(&keyboard_queue, &key_event))
+    {
+        CHIP8_LOG_WARNING("Keyboard queue full, key event dropped");
+    }
+}
+
+/* Names accepted by --log-level, in the order of enum chip8_log_level */
+static const char* log_level_names[] = { "debug", "info", "warning", "error" };
+
+/* Real state saved while the run-ahead frames are emulated */
+static struct chip8 run_ahead_snapshot;
+
+/* Completed frames handed from the emulation thread to the presenter */
+static struct chip8_triple_buffer frames;
+
+/* State shared between the presenter (main thread) and the emulation thread */
+struct emulation
+{
+    struct chip8* chip8;
+    int run_ahead;
+    bool measure_latency;
+    /* Cleared by the presenter to stop the emulation thread */
+    atomic_bool running;
+};
+
+/**
+ * @brief Draw the Chip-8 screen in the window and present it.
+ * 
+ * @param renderer Rendering context of the window.
+ * @param screen Pointer to the chip8_screen struct to draw.
+ * @param scale Size of a pixel in the window.
+ * @return Void.
+ */
+static void render_screen(SDL_Renderer* renderer, const struct chip8_screen* screen, int scale)
+{
+    uint64_t start = chip8_profile_begin(&profile);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 0);
+
+    for (int x = 0 ; x < CHIP8_WIDTH ; x++)
+    {
+        for (int y = 0 ; y < CHIP8_HEIGHT ; y++)
+        {
+            /* Check if a pixel has to be drawn */
+            if ( chip8_screen_is_set(screen, x, y) )
+            {
+                /* Draw a rectangle symbolizing a pixel */
+                SDL_Rect r;
+                r.x = x * scale;
+                r.y = y * scale;
+                r.w = scale;
+                r.h = scale;
+                SDL_RenderFillRect(renderer, &r);
+            }
+        }
+    }
+
+    chip8_profile_end(&profile, presenter_track, "convert framebuffer", start);
+
+    /* Update the screen */
+    start = chip8_profile_begin(&profile);
+    SDL_RenderPresent(renderer);
+    chip8_profile_end(&profile, presenter_track, "present", start);
+}
+
+/**
+ * @brief Draw the Chip-8 screen in the window without a renderer: the pixels are expanded
+ *        into a canvas, which is copied to the surface of the window.
+ * 
+ * @param window The window.
+ * @param canvas ARGB surface of the size of the window.
+ * @param screen Pointer to the chip8_screen struct to draw.
+ * @param scale Size of a pixel in the window.
+ * @return Void.
+ */
+static void render_screen_software(SDL_Window* window, SDL_Surface* canvas, const struct chip8_screen* screen, int scale)
+{
+    uint64_t start = chip8_profile_begin(&profile);
+    SDL_LockSurface(canvas);
+    chip8_render_argb(screen, canvas->pixels, canvas->pitch, scale, CHIP8_PIXEL_ON_COLOR, CHIP8_PIXEL_OFF_COLOR);
+    SDL_UnlockSurface(canvas);
+    chip8_profile_end(&profile, presenter_track, "convert framebuffer", start);
+
+    /* The blit is a plain copy when the window surface is ARGB too, and converts it otherwise */
+    start = chip8_profile_begin(&profile);
+    SDL_BlitSurface(canvas, NULL, SDL_GetWindowSurface(window), NULL);
+    SDL_UpdateWindowSurface(window);
+    chip8_profile_end(&profile, presenter_track, "present", start);
+}
+
+/**
+ * @brief Apply the pending key events to the emulator.
+ * 
+ * @param emulation Pointer to the emulation struct.
+ * @return Void.
+ */
+static void apply_key_events(struct emulation* emulation)
+{
+    struct chip8_keyboard_event key_event;
+    while (chip8_keyboard_queue_pop(&keyboard_queue, &key_event))
+    {
+        chip8_keyboard_apply(&emulation->chip8->keyboard, &key_event);
+        if (emulation->measure_latency)
+        {
+            chip8_latency_key_event(&latency, emulation->chip8, &key_event);
+        }
+    }
+}
+
+/**
+ * @brief Log how much of the work each execution tier has done.
+ * 
+ * @param chip8 Pointer to the chip8 struct instance.
+ * @return Void.
+ */
+static void report_tiers(const struct chip8* chip8)
+{
+    const struct chip8_block_cache* cache = chip8->block_cache;
+    if (!cache)
+    {
+        return;
+    }
+
+    const struct chip8_stats* stats = &chip8->stats;
+    CHIP8_LOG_INFO("%llu of %llu instructions ran in blocks, %llu blocks installed, %llu discarded, %llu invalidated, %llu freed",
+                   stats->block_instructions,
+                   stats->instructions,
+                   atomic_load(&cache->stats.installed),
+                   atomic_load(&cache->stats.discarded),
+                   atomic_load(&cache->stats.invalidated),
+                   atomic_load(&cache->stats.reclaimed));
+    CHIP8_LOG_INFO("%llu returns dispatched through the shadow stack, %llu looked up",
+                   stats->return_hits,
+                   stats->return_misses);
+    CHIP8_LOG_INFO("%llu computed jumps found their block in the inline cache, %llu missed",
+                   stats->jump_hits,
+                   stats->jump_misses);
+    CHIP8_LOG_INFO("%llu writes to code pages, %llu blocks loaded from the cache directory",
+                   atomic_load(&cache->stats.code_writes),
+                   atomic_load(&cache->stats.loaded));
+    if (cache->timing)
+    {
+        double frequency = SDL_GetPerformanceFrequency();
+        CHIP8_LOG_INFO("%.3f s interpreting, %.3f s in blocks",
+                       stats->interpreter_ticks / frequency,
+                       stats->block_ticks / frequency);
+    }
+}
+
+/**
+ * @brief Save the blocks of the ROM for the next run, then drop the reference on their cache.
+ * 
+ * @param cache Pointer to the shared chip8_block_cache struct of the ROM, or NULL.
+ * @param directory The cache directory, NULL when the blocks are not kept.
+ * @return Void.
+ */
+static void save_blocks(struct chip8_block_cache* cache, const char* directory)
+{
+    if (cache && directory)
+    {
+        chip8_block_cache_save(cache, directory);
+    }
+    chip8_block_cache_release(cache);
+}
+
+/**
+ * @brief Emulate one frame with the input received so far and publish its screen.
+ * 
+ * @param emulation Pointer to the emulation struct.
+ * @return Void.
+ */
+static void emulate_frame(struct emulation* emulation)
+{
+    struct chip8* chip8 = emulation->chip8;
+    struct chip8_stats stats = chip8->stats;
+
+    uint64_t start = chip8_profile_begin(&profile);
+    if (emulation->measure_latency || chip8_trace_is_enabled(&trace))
+    {
+        for (int i = 0 ; i < CHIP8_INSTRUCTIONS_PER_FRAME ; i++)
+        {
+            /* Apply the pending key events before the next instruction */
+            apply_key_events(emulation);
+
+            /* Execute the next instruction, recording it if tracing is enabled */
+            chip8_trace_step(&trace, chip8);
+            if (emulation->measure_latency)
+            {
+                chip8_latency_exec(&latency, chip8);
+            }
+        }
+    }
+    else
+    {
+        /* Nothing watches single instructions, the whole frame can run in blocks */
+        apply_key_events(emulation);
+        chip8_run(chip8, CHIP8_INSTRUCTIONS_PER_FRAME);
+    }
+
+    chip8_profile_end(&profile, emulation_track, "execute", start);
+
+    /* Work done by the frame, before run-ahead adds its speculative frames */
+    chip8_profile_counter(&profile, emulation_track, "instructions", chip8->stats.instructions - stats.instructions);
+    chip8_profile_counter(&profile, emulation_track, "sprites", chip8->stats.sprites - stats.sprites);
+    chip8_profile_counter(&profile, emulation_track, "collisions", chip8->stats.collisions - stats.collisions);
+
+    /* The delay and sound timers count down at the frame rate */
+    start = chip8_profile_begin(&profile);
+    chip8_tick_timers(chip8);
+    chip8_profile_end(&profile, emulation_track, "timers", start);
+
+    /* Beep for a certain time defined by the sound timer register value */
+    if (chip8->registers.sound_timer > 0)
+    {
+        start = chip8_profile_begin(&profile);
+        Beep(15000, 10 * chip8->registers.sound_timer);
+        chip8->registers.sound_timer = 0;
+        chip8_profile_end(&profile, emulation_track, "audio", start);
+    }
+
+    /*
+     Run ahead: run the next frames with the current input and show the last one,
+     then go back to the real state. The game reacts to input run_ahead frames earlier.
     */
-    if (argc < 2)
+    if (emulation->run_ahead > 0)
     {
-        printf("You must provide a file to load \n");
-        return -1;
+        start = chip8_profile_begin(&profile);
+        chip8_snapshot(&run_ahead_snapshot, chip8);
+        for (int i = 0 ; i < emulation->run_ahead ; i++)
+        {
+            chip8_run_frame(chip8, CHIP8_INSTRUCTIONS_PER_FRAME);
+        }
+        *chip8_triple_buffer_back(&frames) = chip8->screen;
+        chip8_restore(chip8, &run_ahead_snapshot);
+        chip8_profile_end(&profile, emulation_track, "run-ahead", start);
+    }
+    else
+    {
+        *chip8_triple_buffer_back(&frames) = chip8->screen;
     }
 
+    chip8_triple_buffer_publish(&frames);
+}
+
+/**
+ * @brief Entry point of the emulation thread: emulate frames at 60 Hz until the presenter stops it.
+ * 
+ * @param data Pointer to the emulation struct.
+ * @return int Always 0.
+ */
+static int emulation_thread(void* data)
+{
+    struct emulation* emulation = data;
+
     /*
-     Store the filename and then open it in binary read mode.
+     Time at which the next frame is due, in performance counter ticks. A frame lasts
+     frequency / 60 ticks plus the remainder carried from frame to frame, so the frames
+     keep exactly 60 Hz on average.
+    */
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    uint64_t next_frame = SDL_GetPerformanceCounter();
+    uint64_t remainder = 0;
+
+    while (atomic_load(&emulation->running))
+    {
+        emulate_frame(emulation);
+
+        next_frame += frequency / CHIP8_FRAMES_PER_SECOND;
+        remainder += frequency % CHIP8_FRAMES_PER_SECOND;
+        if (remainder >= CHIP8_FRAMES_PER_SECOND)
+        {
+            next_frame += 1;
+            remainder -= CHIP8_FRAMES_PER_SECOND;
+        }
+
+        /* Wait until the next frame is due, unless the emulator is running late */
+        uint64_t now = SDL_GetPerformanceCounter();
+        if (now >= next_frame)
+        {
+            next_frame = now;
+        }
+        else
+        {
+            SDL_Delay((Uint32) ((next_frame - now) * 1000 / frequency));
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Load a program from its own file.
+ * 
+ * @param chip8 Pointer to the chip8 struct instance.
+ * @param filename Path of the ROM file.
+ * @return bool True if the program has been loaded.
+ */
+static bool load_rom_file(struct chip8* chip8, const char* filename)
+{
+    /* A program never exceeds the memory that follows the load address */
+    static char buffer[CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_LOAD_ADDRESS];
+
+    /*
+     Open the file in binary read mode.
      If the program fails to open the file, then it will terminate.
     */
-    const char* filename = argv[1];
-    printf("The filename to load is: %s\n", filename);
+    CHIP8_LOG_INFO("The filename to load is: %s", filename);
     FILE* f = fopen(filename, "rb");
     if (!f)
     {
-        printf("Failed to open the file");
-        return -1;
+        CHIP8_LOG_ERROR("Failed to open the file %s", filename);
+        return false;
     }
 
     /* Set the cursor at the end of the file */
@@ -46,137 +394,463 @@ int main(int argc, char** argv)
     /* Return the cursor to the beginning of the file */
     fseek(f, 0, SEEK_SET);
 
+    if (size <= 0 || size >= (long) sizeof(buffer))
+    {
+        CHIP8_LOG_ERROR("The file %s does not fit in memory (%ld bytes)", filename, size);
+        fclose(f);
+        return false;
+    }
+
     /*
      Read the file and store its content in a buffer.
      If the program fails to read the file, it will terminate.
     */
-    char buffer[size];
     int res = fread(buffer, size, 1, f);
+    fclose(f);
     if (res != 1)
     {
-        printf("Failed to read from file");
+        CHIP8_LOG_ERROR("Failed to read from file %s", filename);
+        return false;
+    }
+    CHIP8_LOG_INFO("Loaded %ld bytes", size);
+
+    chip8_load(chip8, buffer, size);
+    return true;
+}
+
+/**
+ * @brief Load a program from a ROM pack, copying its image straight from the mapping.
+ * 
+ * @param chip8 Pointer to the chip8 struct instance.
+ * @param pack_filename Path of the ROM pack.
+ * @param name Name of the ROM inside the pack.
+ * @return bool True if the program has been loaded.
+ */
+static bool load_rom_from_pack(struct chip8* chip8, const char* pack_filename, const char* name)
+{
+    struct chip8_rompack pack;
+    if (!chip8_rompack_open(&pack, pack_filename))
+    {
+        return false;
+    }
+
+    const struct chip8_rompack_entry* entry = chip8_rompack_find(&pack, name);
+    if (!entry)
+    {
+        CHIP8_LOG_ERROR("The ROM %s is not in the pack %s", name, pack_filename);
+        chip8_rompack_close(&pack);
+        return false;
+    }
+
+    chip8_rompack_load(&pack, entry, chip8);
+    CHIP8_LOG_INFO("Loaded %s from the pack (%u bytes, uses %x, quirk profile %x)", name, entry->size, entry->uses, entry->quirks);
+    chip8_rompack_close(&pack);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    /* 
+    Verify that a filename has been provided before running the program.
+    If no filename is received, the program will be terminated.                    
+    */
+    if (argc < 2)
+    {
+        printf("You must provide a file to load \n");
         return -1;
     }
 
-    struct chip8 chip8;
+    /* Store the filename, which is the name of the ROM when a pack is given */
+    const char* filename = argv[1];
+
+    /* Parse the options that follow the filename */
+    bool measure_latency = false;
+    int run_ahead = 0;
+    const char* trace_filename = NULL;
+    const char* profile_filename = NULL;
+    const char* pack_filename = NULL;
+    bool use_blocks = true;
+    const char* shared_name = NULL;
+    const char* block_directory = NULL;
+    int instances = 1;
+    /* Overrides the quirk profile a ROM pack gives to its ROM */
+    unsigned int quirks = 0;
+    bool quirks_given = false;
+    bool software = false;
+    bool use_terminal = false;
+    enum chip8_terminal_cells terminal_cells = CHIP8_TERMINAL_HALF_BLOCKS;
+    int scale = CHIP8_WINDOW_SCALE;
+    enum chip8_log_level log_level = CHIP8_LOG_LEVEL_INFO;
+    bool log_level_given = false;
+    for (int i = 2 ; i < argc ; i++)
+    {
+        if (strcmp(argv[i], "--latency") == 0)
+        {
+            measure_latency = true;
+        }
+        else if (strcmp(argv[i], "--no-blocks") == 0)
+        {
+            use_blocks = false;
+        }
+        else if (strcmp(argv[i], "--software") == 0)
+        {
+            software = true;
+        }
+        else if (strcmp(argv[i], "--terminal") == 0 && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            use_terminal = true;
+            if (strcmp(name, "half") == 0)
+            {
+                terminal_cells = CHIP8_TERMINAL_HALF_BLOCKS;
+            }
+            else if (strcmp(name, "braille") == 0)
+            {
+                terminal_cells = CHIP8_TERMINAL_BRAILLE;
+            }
+            else
+            {
+                printf("The terminal cells must be half or braille\n");
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+        {
+            scale = atoi(argv[++i]);
+            if (scale < 1 || scale > CHIP8_MAX_WINDOW_SCALE)
+            {
+                printf("The scale must be between 1 and %d\n", CHIP8_MAX_WINDOW_SCALE);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--block-cache") == 0 && i + 1 < argc)
+        {
+            block_directory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc)
+        {
+            if (!chip8_isa_parse_quirks(argv[++i], &quirks))
+            {
+                printf("The quirks must be modern, cosmac, schip, shift-vy, load-store-i, vf-reset, clip or jump-vx, separated by commas\n");
+                return -1;
+            }
+            quirks_given = true;
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            trace_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            profile_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc)
+        {
+            pack_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--shared") == 0 && i + 1 < argc)
+        {
+            shared_name = argv[++i];
+        }
+        else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+        {
+            instances = atoi(argv[++i]);
+            if (instances < 1 || instances > CHIP8_SHARED_MAX_INSTANCES)
+            {
+                printf("The number of instances must be between 1 and %d\n", CHIP8_SHARED_MAX_INSTANCES);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            for (log_level = CHIP8_LOG_LEVEL_DEBUG ; log_level < CHIP8_LOG_LEVEL_NONE ; log_level++)
+            {
+                if (strcmp(name, log_level_names[log_level]) == 0)
+                {
+                    break;
+                }
+            }
+            if (log_level == CHIP8_LOG_LEVEL_NONE && strcmp(name, "none") != 0)
+            {
+                printf("The log level must be debug, info, warning, error or none\n");
+                return -1;
+            }
+            log_level_given = true;
+        }
+        else if (strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc)
+        {
+            run_ahead = atoi(argv[++i]);
+            if (run_ahead < 0 || run_ahead > CHIP8_MAX_RUN_AHEAD_FRAMES)
+            {
+                printf("The run-ahead must be between 0 and %d frames\n", CHIP8_MAX_RUN_AHEAD_FRAMES);
+                return -1;
+            }
+        }
+        else
+        {
+            printf("Unknown option: %s\n", argv[i]);
+            return -1;
+        }
+    }
+
+    /*
+     From now on the messages are written by the logging thread, away from the frames drawn on the terminal.
+     Over SSH stderr is the same terminal, so only errors are written there unless asked otherwise.
+    */
+    if (use_terminal && !log_level_given)
+    {
+        log_level = CHIP8_LOG_LEVEL_ERROR;
+    }
+    chip8_log_set_level(log_level);
+    chip8_log_start(use_terminal ? stderr : stdout);
+
+    /* Shared with the emulation thread, it must outlive it */
+    static struct chip8 chip8;
 
     /* Initialize the chip8 instance */
     chip8_init(&chip8);
+    chip8_set_sprite_cache(&chip8, &sprite_cache);
 
-    /* Load the program (the file read above) into memory */
-    chip8_load(&chip8, buffer, size);
+    /* Load the program, either from the pack or from its own file */
+    bool loaded = pack_filename ? load_rom_from_pack(&chip8, pack_filename, filename) : load_rom_file(&chip8, filename);
+    if (!loaded)
+    {
+        chip8_log_stop();
+        return -1;
+    }
+    if (quirks_given)
+    {
+        chip8_set_quirks(&chip8, quirks);
+    }
+
+    /*
+     Hot code is pre-decoded in the background into the shared cache of the ROM, so the blocks
+     always hold the code of the ROM image and can be saved for the next run even when
+     the program writes its code. The reference kept here outlives the instances.
+    */
+    struct chip8_block_cache* block_cache = use_blocks ? chip8_block_cache_shared(&chip8.memory) : NULL;
+    if (block_cache)
+    {
+        block_cache->timing = profile_filename != NULL;
+        if (block_directory)
+        {
+            chip8_block_cache_load(block_cache, block_directory);
+        }
+        chip8_set_block_cache(&chip8, block_cache);
+        chip8_block_compiler_start();
+    }
+
+    /* Headless mode, the instances are driven by another process through shared memory */
+    if (shared_name)
+    {
+        struct chip8_shared shared;
+        int res = chip8_shared_create(&shared, shared_name, instances) ? 0 : -1;
+        if (res == 0)
+        {
+            chip8_shared_serve(&shared, &chip8, SDL_GetCPUCount());
+            chip8_shared_close(&shared);
+        }
+        chip8_block_compiler_stop();
+        save_blocks(block_cache, block_directory);
+        chip8_free(&chip8);
+        chip8_block_registry_clear();
+        chip8_log_stop();
+        return res;
+    }
 
     chip8_keyboard_set_map(&chip8.keyboard, keyboard_map);
+    chip8_keyboard_queue_init(&keyboard_queue);
+    chip8_latency_init(&latency);
+    chip8_trace_init(&trace);
+    chip8_profile_init(&profile, profile_filename != NULL);
+    presenter_track = chip8_profile_track(&profile, 0, "presenter");
+    emulation_track = chip8_profile_track(&profile, 1, "emulation");
+
+    /* Initialize the SDL library, without video on the terminal, where only the events are used to quit */
+    SDL_Init(use_terminal ? SDL_INIT_EVENTS | SDL_INIT_TIMER : SDL_INIT_EVERYTHING);
+
+    SDL_Window* window = NULL;
+    SDL_Renderer* renderer = NULL;
+    SDL_Surface* canvas = NULL;
+    if (use_terminal)
+    {
+#ifdef SIGPIPE
+        /* A dropped session makes the writes fail with EPIPE instead of killing the emulator */
+        signal(SIGPIPE, SIG_IGN);
+#endif
+        if (!chip8_terminal_open(&terminal, fileno(stdout), terminal_cells))
+        {
+            CHIP8_LOG_ERROR("Failed to write to the terminal");
+            chip8_block_compiler_stop();
+            chip8_block_cache_release(block_cache);
+            chip8_log_stop();
+            return -1;
+        }
+    }
+    else
+    {
+        /* Create a window displaying the Chip-8 screen with its dimesions scaled */
+        window = SDL_CreateWindow(
+            EMULATOR_WINDOW_TITLE,
+            SDL_WINDOWPOS_UNDEFINED,
+            SDL_WINDOWPOS_UNDEFINED,
+            CHIP8_WIDTH * scale,
+            CHIP8_HEIGHT * scale,
+            SDL_WINDOW_SHOWN
+        );
+    }
+
+    /*
+     Create a 2D rendering context for a window, or with --software a canvas the frames are
+     rendered into, which does not depend on an accelerated renderer
+    */
+    if (window && software)
+    {
+        canvas = SDL_CreateRGBSurfaceWithFormat(0, CHIP8_WIDTH * scale, CHIP8_HEIGHT * scale, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (!canvas)
+        {
+            CHIP8_LOG_ERROR("Failed to create the software canvas, using the renderer: %s", SDL_GetError());
+        }
+    }
+    if (window && !canvas)
+    {
+        renderer = SDL_CreateRenderer(
+            window,
+            -1,
+            SDL_TEXTUREACCESS_TARGET
+        );
+    }
+
+    /* With a trace file, tracing starts right away and the records are spilled in the background */
+    if (trace_filename)
+    {
+        if (!chip8_trace_open(&trace, trace_filename))
+        {
+            CHIP8_LOG_ERROR("Failed to create the trace file %s", trace_filename);
+            chip8_block_compiler_stop();
+            chip8_block_cache_release(block_cache);
+            chip8_log_stop();
+            return -1;
+        }
+        chip8_trace_set_enabled(&trace, true);
+    }
 
-    /* Initialize the SDL library */
-    SDL_Init(SDL_INIT_EVERYTHING);
-
-    /* Create a window displaying the Chip-8 screen with its dimesions scaled */
-    SDL_Window* window = SDL_CreateWindow(
-        EMULATOR_WINDOW_TITLE,
-        SDL_WINDOWPOS_UNDEFINED,
-        SDL_WINDOWPOS_UNDEFINED,
-        CHIP8_WIDTH * CHIP8_WINDOW_SCALE,
-        CHIP8_HEIGHT * CHIP8_WINDOW_SCALE,
-        SDL_WINDOW_SHOWN
-    );
-
-    /* Create a 2D rendering context for a window */
-    SDL_Renderer* renderer = SDL_CreateRenderer(
-        window,
-        -1,
-        SDL_TEXTUREACCESS_TARGET
-    );
+    /* The emulation runs on its own thread, this thread handles the input and presents the frames */
+    chip8_triple_buffer_init(&frames);
+    struct emulation emulation;
+    emulation.chip8 = &chip8;
+    emulation.run_ahead = run_ahead;
+    emulation.measure_latency = measure_latency;
+    atomic_init(&emulation.running, true);
+    SDL_Thread* thread = SDL_CreateThread(emulation_thread, "emulation", &emulation);
 
     while(1)
     {
         SDL_Event event;
 
-        /* Poll for currently pending events */
-        while (SDL_PollEvent(&event))
+        /* Wait shortly for events so the thread sleeps between frames, then drain the pending ones */
+        if (SDL_WaitEventTimeout(&event, 1))
         {
-            switch (event.type)
+            uint64_t start = chip8_profile_begin(&profile);
+            do
             {
-                /* Terminate the program */
-                case SDL_QUIT:
-                    goto out;
-                break;
-
-                /* A key has ben pressed */
-                case SDL_KEYDOWN:
+                switch (event.type)
                 {
-                    char key = event.key.keysym.sym;
-                    int virtual_key = chip8_keyboard_map(&chip8.keyboard, key);
-                    if (virtual_key != -1)
-                    {
-                        chip8_keyboard_down(&chip8.keyboard, virtual_key);
-                    }
-                }
-                break;
+                    /* Terminate the program, closing the span so that the profile ends with it */
+                    case SDL_QUIT:
+                        chip8_profile_end(&profile, presenter_track, "poll events", start);
+                        goto out;
+                    break;
 
-                /* A key has been released */
-                case SDL_KEYUP:
-                {
-                    char key = event.key.keysym.sym;
-                    int virtual_key = chip8_keyboard_map(&chip8.keyboard, key);
-                    if (virtual_key != -1)
-                    {
-                        chip8_keyboard_up(&chip8.keyboard, virtual_key);
-                    }
+                    /* A key has been pressed or released */
+                    case SDL_KEYDOWN:
+                    case SDL_KEYUP:
+                        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F1 && !event.key.repeat)
+                        {
+                            chip8_trace_set_enabled(&trace, !chip8_trace_is_enabled(&trace));
+                            CHIP8_LOG_INFO("Tracing %s", chip8_trace_is_enabled(&trace) ? "enabled" : "disabled");
+                        }
+                        queue_key_event(&chip8, &event.key);
+                    break;
                 }
-                break;
-            }
+            } while (SDL_PollEvent(&event));
+            chip8_profile_end(&profile, presenter_track, "poll events", start);
         }
 
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
-        SDL_RenderClear(renderer);
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 0);
-        
-
-        for (int x = 0 ; x < CHIP8_WIDTH ; x++)
+        /* Present the most recent frame, a blocking present only delays this thread */
+        if (chip8_triple_buffer_acquire(&frames))
         {
-            for (int y = 0 ; y < CHIP8_HEIGHT ; y++)
+            const struct chip8_screen* screen = chip8_triple_buffer_front(&frames);
+            if (use_terminal)
             {
-                /* Check if a pixel has to be drawn */
-                if ( chip8_screen_is_set(&chip8.screen, x, y) )
+                uint64_t start = chip8_profile_begin(&profile);
+                bool presented = chip8_terminal_present(&terminal, screen);
+                chip8_profile_end(&profile, presenter_track, "present", start);
+                if (!presented)
                 {
-                    /* Draw a rectangle symbolizing a pixel */
-                    SDL_Rect r;
-                    r.x = x * CHIP8_WINDOW_SCALE;
-                    r.y = y * CHIP8_WINDOW_SCALE;
-                    r.w = CHIP8_WINDOW_SCALE;
-                    r.h = CHIP8_WINDOW_SCALE;
-                    SDL_RenderFillRect(renderer, &r);
+                    /* Nobody is watching any more, typically a dropped SSH session */
+                    CHIP8_LOG_ERROR("Failed to write to the terminal, stopping");
+                    goto out;
                 }
             }
+            else if (canvas)
+            {
+                render_screen_software(window, canvas, screen, scale);
+            }
+            else
+            {
+                render_screen(renderer, screen, scale);
+            }
+            if (measure_latency)
+            {
+                chip8_latency_present(&latency, screen);
+            }
         }
-        
-        /* Update the screen */
-        SDL_RenderPresent(renderer);
+    }
 
-        /* Delay the program according to the delay_timer register value */
-        if (chip8.registers.delay_timer > 0)
-        {
-            Sleep(1);
-            chip8.registers.delay_timer -= 1;
-        }
+out:
+    atomic_store(&emulation.running, false);
+    SDL_WaitThread(thread, NULL);
 
-        /* Beep for a certain time defined by the sound timer register value */
-        if (chip8.registers.sound_timer > 0)
-        {
-            Beep(15000, 10 * chip8.registers.sound_timer);
-            chip8.registers.sound_timer = 0;
-        }
+    /* Without a trace file, the records of the ring buffer are saved when leaving */
+    if (trace_filename)
+    {
+        chip8_trace_close(&trace);
+    }
+    else if (atomic_load(&trace.head) > 0)
+    {
+        chip8_trace_dump(&trace, CHIP8_TRACE_DEFAULT_FILE);
+    }
+    SDL_FreeSurface(canvas);
+    if (window)
+    {
+        SDL_DestroyWindow(window);
+    }
+    if (use_terminal)
+    {
+        chip8_terminal_close(&terminal);
+        CHIP8_LOG_INFO("Terminal: %llu bytes written for %llu frames",
+                       (unsigned long long) terminal.bytes, (unsigned long long) terminal.frames);
+    }
+    report_tiers(&chip8);
+    chip8_block_compiler_stop();
+    save_blocks(block_cache, block_directory);
+    chip8_free(&run_ahead_snapshot);
+    chip8_free(&chip8);
+    chip8_block_registry_clear();
+
+    if (measure_latency)
+    {
+        chip8_latency_report(&latency, stdout);
+    }
 
-        /* Get the current opcode to execute */
-        unsigned short opcode = chip8_memory_get_short(&chip8.memory, chip8.registers.PC);
-        printf("%x\n", opcode);
-        chip8.registers.PC += 2;
-        chip8_exec(&chip8, opcode);
+    if (profile_filename && !chip8_profile_write(&profile, profile_filename))
+    {
+        CHIP8_LOG_ERROR("Failed to write the profile %s", profile_filename);
     }
 
-out:
-    SDL_DestroyWindow(window);
+    chip8_log_stop();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "chip8isa.h"
+
+/* Largest ROM that fits in memory after the load address */
+#define MAX_ROM_SIZE (CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_LOAD_ADDRESS - 1)
+
+/*
+    Assembles a ROM from one instruction per line, written as chip8tracedump disassembles them.
+    Anything after a ';' is a comment, and DW writes any 16-bit word, such as sprite data.
+    There are no labels: addresses are written as numbers.
+*/
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        printf("Usage: %s <source file> <ROM file>\n", argv[0]);
+        return -1;
+    }
+
+    FILE* in = fopen(argv[1], "r");
+    if (!in)
+    {
+        printf("Failed to open the file %s\n", argv[1]);
+        return -1;
+    }
+
+    static unsigned char rom[MAX_ROM_SIZE];
+    size_t size = 0;
+    char line[256];
+    int number = 0;
+    int errors = 0;
+    while (fgets(line, sizeof(line), in))
+    {
+        number++;
+        char* comment = strchr(line, ';');
+        if (comment)
+        {
+            *comment = '\0';
+        }
+        if (strspn(line, " \t\r\n") == strlen(line))
+        {
+            continue;
+        }
+
+        unsigned short opcode;
+        if (!chip8_isa_assemble(line, &opcode))
+        {
+            line[strcspn(line, "\r\n")] = '\0';
+            printf("%s:%d: not an instruction: %s\n", argv[1], number, line);
+            errors++;
+            continue;
+        }
+        if (size + 2 > MAX_ROM_SIZE)
+        {
+            printf("%s:%d: the ROM is larger than %d bytes\n", argv[1], number, MAX_ROM_SIZE);
+            fclose(in);
+            return -1;
+        }
+        rom[size++] = opcode >> 8;
+        rom[size++] = opcode & 0xff;
+    }
+    fclose(in);
+    if (errors > 0)
+    {
+        return -1;
+    }
+
+    FILE* out = fopen(argv[2], "wb");
+    if (!out || fwrite(rom, 1, size, out) != size)
+    {
+        printf("Failed to write the file %s\n", argv[2]);
+        return -1;
+    }
+    fclose(out);
+    printf("Assembled %zu bytes\n", size);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,444 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "SDL2/SDL.h"
+#include "chip8.h"
+#include "chip8hash.h"
+#include "chip8log.h"
+
+/*
+    Breadth-first search over keypad inputs. Every step holds one key (or none)
+    for a number of frames, starting from each state of the frontier. A state
+    is expanded the first time its hash is seen, so the search only grows with
+    the number of distinct states.
+*/
+
+/* Largest ROM that fits in memory after the load address */
+#define MAX_ROM_SIZE (CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_LOAD_ADDRESS - 1)
+#define MAX_THREADS 64
+/* Action 0 holds no key, action k holds the virtual key k - 1 */
+#define MAX_ACTIONS (CHIP8_TOTAL_KEYS + 1)
+#define NO_NODE 0xffffffff
+
+struct options
+{
+    int depth;
+    int threads;
+    int frames_per_step;
+    int level_address;
+    uint32_t max_states;
+    uint32_t max_frontier;
+    uint32_t seed;
+    int actions[MAX_ACTIONS];
+    int total_actions;
+};
+
+/* How a state has been reached: the state it comes from and the action taken */
+struct node
+{
+    uint32_t parent;
+    unsigned char action;
+};
+
+/* A state waiting to be expanded */
+struct frontier_entry
+{
+    struct chip8 chip8;
+    uint32_t node;
+};
+
+struct explorer
+{
+    const struct options* options;
+    struct node* nodes;
+    _Atomic uint32_t total_nodes;
+    struct chip8_state_set states;
+    struct chip8_state_set screens;
+    struct frontier_entry* current;
+    uint32_t current_size;
+    _Atomic uint32_t next_entry;
+    struct frontier_entry* next;
+    _Atomic uint32_t next_size;
+    _Atomic uint64_t frames;
+    _Atomic uint64_t truncated;
+    /* First node reaching each value of the level byte, NO_NODE until then */
+    _Atomic uint32_t levels[256];
+};
+
+/**
+ * @brief Play one action from a state: hold its key for the frames of a step.
+ * 
+ * @param chip8 Pointer to the chip8 struct to advance.
+ * @param action The action, 0 for no key.
+ * @param frames Number of frames to run.
+ * @return Void.
+ */
+static void play(struct chip8* chip8, int action, int frames)
+{
+    if (action > 0)
+    {
+        chip8_keyboard_down(&chip8->keyboard, action - 1);
+    }
+    for (int i = 0 ; i < frames ; i++)
+    {
+        chip8_run_frame(chip8, CHIP8_INSTRUCTIONS_PER_FRAME);
+    }
+    if (action > 0)
+    {
+        chip8_keyboard_up(&chip8->keyboard, action - 1);
+    }
+}
+
+/**
+ * @brief Record a state that has not been seen before and queue it for the next depth.
+ * 
+ * @param explorer Pointer to the explorer struct.
+ * @param chip8 Pointer to the new state, owned by the frontier if it is queued.
+ * @param parent Node of the state it comes from.
+ * @param action Action taken from the parent.
+ * @return bool True if the state has been queued.
+ */
+static bool discover(struct explorer* explorer, struct chip8* chip8, uint32_t parent, int action)
+{
+    uint32_t id = atomic_fetch_add_explicit(&explorer->total_nodes, 1, memory_order_relaxed);
+    if (id >= explorer->options->max_states)
+    {
+        atomic_fetch_add_explicit(&explorer->truncated, 1, memory_order_relaxed);
+        return false;
+    }
+    explorer->nodes[id].parent = parent;
+    explorer->nodes[id].action = action;
+
+    chip8_state_set_insert(&explorer->screens, chip8->screen.hash);
+    if (explorer->options->level_address >= 0)
+    {
+        unsigned char level = chip8_memory_get(&chip8->memory, explorer->options->level_address);
+        uint32_t none = NO_NODE;
+        atomic_compare_exchange_strong_explicit(&explorer->levels[level], &none, id,
+                                                memory_order_relaxed, memory_order_relaxed);
+    }
+
+    uint32_t slot = atomic_fetch_add_explicit(&explorer->next_size, 1, memory_order_relaxed);
+    if (slot >= explorer->options->max_frontier)
+    {
+        atomic_fetch_add_explicit(&explorer->truncated, 1, memory_order_relaxed);
+        return false;
+    }
+    explorer->next[slot].chip8 = *chip8;
+    explorer->next[slot].node = id;
+    return true;
+}
+
+/**
+ * @brief Expand the entries of the current frontier until none is left.
+ * 
+ * @param data Pointer to the explorer struct.
+ * @return int 0.
+ */
+static int worker(void* data)
+{
+    struct explorer* explorer = data;
+    const struct options* options = explorer->options;
+    struct chip8 child;
+
+    for (;;)
+    {
+        uint32_t index = atomic_fetch_add_explicit(&explorer->next_entry, 1, memory_order_relaxed);
+        if (index >= explorer->current_size)
+        {
+            break;
+        }
+
+        struct frontier_entry* entry = &explorer->current[index];
+        for (int i = 0 ; i < options->total_actions ; i++)
+        {
+            chip8_fork(&child, &entry->chip8);
+            play(&child, options->actions[i], options->frames_per_step);
+
+            if (!chip8_state_set_insert(&explorer->states, chip8_state_hash(&child)) ||
+                !discover(explorer, &child, entry->node, options->actions[i]))
+            {
+                chip8_free(&child);
+            }
+        }
+        atomic_fetch_add_explicit(&explorer->frames,
+                                  (uint64_t) options->total_actions * options->frames_per_step,
+                                  memory_order_relaxed);
+        chip8_free(&entry->chip8);
+    }
+    return 0;
+}
+
+/**
+ * @brief Print the actions leading to a node, one character per step ('-' for no key).
+ * 
+ * @param explorer Pointer to the explorer struct.
+ * @param id The node.
+ * @return Void.
+ */
+static void print_solution(const struct explorer* explorer, uint32_t id)
+{
+    char path[4096];
+    int length = 0;
+    for (uint32_t node = id ; explorer->nodes[node].parent != NO_NODE ; node = explorer->nodes[node].parent)
+    {
+        if (length < (int) sizeof(path) - 1)
+        {
+            int action = explorer->nodes[node].action;
+            path[length++] = action == 0 ? '-' : "0123456789ABCDEF"[action - 1];
+        }
+    }
+    if (length == 0)
+    {
+        printf("(no input)");
+    }
+    for (int i = length - 1 ; i >= 0 ; i--)
+    {
+        putchar(path[i]);
+    }
+    putchar('\n');
+}
+
+/**
+ * @brief Read a ROM and create the root of the search.
+ * 
+ * @param chip8 Pointer to the chip8 struct receiving the initial state.
+ * @param filename Path of the ROM file.
+ * @param seed Seed of the RND generator.
+ * @return bool True if the ROM has been loaded.
+ */
+static bool load_rom(struct chip8* chip8, const char* filename, uint32_t seed)
+{
+    static char buffer[MAX_ROM_SIZE];
+    FILE* f = fopen(filename, "rb");
+    if (!f)
+    {
+        printf("Failed to open the file %s\n", filename);
+        return false;
+    }
+    size_t size = fread(buffer, 1, sizeof(buffer), f);
+    bool too_large = fgetc(f) != EOF;
+    fclose(f);
+    if (size == 0 || too_large)
+    {
+        printf("The file %s is not a valid ROM\n", filename);
+        return false;
+    }
+
+    chip8_init(chip8);
+    chip8_seed(chip8, seed);
+    chip8_load(chip8, buffer, size);
+    return true;
+}
+
+/**
+ * @brief Parse the command line.
+ * 
+ * @param options Pointer to the options struct to fill.
+ * @param argc Number of arguments.
+ * @param argv The arguments, the first two being the program and the ROM.
+ * @return bool True if the command line is valid.
+ */
+static bool parse_options(struct options* options, int argc, char** argv)
+{
+    const char* keys = "0123456789ABCDEF";
+    options->depth = 8;
+    options->threads = SDL_GetCPUCount();
+    options->frames_per_step = 6;
+    options->level_address = -1;
+    options->max_states = 1 << 20;
+    options->max_frontier = 1 << 15;
+    options->seed = 1;
+
+    for (int i = 2 ; i < argc ; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            printf("Missing value for %s\n", argv[i]);
+            return false;
+        }
+        const char* value = argv[++i];
+        if (strcmp(argv[i - 1], "--depth") == 0)
+        {
+            options->depth = atoi(value);
+        }
+        else if (strcmp(argv[i - 1], "--threads") == 0)
+        {
+            options->threads = atoi(value);
+        }
+        else if (strcmp(argv[i - 1], "--frames") == 0)
+        {
+            options->frames_per_step = atoi(value);
+        }
+        else if (strcmp(argv[i - 1], "--keys") == 0)
+        {
+            keys = value;
+        }
+        else if (strcmp(argv[i - 1], "--level") == 0)
+        {
+            options->level_address = strtol(value, NULL, 16);
+        }
+        else if (strcmp(argv[i - 1], "--max-states") == 0)
+        {
+            options->max_states = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "--max-frontier") == 0)
+        {
+            options->max_frontier = strtoul(value, NULL, 0);
+        }
+        else if (strcmp(argv[i - 1], "--seed") == 0)
+        {
+            options->seed = strtoul(value, NULL, 0);
+        }
+        else
+        {
+            printf("Unknown option: %s\n", argv[i - 1]);
+            return false;
+        }
+    }
+
+    /* Holding no key is always an action */
+    options->actions[0] = 0;
+    options->total_actions = 1;
+    for (const char* key = keys ; *key && options->total_actions < MAX_ACTIONS ; key++)
+    {
+        const char* digit = strchr("0123456789ABCDEF", *key >= 'a' ? *key - 'a' + 'A' : *key);
+        if (!digit)
+        {
+            printf("Invalid key %c\n", *key);
+            return false;
+        }
+        options->actions[options->total_actions++] = digit - "0123456789ABCDEF" + 1;
+    }
+
+    if (options->threads < 1 || options->threads > MAX_THREADS || options->depth < 1 || options->frames_per_step < 1 ||
+        options->level_address >= CHIP8_MEMORY_SIZE || options->max_states == 0 || options->max_frontier == 0)
+    {
+        printf("Invalid options\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <rom> [--depth N] [--frames N] [--threads N] [--keys 0123456789ABCDEF]\n", argv[0]);
+        printf("       [--level address] [--max-states N] [--max-frontier N] [--seed N]\n");
+        return -1;
+    }
+
+    static struct options options;
+    static struct explorer explorer;
+    if (!parse_options(&options, argc, argv))
+    {
+        return -1;
+    }
+    chip8_log_set_level(CHIP8_LOG_LEVEL_ERROR);
+
+    explorer.options = &options;
+    explorer.nodes = malloc(options.max_states * sizeof(struct node));
+    explorer.current = malloc(options.max_frontier * sizeof(struct frontier_entry));
+    explorer.next = malloc(options.max_frontier * sizeof(struct frontier_entry));
+    if (!explorer.nodes || !explorer.current || !explorer.next ||
+        !chip8_state_set_init(&explorer.states, (uint64_t) options.max_states * 2) ||
+        !chip8_state_set_init(&explorer.screens, (uint64_t) options.max_states * 2))
+    {
+        printf("Failed to allocate the search\n");
+        return -1;
+    }
+    for (int i = 0 ; i < 256 ; i++)
+    {
+        atomic_init(&explorer.levels[i], NO_NODE);
+    }
+
+    struct chip8 root;
+    if (!load_rom(&root, argv[1], options.seed))
+    {
+        return -1;
+    }
+
+    /* Every state of the search runs the blocks compiled for the ROM by any of them */
+    struct chip8_block_cache* block_cache = chip8_block_cache_shared(&root.memory);
+    if (block_cache)
+    {
+        chip8_set_block_cache(&root, block_cache);
+        chip8_block_cache_release(block_cache);
+    }
+    chip8_state_set_insert(&explorer.states, chip8_state_hash(&root));
+    atomic_init(&explorer.total_nodes, 0);
+    discover(&explorer, &root, NO_NODE, 0);
+
+    printf("depth  frontier    states   screens    frames/s\n");
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int depth = 1 ; depth <= options.depth && atomic_load(&explorer.next_size) > 0 ; depth++)
+    {
+        /* The states found at the previous depth are expanded now */
+        struct frontier_entry* swap = explorer.current;
+        explorer.current = explorer.next;
+        explorer.next = swap;
+        uint32_t queued = atomic_load(&explorer.next_size);
+        explorer.current_size = queued < options.max_frontier ? queued : options.max_frontier;
+        atomic_store(&explorer.next_size, 0);
+        atomic_store(&explorer.next_entry, 0);
+
+        Uint64 depth_start = SDL_GetPerformanceCounter();
+        uint64_t frames = atomic_load(&explorer.frames);
+        SDL_Thread* threads[MAX_THREADS];
+        for (int i = 0 ; i < options.threads ; i++)
+        {
+            threads[i] = SDL_CreateThread(worker, "explorer", &explorer);
+        }
+        for (int i = 0 ; i < options.threads ; i++)
+        {
+            SDL_WaitThread(threads[i], NULL);
+        }
+
+        double seconds = (double) (SDL_GetPerformanceCounter() - depth_start) / SDL_GetPerformanceFrequency();
+        printf("%5d  %8u  %8llu  %8llu  %10.0f\n", depth, explorer.current_size,
+               (unsigned long long) atomic_load(&explorer.states.count),
+               (unsigned long long) atomic_load(&explorer.screens.count),
+               (atomic_load(&explorer.frames) - frames) / (seconds > 0 ? seconds : 1));
+    }
+    double seconds = (double) (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+    printf("\n%llu distinct states, %llu distinct screens, %llu frames in %.2f s\n",
+           (unsigned long long) atomic_load(&explorer.states.count),
+           (unsigned long long) atomic_load(&explorer.screens.count),
+           (unsigned long long) atomic_load(&explorer.frames), seconds);
+    if (atomic_load(&explorer.truncated) > 0 || atomic_load(&explorer.states.overflows) > 0)
+    {
+        printf("The search has been truncated, raise --max-states or --max-frontier\n");
+    }
+
+    if (options.level_address >= 0)
+    {
+        printf("\nShortest inputs reaching each value of %03X (%d frames per step):\n",
+               options.level_address, options.frames_per_step);
+        for (int i = 0 ; i < 256 ; i++)
+        {
+            uint32_t id = atomic_load(&explorer.levels[i]);
+            if (id != NO_NODE)
+            {
+                printf("%02X: ", i);
+                print_solution(&explorer, id);
+            }
+        }
+    }
+
+    /* The states left in the frontier are not expanded */
+    uint32_t left = atomic_load(&explorer.next_size);
+    for (uint32_t i = 0 ; i < left && i < options.max_frontier ; i++)
+    {
+        chip8_free(&explorer.next[i].chip8);
+    }
+    chip8_state_set_free(&explorer.states);
+    chip8_state_set_free(&explorer.screens);
+    free(explorer.nodes);
+    free(explorer.current);
+    free(explorer.next);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "chip8observation.h"
+
+/* Instances converted by every batch */
+#define BATCH 256
+#define ITERATIONS 200
+
+static struct chip8_observation_history histories[BATCH];
+
+static const char* kernel_names[] = { "auto", "scalar", "sse2", "avx2" };
+
+/**
+ * @brief Fill the histories with random screens.
+ * 
+ * @return Void.
+ */
+static void fill_histories(void)
+{
+    srand(1);
+    for (int i = 0 ; i < BATCH ; i++)
+    {
+        struct chip8_screen screen;
+        for (int f = 0 ; f < CHIP8_OBSERVATION_HISTORY ; f++)
+        {
+            for (int y = 0 ; y < CHIP8_HEIGHT ; y++)
+            {
+                screen.pixels[y] = (uint64_t) rand() << 48 ^ (uint64_t) rand() << 32 ^ (uint64_t) rand() << 16 ^ rand();
+            }
+            if (f == 0)
+            {
+                chip8_observation_reset(&histories[i], &screen);
+            }
+            else
+            {
+                chip8_observation_push(&histories[i], &screen);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Time one configuration with every kernel the processor supports.
+ *        The output of each kernel is checked against the scalar one.
+ * 
+ * @param name Label of the configuration.
+ * @param config Pointer to the configuration.
+ * @return bool True if every kernel produced the same output.
+ */
+static bool bench(const char* name, const struct chip8_observation_config* config)
+{
+    size_t size = chip8_observation_size(config) * BATCH;
+    unsigned char* reference = malloc(size);
+    unsigned char* out = malloc(size);
+    bool same = true;
+
+    for (int kernel = CHIP8_OBSERVATION_KERNEL_SCALAR ; kernel <= CHIP8_OBSERVATION_KERNEL_AVX2 ; kernel++)
+    {
+        if (!chip8_observation_set_kernel(kernel))
+        {
+            printf("%-28s %-6s   unsupported\n", name, kernel_names[kernel]);
+            continue;
+        }
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int i = 0 ; i < ITERATIONS ; i++)
+        {
+            chip8_observation_write(config, histories, BATCH, out);
+        }
+        double seconds = (double) (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+        if (kernel == CHIP8_OBSERVATION_KERNEL_SCALAR)
+        {
+            memcpy(reference, out, size);
+        }
+        bool match = memcmp(reference, out, size) == 0;
+        same &= match;
+        printf("%-28s %-6s %8.1f ns/observation %8.2f GB/s%s\n", name, kernel_names[kernel],
+               seconds * 1e9 / ((double) ITERATIONS * BATCH), (double) size * ITERATIONS / seconds / 1e9,
+               match ? "" : "  MISMATCH");
+    }
+
+    free(reference);
+    free(out);
+    return same;
+}
+
+int main(int argc, char** argv)
+{
+    (void) argc;
+    (void) argv;
+    fill_histories();
+
+    bool same = true;
+    same &= bench("u8 64x32", &(struct chip8_observation_config) { CHIP8_OBSERVATION_U8, 1, false, false });
+    same &= bench("f32 64x32", &(struct chip8_observation_config) { CHIP8_OBSERVATION_F32, 1, false, false });
+    same &= bench("u8 64x32 stack 4 max-pool", &(struct chip8_observation_config) { CHIP8_OBSERVATION_U8, 4, true, false });
+    same &= bench("f32 64x32 stack 4 max-pool", &(struct chip8_observation_config) { CHIP8_OBSERVATION_F32, 4, true, false });
+    same &= bench("f32 32x16 stack 4 max-pool", &(struct chip8_observation_config) { CHIP8_OBSERVATION_F32, 4, true, true });
+
+    chip8_observation_set_kernel(CHIP8_OBSERVATION_KERNEL_AUTO);
+    printf("Default kernel: %s\n", kernel_names[chip8_observation_get_kernel()]);
+    return same ? 0 : -1;
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL2/SDL.h"
+#include "chip8shared.h"
+
+/*
+    Example orchestrator: drives every instance of a shared segment in lockstep
+    with random keys and reports the throughput. The emulator must be started
+    first with --shared <name> --instances N.
+*/
+
+/**
+ * @brief Wait until every instance has run its commands.
+ * 
+ * @param shared Pointer to the mapped segment.
+ * @return Void.
+ */
+static void wait_idle(struct chip8_shared* shared)
+{
+    for (int i = 0 ; i < shared->count ; i++)
+    {
+        while (!chip8_shared_idle(&shared->instances[i]))
+        {
+        }
+    }
+}
+
+/**
+ * @brief Count the lit pixels of the last frame of an instance, reading it in place.
+ * 
+ * @param instance Pointer to the control block of the instance.
+ * @return int Number of lit pixels.
+ */
+static int count_pixels(struct chip8_shared_instance* instance)
+{
+    for (;;)
+    {
+        uint32_t sequence;
+        const struct chip8_shared_frame* frame = chip8_shared_begin_read(instance, &sequence);
+        int lit = 0;
+        for (int y = 0 ; y < CHIP8_HEIGHT ; y++)
+        {
+            lit += __builtin_popcountll(frame->pixels[y]);
+        }
+        if (chip8_shared_end_read(frame, sequence))
+        {
+            return lit;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <name> [steps] [frames per step] [--keep]\n", argv[0]);
+        return -1;
+    }
+    int steps = argc > 2 ? atoi(argv[2]) : 600;
+    int frames = argc > 3 ? atoi(argv[3]) : 1;
+    bool keep = argc > 4 && strcmp(argv[4], "--keep") == 0;
+
+    struct chip8_shared shared;
+    if (!chip8_shared_open(&shared, argv[1]))
+    {
+        return -1;
+    }
+    uint32_t count = shared.count;
+    printf("%u instances\n", count);
+
+    srand(1);
+    for (uint32_t i = 0 ; i < count ; i++)
+    {
+        chip8_shared_push(&shared.instances[i], CHIP8_SHARED_COMMAND_RESET, 0);
+        chip8_shared_push(&shared.instances[i], CHIP8_SHARED_COMMAND_SEED, i + 1);
+    }
+    wait_idle(&shared);
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int step = 0 ; step < steps ; step++)
+    {
+        for (uint32_t i = 0 ; i < count ; i++)
+        {
+            atomic_store_explicit(&shared.instances[i].keypad, rand() % 4 == 0 ? 1 << (rand() % CHIP8_TOTAL_KEYS) : 0,
+                                  memory_order_relaxed);
+            chip8_shared_push(&shared.instances[i], CHIP8_SHARED_COMMAND_STEP, frames);
+        }
+        wait_idle(&shared);
+    }
+    double seconds = (double) (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+    long long lit = 0;
+    for (uint32_t i = 0 ; i < count ; i++)
+    {
+        lit += count_pixels(&shared.instances[i]);
+    }
+    printf("%d steps in %.3f s, %.1f us per lockstep round, %.0f frames/s, %lld lit pixels\n",
+           steps, seconds, seconds * 1e6 / steps, (double) steps * frames * count / seconds, lit);
+    printf("Instance 0 is at frame %llu\n", (unsigned long long) atomic_load(&shared.instances[0].frames));
+
+    if (!keep)
+    {
+        atomic_store_explicit(&shared.header->stop, 1, memory_order_release);
+    }
+    chip8_shared_close(&shared);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "chip8rompack.h"
+#include "chip8isa.h"
+
+/* Largest ROM that fits in memory after the load address */
+#define MAX_ROM_SIZE (CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_LOAD_ADDRESS - 1)
+/* Longest path of a ROM file */
+#define MAX_PATH_SIZE 4096
+/* Suffix of the file next to a ROM naming its quirk profile, as given to --quirks */
+#define QUIRKS_SUFFIX ".quirks"
+
+/* A ROM read from the directory */
+struct rom
+{
+    struct chip8_rompack_entry entry;
+    unsigned char data[MAX_ROM_SIZE];
+};
+
+/**
+ * @brief Order the ROMs by name, as required by the index.
+ */
+static int compare_roms(const void* a, const void* b)
+{
+    return strcmp(((const struct rom*) a)->entry.name, ((const struct rom*) b)->entry.name);
+}
+
+/**
+ * @brief Read the quirk profile of a ROM from the file next to it, the profile is modern without one.
+ * 
+ * @param path Path of the ROM.
+ * @param quirks Receives the CHIP8_QUIRK_* flags.
+ * @return int 1 if the profile has been read, 0 if the file holds no valid profile.
+ */
+static int read_quirks(const char* path, uint32_t* quirks)
+{
+    char filename[MAX_PATH_SIZE + sizeof(QUIRKS_SUFFIX)];
+    snprintf(filename, sizeof(filename), "%s%s", path, QUIRKS_SUFFIX);
+    *quirks = 0;
+    FILE* f = fopen(filename, "r");
+    if (!f)
+    {
+        return 1;
+    }
+
+    char text[256] = { 0 };
+    unsigned int profile = 0;
+    int valid = fgets(text, sizeof(text), f) != NULL;
+    fclose(f);
+    text[strcspn(text, " \t\r\n")] = '\0';
+    if (!valid || !chip8_isa_parse_quirks(text, &profile))
+    {
+        printf("Invalid quirk profile in %s\n", filename);
+        return 0;
+    }
+    *quirks = profile;
+    return 1;
+}
+
+/**
+ * @brief Read a ROM file if it is small enough to be loaded, with its quirk profile.
+ * 
+ * @param rom Pointer to the rom struct to fill.
+ * @param path Path of the file.
+ * @param name Name of the ROM in the pack.
+ * @return int 1 if the ROM has been read, 0 if the file is skipped.
+ */
+static int read_rom(struct rom* rom, const char* path, const char* name)
+{
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return 0;
+    }
+    size_t length = strlen(name);
+    if (length >= strlen(QUIRKS_SUFFIX) && strcmp(name + length - strlen(QUIRKS_SUFFIX), QUIRKS_SUFFIX) == 0)
+    {
+        return 0;
+    }
+    if (st.st_size == 0 || st.st_size > MAX_ROM_SIZE || strlen(name) >= CHIP8_ROMPACK_NAME_SIZE)
+    {
+        printf("Skipping %s\n", path);
+        return 0;
+    }
+
+    FILE* f = fopen(path, "rb");
+    if (!f)
+    {
+        printf("Failed to open %s\n", path);
+        return 0;
+    }
+    size_t size = fread(rom->data, 1, st.st_size, f);
+    fclose(f);
+    if (size != (size_t) st.st_size)
+    {
+        printf("Failed to read %s\n", path);
+        return 0;
+    }
+
+    memset(&rom->entry, 0, sizeof(rom->entry));
+    strcpy(rom->entry.name, name);
+    chip8_rom_analyze(&rom->entry, rom->data, size);
+    if (!read_quirks(path, &rom->entry.quirks))
+    {
+        printf("Skipping %s\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Build a pack with every ROM of a directory.
+ * 
+ * @param directory Directory holding the ROM files.
+ * @param filename Path of the pack to create.
+ * @return int 0 on success, -1 on failure.
+ */
+static int build_pack(const char* directory, const char* filename)
+{
+    DIR* dir = opendir(directory);
+    if (!dir)
+    {
+        printf("Failed to open the directory %s\n", directory);
+        return -1;
+    }
+
+    struct rom* roms = NULL;
+    uint32_t count = 0;
+    struct dirent* file;
+    while ((file = readdir(dir)) != NULL)
+    {
+        char path[MAX_PATH_SIZE];
+        snprintf(path, sizeof(path), "%s/%s", directory, file->d_name);
+        struct rom* grown = realloc(roms, (count + 1) * sizeof(struct rom));
+        if (!grown)
+        {
+            printf("Failed to allocate memory for %u ROMs\n", count + 1);
+            closedir(dir);
+            free(roms);
+            return -1;
+        }
+        roms = grown;
+        count += read_rom(&roms[count], path, file->d_name);
+    }
+    closedir(dir);
+    qsort(roms, count, sizeof(struct rom), compare_roms);
+
+    /* The images follow the index, each one aligned */
+    struct chip8_rompack_header header = { CHIP8_ROMPACK_MAGIC, CHIP8_ROMPACK_VERSION, count, 0 };
+    uint32_t offset = sizeof(header) + count * sizeof(struct chip8_rompack_entry);
+    for (uint32_t i = 0 ; i < count ; i++)
+    {
+        offset = (offset + CHIP8_ROMPACK_ALIGNMENT - 1) & ~(CHIP8_ROMPACK_ALIGNMENT - 1);
+        roms[i].entry.offset = offset;
+        offset += roms[i].entry.size;
+    }
+
+    FILE* f = fopen(filename, "wb");
+    if (!f)
+    {
+        printf("Failed to create %s\n", filename);
+        free(roms);
+        return -1;
+    }
+
+    fwrite(&header, sizeof(header), 1, f);
+    for (uint32_t i = 0 ; i < count ; i++)
+    {
+        fwrite(&roms[i].entry, sizeof(struct chip8_rompack_entry), 1, f);
+    }
+    for (uint32_t i = 0 ; i < count ; i++)
+    {
+        static const unsigned char padding[CHIP8_ROMPACK_ALIGNMENT];
+        fwrite(padding, 1, roms[i].entry.offset - ftell(f), f);
+        fwrite(roms[i].data, 1, roms[i].entry.size, f);
+    }
+
+    int res = ferror(f) ? -1 : 0;
+    fclose(f);
+    free(roms);
+    printf("%u ROMs written to %s\n", count, filename);
+    return res;
+}
+
+/**
+ * @brief Print the index of a pack.
+ * 
+ * @param filename Path of the pack.
+ * @return int 0 on success, -1 on failure.
+ */
+static int list_pack(const char* filename)
+{
+    struct chip8_rompack pack;
+    if (!chip8_rompack_open(&pack, filename))
+    {
+        return -1;
+    }
+
+    printf("%-31s %5s %16s %6s %6s %5s %5s\n", "name", "size", "hash", "uses", "quirks", "entry", "start");
+    for (uint32_t i = 0 ; i < pack.header->count ; i++)
+    {
+        const struct chip8_rompack_entry* entry = &pack.entries[i];
+        printf("%-31s %5u %016llx %6x %6x %04x %03x\n", entry->name, entry->size,
+               (unsigned long long) entry->hash, entry->uses, entry->quirks, entry->entry_opcode, entry->entry_target);
+    }
+
+    chip8_rompack_close(&pack);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 3 && strcmp(argv[1], "--list") == 0)
+    {
+        return list_pack(argv[2]);
+    }
+    if (argc == 3)
+    {
+        return build_pack(argv[1], argv[2]);
+    }
+
+    printf("Usage: %s <rom directory> <pack file>\n", argv[0]);
+    printf("       A file <rom>%s next to a ROM holds its quirk profile, as given to --quirks\n", QUIRKS_SUFFIX);
+    printf("       %s --list <pack file>\n", argv[0]);
+    return -1;
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "SDL2/SDL.h"
+#include "chip8.h"
+#include "chip8log.h"
+
+/*
+    Runs ROMs headless with random input and reports how often they write their own code,
+    as seen by the code pages of the block cache.
+*/
+
+/* Largest ROM that fits in memory after the load address */
+#define MAX_ROM_SIZE (CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_LOAD_ADDRESS - 1)
+/* Frames a random key is held for */
+#define FRAMES_PER_KEY 20
+
+/**
+ * @brief Read a ROM into an instance.
+ * 
+ * @param chip8 Pointer to the chip8 struct receiving the ROM.
+ * @param filename Path of the ROM file.
+ * @param seed Seed of the RND generator.
+ * @return bool True if the ROM has been loaded.
+ */
+static bool load_rom(struct chip8* chip8, const char* filename, uint32_t seed)
+{
+    static char buffer[MAX_ROM_SIZE];
+    FILE* f = fopen(filename, "rb");
+    if (!f)
+    {
+        printf("Failed to open the file %s\n", filename);
+        return false;
+    }
+    size_t size = fread(buffer, 1, sizeof(buffer), f);
+    bool too_large = fgetc(f) != EOF;
+    fclose(f);
+    if (size == 0 || too_large)
+    {
+        printf("The file %s is not a valid ROM\n", filename);
+        return false;
+    }
+
+    chip8_init(chip8);
+    chip8_seed(chip8, seed);
+    chip8_load(chip8, buffer, size);
+    return true;
+}
+
+/**
+ * @brief Run a ROM with random input and print its self-modification counters.
+ * 
+ * @param filename Path of the ROM file.
+ * @param frames Number of frames to run.
+ * @param seed Seed of the input and of the RND generator.
+ * @return bool True if the ROM has been run.
+ */
+static bool run_rom(const char* filename, int frames, uint32_t seed)
+{
+    static struct chip8 chip8;
+    if (!load_rom(&chip8, filename, seed))
+    {
+        return false;
+    }
+
+    struct chip8_block_cache* cache = chip8_block_cache_create();
+    if (!cache)
+    {
+        chip8_free(&chip8);
+        return false;
+    }
+    chip8_set_block_cache(&chip8, cache);
+
+    uint32_t random = seed ? seed : 1;
+    struct chip8_keyboard_event event = { 0, 0, false };
+    for (int frame = 0 ; frame < frames ; frame++)
+    {
+        if (frame % FRAMES_PER_KEY == 0)
+        {
+            /* Release the key held so far and hold another one, or none */
+            event.down = false;
+            chip8_keyboard_apply(&chip8.keyboard, &event);
+            random = random * 1103515245 + 12345;
+            event.key = (random >> 16) % CHIP8_TOTAL_KEYS;
+            event.down = (random >> 24) % 3 != 0;
+            chip8_keyboard_apply(&chip8.keyboard, &event);
+        }
+        chip8_run_frame(&chip8, CHIP8_INSTRUCTIONS_PER_FRAME);
+    }
+
+    const char* name = strrchr(filename, '/');
+    name = name ? name + 1 : filename;
+    uint64_t code_writes = atomic_load(&cache->stats.code_writes);
+    printf("%-12s %12llu %6.1f%% %10llu %10llu %12.2f\n",
+           name,
+           (unsigned long long) chip8.stats.instructions,
+           100.0 * chip8.stats.block_instructions / (chip8.stats.instructions ? chip8.stats.instructions : 1),
+           (unsigned long long) code_writes,
+           (unsigned long long) atomic_load(&cache->stats.invalidated),
+           1e6 * code_writes / (chip8.stats.instructions ? chip8.stats.instructions : 1));
+
+    chip8_block_cache_release(cache);
+    chip8_free(&chip8);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s [--frames N] [--seed N] <rom>...\n", argv[0]);
+        return -1;
+    }
+
+    int frames = 3600;
+    uint32_t seed = 1;
+    int first = 1;
+    while (first + 1 < argc && strncmp(argv[first], "--", 2) == 0)
+    {
+        if (strcmp(argv[first], "--frames") == 0)
+        {
+            frames = atoi(argv[first + 1]);
+        }
+        else if (strcmp(argv[first], "--seed") == 0)
+        {
+            seed = strtoul(argv[first + 1], NULL, 0);
+        }
+        else
+        {
+            printf("Unknown option: %s\n", argv[first]);
+            return -1;
+        }
+        first += 2;
+    }
+    chip8_log_set_level(CHIP8_LOG_LEVEL_ERROR);
+
+    printf("%-12s %12s %7s %10s %10s %12s\n", "rom", "instructions", "blocks", "code writes", "dropped", "writes/Minst");
+    int res = 0;
+    for (int i = first ; i < argc ; i++)
+    {
+        if (!run_rom(argv[i], frames, seed))
+        {
+            res = -1;
+        }
+    }
+    return res;
+}
\ No newline at end of file
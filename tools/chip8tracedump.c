@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "chip8trace.h"
+#include "chip8isa.h"
+
+/* Conditions a record must meet to be printed */
+struct filter
+{
+    unsigned int pc_low;
+    unsigned int pc_high;
+    unsigned int opcode_mask;
+    unsigned int opcode_match;
+    /* Bit r is set to only keep the records that change Vr */
+    unsigned int changed;
+};
+
+/**
+ * @brief Parse a pair of hexadecimal numbers separated by a colon.
+ * 
+ * @param text The text to parse.
+ * @param first Pointer where the first number is stored.
+ * @param second Pointer where the second number is stored.
+ * @return true The text is valid.
+ * @return false The text is not a valid pair.
+ */
+static bool parse_pair(const char* text, unsigned int* first, unsigned int* second)
+{
+    return sscanf(text, "%x:%x", first, second) == 2;
+}
+
+/**
+ * @brief Check whether a record meets the filter.
+ * 
+ * @param filter Pointer to the filter struct.
+ * @param record Pointer to the record to check.
+ * @return true The record has to be printed.
+ * @return false The record is filtered out.
+ */
+static bool filter_match(const struct filter* filter, const struct chip8_trace_record* record)
+{
+    return record->PC >= filter->pc_low && record->PC <= filter->pc_high
+        && (record->opcode & filter->opcode_mask) == filter->opcode_match
+        && (filter->changed == 0 || (record->changed & filter->changed) != 0);
+}
+
+/**
+ * @brief Print one record on a line.
+ * 
+ * @param record Pointer to the record to print.
+ * @return Void.
+ */
+static void print_record(const struct chip8_trace_record* record)
+{
+    char text[32];
+    chip8_isa_disassemble(record->opcode, text, sizeof(text));
+    printf("%10u  %03X  %04X  %-20s  I=%03X SP=%X DT=%02X",
+           record->sequence, record->PC, record->opcode, text, record->I, record->SP, record->delay_timer);
+    for (int i = 0 ; i < CHIP8_TOTAL_DATA_REGISTERS ; i++)
+    {
+        if (record->changed & (1 << i))
+        {
+            printf("  V%X=%02X", i, record->V[i]);
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <trace file> [--pc low:high] [--opcode mask:match] [--changed register] [--last count]\n", argv[0]);
+        return -1;
+    }
+
+    struct filter filter = { 0x000, 0xfff, 0x0000, 0x0000, 0 };
+    unsigned long last = 0;
+    for (int i = 2 ; i < argc ; i++)
+    {
+        bool valid = i + 1 < argc;
+        if (valid && strcmp(argv[i], "--pc") == 0)
+        {
+            valid = parse_pair(argv[++i], &filter.pc_low, &filter.pc_high);
+        }
+        else if (valid && strcmp(argv[i], "--opcode") == 0)
+        {
+            valid = parse_pair(argv[++i], &filter.opcode_mask, &filter.opcode_match);
+        }
+        else if (valid && strcmp(argv[i], "--changed") == 0)
+        {
+            filter.changed |= 1 << (strtoul(argv[++i], NULL, 16) & 0x0f);
+        }
+        else if (valid && strcmp(argv[i], "--last") == 0)
+        {
+            last = strtoul(argv[++i], NULL, 10);
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            printf("Invalid option: %s\n", argv[i]);
+            return -1;
+        }
+    }
+
+    FILE* f = fopen(argv[1], "rb");
+    if (!f)
+    {
+        printf("Failed to open the file %s\n", argv[1]);
+        return -1;
+    }
+
+    struct chip8_trace_header header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != CHIP8_TRACE_MAGIC)
+    {
+        printf("%s is not a trace file\n", argv[1]);
+        return -1;
+    }
+    if (header.version != CHIP8_TRACE_VERSION || header.record_size != sizeof(struct chip8_trace_record))
+    {
+        printf("Unsupported trace version %u\n", header.version);
+        return -1;
+    }
+
+    /* With --last, skip the records before the last ones */
+    if (last > 0)
+    {
+        fseek(f, 0, SEEK_END);
+        long records = (ftell(f) - (long) sizeof(header)) / (long) sizeof(struct chip8_trace_record);
+        long first = records > (long) last ? records - (long) last : 0;
+        fseek(f, sizeof(header) + first * sizeof(struct chip8_trace_record), SEEK_SET);
+    }
+
+    struct chip8_trace_record record;
+    unsigned long printed = 0;
+    while (fread(&record, sizeof(record), 1, f) == 1)
+    {
+        if (filter_match(&filter, &record))
+        {
+            print_record(&record);
+            printed++;
+        }
+    }
+
+    fclose(f);
+    fprintf(stderr, "%lu records printed\n", printed);
+    return 0;
+}
\ No newline at end of file